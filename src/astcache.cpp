@@ -0,0 +1,596 @@
+/* binary AST cache implementation */
+
+#include "astcache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem::v1;
+
+#include "ast.h"
+#include "compiler.h"
+#include "exception.h"
+#include "mappedfile.h"
+
+using namespace std;
+
+
+//
+// Entry layout:
+//
+//  "CCSA"            magic
+//  u32               format version
+//  u32 u32           key (low, high)
+//  u32               payload size
+//  payload:
+//   u32 n, n*str     imports
+//   node             program body
+//
+// All integers are little-endian; strings are a u32 length followed by
+// the raw characters; nodes are a one-byte nodetype (0xFF for NULL), the
+// source line, and then the node's own fields.
+//
+
+static const char magic[4] = { 'C', 'C', 'S', 'A' };
+static const unsigned char nullnode = 0xFF;
+static const size_t headersize = 20;
+
+
+/*
+ * Writer primitives
+ */
+
+void ASTWriter::Byte(unsigned char n)
+{
+	out += static_cast<char>(n);
+}
+
+void ASTWriter::Int(int n)
+{
+	unsigned int u = static_cast<unsigned int>(n);
+	Byte(u & 255);
+	Byte((u >> 8) & 255);
+	Byte((u >> 16) & 255);
+	Byte((u >> 24) & 255);
+}
+
+void ASTWriter::Str(const string& s)
+{
+	Int(s.length());
+	out += s;
+}
+
+void ASTWriter::Child(const Node* node)
+{
+	if(!node) {
+		Byte(nullnode);
+		return;
+	}
+	node->Serialize(*this);
+}
+
+
+/*
+ * Node serialization
+ *
+ * Each node writes its type and line, followed by whatever fields are
+ * needed to reconstruct it through the parser's own constructors.
+ */
+
+void Node::Serialize(ASTWriter& out) const
+{
+	throw Exception("node type cannot be cached");
+}
+
+void Block::Serialize(ASTWriter& out) const
+{
+	out.Byte(blockstmt);
+	out.Int(linenumber);
+	out.Byte(noscope);
+	out.Int(stmts.size());
+	for(unsigned int i = 0; i < stmts.size(); ++i)
+		out.Child(stmts[i]);
+}
+
+void BlockExpr::Serialize(ASTWriter& out) const
+{
+	out.Byte(blockexpr);
+	out.Int(linenumber);
+	out.Child(block);
+}
+
+void Label::Serialize(ASTWriter& out) const
+{
+	out.Byte(labelstmt);
+	out.Int(linenumber);
+	out.Str(name);
+}
+
+void IfExpr::Serialize(ASTWriter& out) const
+{
+	out.Byte(ifexpr);
+	out.Int(linenumber);
+	out.Child(condition);
+	out.Child(thenexpr);
+	out.Child(elseexpr);
+}
+
+void MenuExpr::Serialize(ASTWriter& out) const
+{
+	out.Byte(menuexpr);
+	out.Int(linenumber);
+	out.Int(defcolumns ? -1 : (int)columns);
+	out.Int(defaultopt);
+	out.Int(options.size());
+	for(unsigned int i = 0; i < options.size(); ++i) {
+		out.Child(options[i]);
+		out.Child(results[i]);
+	}
+}
+
+void CommandDef::Serialize(ASTWriter& out) const
+{
+	out.Byte(commandstmt);
+	out.Int(linenumber);
+	out.Str(name);
+	out.Int(args.size());
+	for(unsigned int i = 0; i < args.size(); ++i)
+		out.Str(args[i]);
+	out.Child(body);
+}
+
+void ConstDef::Serialize(ASTWriter& out) const
+{
+	out.Byte(conststmt);
+	out.Int(linenumber);
+	out.Str(name);
+	out.Child(value);
+}
+
+void ExprStmt::Serialize(ASTWriter& out) const
+{
+	out.Byte(exprstmt);
+	out.Int(linenumber);
+	out.Child(expr);
+}
+
+void RomWrite::Serialize(ASTWriter& out) const
+{
+	out.Byte(romwritestmt);
+	out.Int(linenumber);
+	out.Child(base);
+	out.Child(size);
+	out.Child(index);
+	out.Child(value);
+}
+
+void IntLiteral::Serialize(ASTWriter& out) const
+{
+	out.Byte(intexpr);
+	out.Int(linenumber);
+	out.Int(value);
+}
+
+void StringLiteral::Serialize(ASTWriter& out) const
+{
+	out.Byte(stringexpr);
+	out.Int(linenumber);
+	out.Str(value);
+}
+
+void FlagExpr::Serialize(ASTWriter& out) const
+{
+	out.Byte(flagexpr);
+	out.Int(linenumber);
+	out.Child(expr);
+}
+
+void AndExpr::Serialize(ASTWriter& out) const
+{
+	out.Byte(andexpr);
+	out.Int(linenumber);
+	out.Child(a);
+	out.Child(b);
+}
+
+void OrExpr::Serialize(ASTWriter& out) const
+{
+	out.Byte(orexpr);
+	out.Int(linenumber);
+	out.Child(a);
+	out.Child(b);
+}
+
+void NotExpr::Serialize(ASTWriter& out) const
+{
+	out.Byte(notexpr);
+	out.Int(linenumber);
+	out.Child(a);
+}
+
+void IdentExpr::Serialize(ASTWriter& out) const
+{
+	out.Byte(identexpr);
+	out.Int(linenumber);
+	out.Str(file);
+	out.Str(name);
+	out.Byte(hasparens);
+	out.Int(args.size());
+	for(unsigned int i = 0; i < args.size(); ++i)
+		out.Child(args[i]);
+}
+
+void BoundedExpr::Serialize(ASTWriter& out) const
+{
+	out.Byte(boundedexpr);
+	out.Int(linenumber);
+	out.Int(size);
+	out.Int(index);
+	out.Child(expr);
+}
+
+void CountExpr::Serialize(ASTWriter& out) const
+{
+	out.Byte(countexpr);
+	out.Int(linenumber);
+	out.Str(id);
+	out.Byte(set);
+	if(set) {
+		out.Int(value);
+	} else {
+		out.Int(offset);
+		out.Int(multiple);
+	}
+}
+
+void Program::Serialize(ASTWriter& out) const
+{
+	out.Byte(program);
+	out.Int(linenumber);
+	out.Int(stmts.size());
+	for(unsigned int i = 0; i < stmts.size(); ++i)
+		out.Child(stmts[i]);
+}
+
+
+/*
+ * Reader
+ *
+ * Rebuilds a tree using the same public constructors and setters the
+ * parser uses. Any malformed or truncated input throws an Exception,
+ * which ASTCache::Read turns into a cache miss.
+ */
+class ASTReader
+{
+public:
+	ASTReader(const char* data, size_t size, ErrorReceiver* e)
+		: pos(data), end(data + size), e(e) { }
+
+	bool AtEnd() const { return pos == end; }
+
+	unsigned char Byte()
+	{
+		if(pos >= end)
+			throw Exception("truncated AST cache entry");
+		return static_cast<unsigned char>(*pos++);
+	}
+
+	int Int()
+	{
+		unsigned int u = Byte();
+		u |= Byte() << 8;
+		u |= Byte() << 16;
+		u |= (unsigned int)Byte() << 24;
+		return static_cast<int>(u);
+	}
+
+	string Str()
+	{
+		unsigned int len = static_cast<unsigned int>(Int());
+		if(len > (size_t)(end - pos))
+			throw Exception("truncated AST cache entry");
+		string s(pos, len);
+		pos += len;
+		return s;
+	}
+
+	Node* Child();
+	Program* ReadProgram();
+
+	Expression* Expr()
+	{
+		Node* n = Child();
+		if(n && !n->IsExpression())
+			throw Exception("malformed AST cache entry");
+		return static_cast<Expression*>(n);
+	}
+
+	Statement* Stmt()
+	{
+		Node* n = Child();
+		if(!n || n->IsExpression() || n->GetType() == program)
+			throw Exception("malformed AST cache entry");
+		return static_cast<Statement*>(n);
+	}
+
+private:
+	const char* pos;
+	const char* end;
+	ErrorReceiver* e;
+};
+
+
+Node* ASTReader::Child()
+{
+	unsigned char type = Byte();
+	if(type == nullnode)
+		return NULL;
+
+	int line = Int();
+
+	switch(type)
+	{
+	case blockstmt: {
+		Block* b = new Block(line, e);
+		b->NoLocalScope(Byte() != 0);
+		int n = Int();
+		for(int i = 0; i < n; ++i)
+			b->Add(Stmt());
+		return b;
+	}
+	case blockexpr: {
+		Node* n = Child();
+		Block* b = dynamic_cast<Block*>(n);
+		if(!b)
+			throw Exception("malformed AST cache entry");
+		return new BlockExpr(line, b, e);
+	}
+	case labelstmt:
+		return new Label(line, Str(), e);
+	case ifexpr: {
+		Expression* cond = Expr();
+		Expression* thenexpr = Expr();
+		Expression* elseexpr = Expr();
+		return new IfExpr(line, cond, thenexpr, elseexpr, e);
+	}
+	case menuexpr: {
+		MenuExpr* menu = new MenuExpr(line, e);
+		int cols = Int();
+		int def = Int();
+		int n = Int();
+		for(int i = 0; i < n; ++i) {
+			Expression* option = Expr();
+			Expression* result = Expr();
+			menu->Add(option, result);
+		}
+		if(def != -1)
+			menu->SetDefault(def);
+		if(cols != -1)
+			menu->SetColumns(cols);
+		return menu;
+	}
+	case commandstmt: {
+		CommandDef* cmd = new CommandDef(line, Str(), e);
+		int n = Int();
+		for(int i = 0; i < n; ++i)
+			cmd->AddArg(Str());
+		cmd->SetBody(Expr());
+		return cmd;
+	}
+	case conststmt: {
+		string name = Str();
+		return new ConstDef(line, name, Expr(), e);
+	}
+	case exprstmt:
+		return new ExprStmt(line, Expr(), e);
+	case romwritestmt: {
+		RomWrite* stmt = new RomWrite(line, e);
+		stmt->SetBase(Expr());
+		stmt->SetSize(Expr());
+		stmt->SetIndex(Expr());
+		stmt->SetValue(Expr());
+		return stmt;
+	}
+	case intexpr:
+		return new IntLiteral(line, Int(), e);
+	case stringexpr:
+		return new StringLiteral(line, Str(), e);
+	case flagexpr:
+		return new FlagExpr(line, Expr(), e);
+	case andexpr: {
+		Expression* a = Expr();
+		Expression* b = Expr();
+		return new AndExpr(line, a, b, e);
+	}
+	case orexpr: {
+		Expression* a = Expr();
+		Expression* b = Expr();
+		return new OrExpr(line, a, b, e);
+	}
+	case notexpr:
+		return new NotExpr(line, Expr(), e);
+	case identexpr: {
+		string file = Str();
+		string name = Str();
+		IdentExpr* id = new IdentExpr(line, file, name, e);
+		if(Byte())
+			id->UseParens();
+		int n = Int();
+		for(int i = 0; i < n; ++i)
+			id->AddArg(Expr());
+		return id;
+	}
+	case boundedexpr: {
+		BoundedExpr* ex = new BoundedExpr(line, Int(), e);
+		ex->SetIndex(Int());
+		ex->SetExpr(Expr());
+		return ex;
+	}
+	case countexpr: {
+		string id = Str();
+		if(Byte())
+			return new CountExpr(line, id, Int(), e);
+		int offset = Int();
+		int multiple = Int();
+		return new CountExpr(line, id, offset, multiple, e);
+	}
+	default:
+		throw Exception("malformed AST cache entry");
+	}
+}
+
+Program* ASTReader::ReadProgram()
+{
+	vector<string> imports;
+	int n = Int();
+	for(int i = 0; i < n; ++i)
+		imports.push_back(Str());
+
+	if(Byte() != program)
+		throw Exception("malformed AST cache entry");
+
+	Program* p = new Program(Int(), e);
+	p->imports = imports;
+
+	n = Int();
+	for(int i = 0; i < n; ++i)
+		p->Add(Stmt());
+	return p;
+}
+
+
+/*
+ * Cache interface
+ */
+
+unsigned long long ASTCache::Hash(const string& source)
+{
+	// 64-bit FNV-1a over the compiler version and the source text
+	unsigned long long h = 14695981039346656037ULL;
+	string version = CCC_VERSION;
+	version += '\0';
+
+	for(string::const_iterator it = version.begin(); it != version.end(); ++it)
+		h = (h ^ static_cast<unsigned char>(*it)) * 1099511628211ULL;
+	for(string::const_iterator it = source.begin(); it != source.end(); ++it)
+		h = (h ^ static_cast<unsigned char>(*it)) * 1099511628211ULL;
+	return h;
+}
+
+void ASTCache::Write(const Program* program, unsigned long long key, string& out)
+{
+	string payload;
+	ASTWriter writer(payload);
+	writer.Int(program->imports.size());
+	for(unsigned int i = 0; i < program->imports.size(); ++i)
+		writer.Str(program->imports[i]);
+	writer.Child(program);
+
+	out.assign(magic, 4);
+	ASTWriter header(out);
+	header.Int(FormatVersion);
+	header.Int(key & 0xFFFFFFFF);
+	header.Int(key >> 32);
+	header.Int(payload.size());
+	out += payload;
+}
+
+Program* ASTCache::Read(const char* data, size_t size, unsigned long long key, ErrorReceiver* e)
+{
+	if(size < headersize || string(data, 4) != string(magic, 4))
+		return NULL;
+
+	try
+	{
+		ASTReader header(data + 4, headersize - 4, e);
+		if((unsigned int)header.Int() != FormatVersion)
+			return NULL;
+		unsigned long long k = (unsigned int)header.Int();
+		k |= (unsigned long long)(unsigned int)header.Int() << 32;
+		if(k != key)
+			return NULL;
+		if((unsigned int)header.Int() != size - headersize)
+			return NULL;
+
+		ASTReader reader(data + headersize, size - headersize, e);
+		Program* p = reader.ReadProgram();
+		if(!reader.AtEnd()) {
+			delete p;
+			return NULL;
+		}
+		return p;
+	}
+	catch(Exception&)
+	{
+		return NULL;
+	}
+}
+
+string ASTCache::EntryPath(const string& dir, unsigned long long key)
+{
+	stringstream ss;
+	ss << std::hex << std::setfill('0') << std::setw(16) << key << ".ast";
+	return (fs::path(dir) / ss.str()).string();
+}
+
+Program* ASTCache::Load(const string& dir, const string& source, ErrorReceiver* e)
+{
+	unsigned long long key = Hash(source);
+	return LoadFile(EntryPath(dir, key), key, e);
+}
+
+bool ASTCache::Store(const string& dir, const string& source, const Program* program)
+{
+	unsigned long long key = Hash(source);
+
+	std::error_code ec;
+	fs::create_directories(dir, ec);
+
+	return StoreFile(EntryPath(dir, key), key, program);
+}
+
+string ASTCache::ImagePath(const string& sourcefile)
+{
+	return fs::path(sourcefile).replace_extension(".ccsi").string();
+}
+
+Program* ASTCache::LoadFile(const string& path, unsigned long long key, ErrorReceiver* e)
+{
+	MappedFile file;
+	if(!file.Open(path))
+		return NULL;
+
+	return Read(file.GetData(), file.GetSize(), key, e);
+}
+
+bool ASTCache::StoreFile(const string& path, unsigned long long key, const Program* program)
+{
+	string data;
+	try {
+		Write(program, key, data);
+	}
+	catch(Exception&) {
+		return false;
+	}
+
+	// Write to a temporary file first, so that a concurrent build
+	// never sees a partially written entry
+	string temp = path + ".tmp";
+	{
+		ofstream file(temp.c_str(), ofstream::binary | ofstream::trunc);
+		if(file.fail())
+			return false;
+		file.write(data.data(), data.size());
+		if(file.fail())
+			return false;
+	}
+
+	std::error_code ec;
+	fs::rename(temp, path, ec);
+	return !ec;
+}
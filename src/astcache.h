@@ -0,0 +1,71 @@
+/* binary AST cache */
+#pragma once
+
+#include <string>
+
+class Node;
+class Program;
+class ErrorReceiver;
+
+
+// The AST cache stores parsed programs in a compact binary form, so that
+// modules whose source hasn't changed since the last build can skip the
+// lexing and parsing stages entirely.
+//
+// Cache entries are keyed by a hash of the module's source text and the
+// compiler version, so an entry can never be picked up by a build that
+// would have parsed the source differently. Entries are self-contained
+// flat buffers with no internal pointers, so they can be read straight
+// out of a mapped file.
+//
+// The same format is used for precompiled library images, which are built
+// by 'ccc --precompile' and installed alongside the library sources.
+
+//
+// Serializes AST nodes into a byte buffer.
+// Each node class implements Serialize() in terms of these primitives.
+//
+class ASTWriter
+{
+public:
+	explicit ASTWriter(std::string& out) : out(out) { }
+
+	void Byte(unsigned char n);
+	void Int(int n);
+	void Str(const std::string& s);
+	void Child(const Node* node);	// writes a node, or a null marker
+
+private:
+	std::string& out;
+};
+
+
+class ASTCache
+{
+public:
+	// Bump this whenever the serialized layout of any node changes
+	static const unsigned int FormatVersion = 1;
+
+	// Returns the cache key for a given module source
+	static unsigned long long Hash(const std::string& source);
+
+	// Looks up a cached parse of the given source in a cache directory.
+	// Returns NULL if there is no usable entry.
+	static Program* Load(const std::string& dir, const std::string& source, ErrorReceiver* e);
+
+	// Stores a parsed program in a cache directory. Returns false on failure.
+	static bool Store(const std::string& dir, const std::string& source, const Program* program);
+
+	// Single-file variants, used for precompiled library images that live
+	// next to their source files (e.g., std.ccs and std.ccsi)
+	static Program* LoadFile(const std::string& path, unsigned long long key, ErrorReceiver* e);
+	static bool StoreFile(const std::string& path, unsigned long long key, const Program* program);
+	static std::string ImagePath(const std::string& sourcefile);
+
+	// Buffer-level serialization, shared with the on-disk formats
+	static void Write(const Program* program, unsigned long long key, std::string& out);
+	static Program* Read(const char* data, size_t size, unsigned long long key, ErrorReceiver* e);
+
+private:
+	static std::string EntryPath(const std::string& dir, unsigned long long key);
+};
@@ -0,0 +1,570 @@
+/* persistent build state implementation */
+
+#include "buildstate.h"
+
+#include <cstring>
+#include <fstream>
+
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem::v1;
+
+#include "anchor.h"
+#include "ast.h"
+#include "bytechunk.h"
+#include "checksum.h"
+#include "compiler.h"
+#include "exception.h"
+#include "mappedfile.h"
+#include "module.h"
+#include "symboltable.h"
+
+using namespace std;
+
+
+//
+// File layout:
+//
+//  "CCSB"            magic
+//  u32               format version
+//  u32               number of entries
+//  entries:
+//   str              module name
+//   u32 u32          key (low, high)
+//   u32, n*str       modules referred to by qualified names
+//   str              output
+//  u32               CRC-32 of everything before it
+//
+// Output:
+//  chunk             module code
+//  u32               number of ROM writes
+//  ROM writes:
+//   u8               flags: 1 = has size, 2 = has index
+//   u32              source line
+//   chunk...         base, [size], [index], value
+//
+// Chunk:
+//  u32, u8[n]        bytes
+//  u8[(n+7)/8]       character mask, one bit per byte
+//  u32               number of distinct anchors
+//  anchors:
+//   str              name
+//   u8               flags: 1 = external, 2 = root label of a module
+//   u32              target
+//   [str str]        module and label name, for root labels
+//  u32               number of anchor placements
+//  placements:
+//   u32 int          anchor index, position
+//  u32               number of references
+//  references:
+//   int int int      location, offset, length
+//   u8               target kind: 0 = anchor in this chunk, 1 = root label
+//   u32 | str str    anchor index, or module and label name
+//
+// All integers are little-endian; strings are a u32 length followed by
+// the raw characters.
+//
+
+static const char magic[4] = { 'C', 'C', 'S', 'B' };
+
+
+class StateWriter
+{
+public:
+	explicit StateWriter(string& out) : out(out) { }
+
+	void Byte(unsigned char n) {
+		out += static_cast<char>(n);
+	}
+	void Int(unsigned int n) {
+		Byte(n & 255);
+		Byte((n >> 8) & 255);
+		Byte((n >> 16) & 255);
+		Byte((n >> 24) & 255);
+	}
+	void Key(unsigned long long k) {
+		Int(k & 0xFFFFFFFF);
+		Int(k >> 32);
+	}
+	void Str(const string& s) {
+		Int(s.length());
+		out += s;
+	}
+
+private:
+	string& out;
+};
+
+class StateReader
+{
+public:
+	StateReader(const char* data, size_t size) : pos(data), end(data + size) { }
+
+	unsigned char Byte() {
+		Need(1);
+		return static_cast<unsigned char>(*pos++);
+	}
+	unsigned int Int() {
+		unsigned int n = Byte();
+		n |= Byte() << 8;
+		n |= Byte() << 16;
+		n |= (unsigned int)Byte() << 24;
+		return n;
+	}
+	unsigned long long Key() {
+		unsigned long long k = Int();
+		return k | (unsigned long long)Int() << 32;
+	}
+	string Str() {
+		unsigned int len = Int();
+		return string(Bytes(len), len);
+	}
+	const char* Bytes(size_t len) {
+		Need(len);
+		const char* p = pos;
+		pos += len;
+		return p;
+	}
+	bool AtEnd() const { return pos == end; }
+
+private:
+	void Need(size_t len) {
+		if(static_cast<size_t>(end - pos) < len)
+			throw Exception("build state is damaged");
+	}
+
+	const char* pos;
+	const char* end;
+};
+
+
+//
+// Information about all modules' output that's needed to save any one of them
+//
+struct SaveContext
+{
+	// The module and label name of each root label
+	map<const Anchor*, pair<string, string> > labels;
+
+	// The number of chunks each anchor is placed in
+	map<const Anchor*, int> placements;
+
+	void CountPlacements(const ByteChunk* chunk);
+};
+
+void SaveContext::CountPlacements(const ByteChunk* chunk)
+{
+	if(!chunk)
+		return;
+
+	vector<Anchor*> anchors = chunk->GetAnchors();
+	set<const Anchor*> seen(anchors.begin(), anchors.end());
+	for(set<const Anchor*>::const_iterator it = seen.begin(); it != seen.end(); ++it)
+		placements[*it]++;
+}
+
+
+/*
+ * Serializes a chunk. Returns false if the chunk refers to anything that
+ * can't be found again by name in a later compilation.
+ */
+static bool SaveChunk(StateWriter& out, const ByteChunk* chunk, const SaveContext& ctx)
+{
+	unsigned int size = chunk->GetSize();
+	out.Int(size);
+	for(unsigned int i = 0; i < size; ++i)
+		out.Byte(chunk->ReadByte(i));
+	for(unsigned int i = 0; i < size; i += 8) {
+		unsigned char mask = 0;
+		for(unsigned int j = 0; j < 8 && i + j < size; ++j)
+			if(chunk->IsChar(i + j))
+				mask |= 1 << j;
+		out.Byte(mask);
+	}
+
+	// An anchor may be placed more than once in the same chunk (e.g., by a
+	// command invoked twice); each distinct anchor is stored only once
+	vector<Anchor*> placed = chunk->GetAnchors();
+	vector<const Anchor*> anchors;
+	map<const Anchor*, unsigned int> index;
+
+	for(vector<Anchor*>::const_iterator it = placed.begin(); it != placed.end(); ++it) {
+		if(index.find(*it) != index.end())
+			continue;
+
+		// Anchors shared with other chunks can't be recreated separately
+		if(ctx.placements.find(*it)->second > 1)
+			return false;
+
+		index[*it] = anchors.size();
+		anchors.push_back(*it);
+	}
+
+	out.Int(anchors.size());
+	for(vector<const Anchor*>::const_iterator it = anchors.begin(); it != anchors.end(); ++it) {
+		const Anchor* a = *it;
+		map<const Anchor*, pair<string, string> >::const_iterator label = ctx.labels.find(a);
+
+		out.Str(a->GetName());
+		out.Byte((a->IsExternal() ? 1 : 0) | (label != ctx.labels.end() ? 2 : 0));
+		out.Int(a->GetTarget());
+		if(label != ctx.labels.end()) {
+			out.Str(label->second.first);
+			out.Str(label->second.second);
+		}
+	}
+
+	out.Int(placed.size());
+	for(vector<Anchor*>::const_iterator it = placed.begin(); it != placed.end(); ++it) {
+		out.Int(index[*it]);
+		out.Int((*it)->GetPosition());
+	}
+
+	vector<ByteChunk::Reference> refs = chunk->GetReferences();
+	out.Int(refs.size());
+	for(vector<ByteChunk::Reference>::const_iterator it = refs.begin(); it != refs.end(); ++it) {
+		out.Int(it->location);
+		out.Int(it->offset);
+		out.Int(it->length);
+
+		map<const Anchor*, unsigned int>::const_iterator local = index.find(it->target);
+		if(local != index.end()) {
+			out.Byte(0);
+			out.Int(local->second);
+			continue;
+		}
+
+		map<const Anchor*, pair<string, string> >::const_iterator label = ctx.labels.find(it->target);
+		if(label == ctx.labels.end())
+			return false;
+		out.Byte(1);
+		out.Str(label->second.first);
+		out.Str(label->second.second);
+	}
+	return true;
+}
+
+
+/*
+ * Looks up a root label by module and label name
+ */
+static Anchor* FindLabel(Compiler* compiler, const string& module, const string& name)
+{
+	Module* m = compiler->GetModule(module);
+	if(!m)
+		return NULL;
+	return m->GetRootTable()->GetAnchor(name);
+}
+
+/*
+ * Recreates a serialized chunk into 'chunk', which owns it from the start,
+ * so that it can be deleted if restoring it fails. Returns false if a label
+ * it refers to no longer exists.
+ */
+static bool RestoreChunk(StateReader& in, Compiler* compiler, ByteChunk*& chunk)
+{
+	unsigned int size = in.Int();
+	const char* bytes = in.Bytes(size);
+	const char* mask = in.Bytes((size + 7) / 8);
+
+	chunk = new ByteChunk();
+	for(unsigned int i = 0; i < size; ++i)
+		chunk->Byte(static_cast<unsigned char>(bytes[i]), ((mask[i / 8] >> (i % 8)) & 1) != 0);
+
+	vector<Anchor*> anchors;
+	unsigned int count = in.Int();
+	for(unsigned int i = 0; i < count; ++i) {
+		string name = in.Str();
+		unsigned char flags = in.Byte();
+		unsigned int target = in.Int();
+
+		Anchor* a;
+		if(flags & 2) {
+			string module = in.Str();
+			string label = in.Str();
+			a = FindLabel(compiler, module, label);
+			if(!a)
+				return false;
+		}
+		else {
+			a = new Anchor(name);
+			a->SetExternal((flags & 1) != 0);
+			a->SetTarget(target);
+		}
+		anchors.push_back(a);
+	}
+
+	count = in.Int();
+	for(unsigned int i = 0; i < count; ++i) {
+		unsigned int index = in.Int();
+		int position = static_cast<int>(in.Int());
+		if(index >= anchors.size())
+			throw Exception("build state is damaged");
+		chunk->AddAnchor(position, anchors[index]);
+	}
+
+	count = in.Int();
+	for(unsigned int i = 0; i < count; ++i) {
+		int location = static_cast<int>(in.Int());
+		int offset = static_cast<int>(in.Int());
+		int length = static_cast<int>(in.Int());
+
+		Anchor* target;
+		if(in.Byte() == 0) {
+			unsigned int index = in.Int();
+			if(index >= anchors.size())
+				throw Exception("build state is damaged");
+			target = anchors[index];
+		}
+		else {
+			string module = in.Str();
+			string label = in.Str();
+			target = FindLabel(compiler, module, label);
+		}
+
+		if(!target)
+			return false;
+		chunk->AddReference(location, offset, length, target);
+	}
+	return true;
+}
+
+/*
+ * Holds a module's output while it's restored, and deletes what was
+ * restored unless the module takes it over
+ */
+class RestoredOutput
+{
+public:
+	ByteChunk* code;
+	vector<RomAccess*> writes;
+
+	RestoredOutput() : code(NULL) { }
+	~RestoredOutput()
+	{
+		delete code;
+		for(vector<RomAccess*>::iterator it = writes.begin(); it != writes.end(); ++it)
+			delete *it;
+	}
+
+	// Gives up the output to the module
+	void Release()
+	{
+		code = NULL;
+		writes.clear();
+	}
+
+private:
+	RestoredOutput(const RestoredOutput&);
+	RestoredOutput& operator=(const RestoredOutput&);
+};
+
+
+unsigned int BuildState::Save(const vector<Module*>& modules, const vector<unsigned long long>& keys,
+	const vector<DelayedWrite>& writes, const vector<char>& values)
+{
+	entries.clear();
+
+	SaveContext ctx;
+	for(vector<Module*>::const_iterator it = modules.begin(); it != modules.end(); ++it)
+	{
+		const map<string, Anchor*>& jumps = (*it)->GetRootTable()->GetJumpTable();
+		for(map<string, Anchor*>::const_iterator j = jumps.begin(); j != jumps.end(); ++j)
+			ctx.labels[j->second] = make_pair((*it)->GetName(), j->first);
+
+		ctx.CountPlacements((*it)->GetCodeChunk());
+	}
+
+	map<const Module*, vector<const DelayedWrite*> > bymodule;
+	for(vector<DelayedWrite>::const_iterator w = writes.begin(); w != writes.end(); ++w) {
+		if(!w->module)
+			continue;
+		bymodule[w->module].push_back(&*w);
+		if(w->access) {
+			ctx.CountPlacements(w->access->cache_base);
+			ctx.CountPlacements(w->access->cache_size);
+			ctx.CountPlacements(w->access->cache_index);
+			ctx.CountPlacements(w->access->cache_value);
+		}
+	}
+
+	for(unsigned int i = 0; i < modules.size(); ++i)
+	{
+		Module* m = modules[i];
+
+		// Warnings would be lost if the module weren't evaluated again
+		if(m->Failed() || m->Warned())
+			continue;
+
+		Entry e;
+		e.key = keys[i];
+		e.siblingrefs = m->GetSiblingRefs();
+
+		StateWriter out(e.output);
+		bool ok = SaveChunk(out, m->GetCodeChunk(), ctx);
+
+		const vector<const DelayedWrite*>& own = bymodule[m];
+		out.Int(own.size());
+		for(vector<const DelayedWrite*>::const_iterator it = own.begin(); ok && it != own.end(); ++it) {
+			const RomAccess* w = (*it)->access;
+
+			// A write resolved when it was made is saved as the same write
+			// with its address and value written out
+			if(!w) {
+				ByteChunk base, value;
+				base.Long((*it)->vaddress);
+				for(unsigned int i = 0; i < (*it)->size; ++i)
+					value.Byte((unsigned char)values[(*it)->offset + i]);
+
+				out.Byte(0);
+				out.Int((*it)->line);
+				ok = SaveChunk(out, &base, ctx) && SaveChunk(out, &value, ctx);
+				continue;
+			}
+
+			out.Byte((w->cache_size ? 1 : 0) | (w->cache_index ? 2 : 0));
+			out.Int(w->line);
+			ok = SaveChunk(out, w->cache_base, ctx);
+			if(ok && w->cache_size)
+				ok = SaveChunk(out, w->cache_size, ctx);
+			if(ok && w->cache_index)
+				ok = SaveChunk(out, w->cache_index, ctx);
+			if(ok)
+				ok = SaveChunk(out, w->cache_value, ctx);
+		}
+
+		if(ok)
+			entries[m->GetName()] = e;
+	}
+	return entries.size();
+}
+
+bool BuildState::Restore(Module* m, unsigned long long key, Compiler* compiler) const
+{
+	map<string, Entry>::const_iterator e = entries.find(m->GetName());
+	if(e == entries.end() || e->second.key != key)
+		return false;
+
+	RestoredOutput output;
+
+	try
+	{
+		StateReader in(e->second.output.data(), e->second.output.size());
+
+		if(!RestoreChunk(in, compiler, output.code))
+			return false;
+
+		unsigned int count = in.Int();
+		for(unsigned int i = 0; i < count; ++i) {
+			unsigned char flags = in.Byte();
+
+			RomAccess* w = new RomAccess();
+			output.writes.push_back(w);
+			w->line = in.Int();
+
+			if(!RestoreChunk(in, compiler, w->cache_base))
+				return false;
+			if((flags & 1) && !RestoreChunk(in, compiler, w->cache_size))
+				return false;
+			if((flags & 2) && !RestoreChunk(in, compiler, w->cache_index))
+				return false;
+			if(!RestoreChunk(in, compiler, w->cache_value))
+				return false;
+		}
+
+		if(!in.AtEnd())
+			return false;
+	}
+	catch(Exception&)
+	{
+		return false;
+	}
+
+	m->RestoreOutput(output.code, output.writes, e->second.siblingrefs);
+	output.Release();
+	return true;
+}
+
+const set<string>* BuildState::GetSiblingRefs(const string& module) const
+{
+	map<string, Entry>::const_iterator e = entries.find(module);
+	if(e == entries.end())
+		return NULL;
+	return &e->second.siblingrefs;
+}
+
+
+bool BuildState::Write(const string& path) const
+{
+	string data(magic, 4);
+	StateWriter out(data);
+	out.Int(FormatVersion);
+	out.Int(entries.size());
+
+	for(map<string, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+		out.Str(it->first);
+		out.Key(it->second.key);
+		out.Int(it->second.siblingrefs.size());
+		for(set<string>::const_iterator s = it->second.siblingrefs.begin();
+			s != it->second.siblingrefs.end(); ++s)
+			out.Str(*s);
+		out.Str(it->second.output);
+	}
+	out.Int(Crc32(data.data(), data.size()));
+
+	// Replace the old state in one step, so an interrupted write can't
+	// leave a damaged one behind
+	string temp = path + ".tmp";
+	{
+		ofstream file(temp.c_str(), ofstream::binary | ofstream::trunc);
+		if(file.fail())
+			return false;
+		file.write(data.data(), data.size());
+		if(file.fail())
+			return false;
+	}
+
+	std::error_code ec;
+	fs::rename(temp, path, ec);
+	return !ec;
+}
+
+bool BuildState::Read(const string& path)
+{
+	entries.clear();
+
+	MappedFile file;
+	if(!file.Open(path))
+		return false;
+
+	const char* data = file.GetData();
+	size_t size = file.GetSize();
+
+	if(size < 16 || memcmp(data, magic, 4) != 0)
+		return false;
+	if(StateReader(data + size - 4, 4).Int() != Crc32(data, size - 4))
+		return false;
+
+	try
+	{
+		StateReader in(data + 4, size - 8);
+		if(in.Int() != FormatVersion)
+			return false;
+
+		unsigned int count = in.Int();
+		for(unsigned int i = 0; i < count; ++i) {
+			string name = in.Str();
+			Entry& e = entries[name];
+			e.key = in.Key();
+			unsigned int siblings = in.Int();
+			for(unsigned int j = 0; j < siblings; ++j)
+				e.siblingrefs.insert(in.Str());
+			e.output = in.Str();
+		}
+	}
+	catch(Exception&)
+	{
+		entries.clear();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,63 @@
+/* persistent build state for incremental compilation */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+class Compiler;
+class Module;
+struct DelayedWrite;
+
+
+// The build state records what each module's evaluation produced in the
+// last successful compilation -- its code and ROM writes, along with the
+// references they contain -- and a key identifying the inputs it was
+// produced from. On the next compilation, a module whose key is unchanged
+// reuses that output instead of being evaluated again; it is then placed
+// and has its references resolved like any other module.
+//
+// A module's key covers its own source and counter state, and those of
+// every module it depends on: its imports, the modules it referred to by
+// qualified names, and everything those import in turn. References to
+// labels are stored by module and label name, so they remain valid when
+// the modules defining them are evaluated again or moved.
+class BuildState
+{
+public:
+	static const unsigned int FormatVersion = 2;
+
+	// Reads a build state file. Returns false if there is no usable state,
+	// in which case every module is evaluated.
+	bool Read(const std::string& path);
+
+	// Writes the build state. Returns false on failure.
+	bool Write(const std::string& path) const;
+
+	// Returns the modules that a module referred to by qualified names when
+	// it was last evaluated, or NULL if the module isn't in the build state
+	const std::set<std::string>* GetSiblingRefs(const std::string& module) const;
+
+	// Restores a module's saved output, if it was produced from the given key.
+	// Returns false if the module must be evaluated instead.
+	bool Restore(Module* m, unsigned long long key, Compiler* compiler) const;
+
+	// Replaces the saved state with the current output of the given modules,
+	// which must have been linked already, and the ROM writes they made
+	// ('values' holds those already resolved). Modules whose output can't be
+	// saved are left out, and will be evaluated next time. Returns the number
+	// of modules saved.
+	unsigned int Save(const std::vector<Module*>& modules,
+		const std::vector<unsigned long long>& keys,
+		const std::vector<DelayedWrite>& writes, const std::vector<char>& values);
+
+private:
+	struct Entry {
+		unsigned long long key;
+		std::set<std::string> siblingrefs;
+		std::string output;		// serialized code and ROM writes
+	};
+
+	std::map<std::string, Entry> entries;
+};
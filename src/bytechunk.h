@@ -1,170 +1,215 @@
-/* bytechunk class */
-#pragma once
-
-#include <vector>
-#include <iomanip>
-#include <cstdlib>
-#include <cstring>
-
-class Anchor;
-
-
-// Changes for CCScript 2.0:
-//
-// Firstly, this class will be renamed to "String" to represent its place
-// as one of CCScript 2.0's fundamental types.
-//
-// Beyond that, its interface will be changed somewhat: it will no longer
-// support operations like SetBaseAddress(), which pertain to its now
-// outmoded role as a close interactor with the underlying ROM data. It
-// will also no longer have an internal "position".
-//
-// It will still have internal References, and what is more we will also
-// add "Anchors," providing relative locations for References to be linked
-// to. (This is necessary because in CCScript 2.0 it will often be the case
-// that we evaluate a string mutator like "and" that needs internal jump
-// codes before we actually know its location in the ROM.)
-//
-// The first immediate change, though, is the addition of an Append method,
-// which allows one ByteChunk to be appended to another.
-//
-// We'll also need a Substring method, which returns a specified portion of
-// the ByteChunk, with anchors and possibly truncated references. (This
-// raises a question: what do we do when a substring slices out an anchor
-// to which a reference in the remaining portion refers? Hrm. I can't think
-// of any situation in which you'd want to be able to do that, and I also
-// can't think of any reasonable way to recover from it. I think that should
-// be an error case.)
-
-
-class ByteChunk
-{
-public:
-	// Internal references
-	//
-	// NOTE: this structure is a little weird. The 'location' field does not
-	// necessarily identify the offset in the string where the reference data
-	// starts. Rather, it identifies the offset where the reference _would_
-	// start if it were "whole" -- if a reference is truncated by having its
-	// first two bytes shaved off, its location will remain the same, but its
-	// "offset" will become 2.
-	//
-	// Thus, location+offset is the actual beginning of the reference.
-	struct Reference {
-		int location;	// relative location of the first byte of the reference
-		int offset;	// first byte of reference that will actually be written
-		int length; // length; bytes in (offset, offset+length) of target are put at location
-		Anchor* target;
-
-		Reference()
-			: location(0), offset(0), length(0), target(NULL) { }
-		Reference(unsigned int loc, int off, int len, Anchor* t)
-			: location(loc), offset(off), length(len), target(t) { }
-
-		bool operator==(const Reference& rhs) const;
-		bool operator!=(const Reference& rhs) const;
-	};
-
-public:
-	ByteChunk();
-	ByteChunk(const std::string& str);
-	ByteChunk(const ByteChunk&);
-
-	//
-	// Relational operators
-	//
-	bool operator==(const ByteChunk& rhs) const;
-	bool operator!=(const ByteChunk& rhs) const;
-	// Allow comparisons to std::strings:
-	bool operator==(const std::string& rhs) const;
-	bool operator!=(const std::string& rhs) const;
-	friend bool operator==(const std::string& lhs, const ByteChunk& rhs);
-	friend bool operator!=(const std::string& lhs, const ByteChunk& rhs);
-
-	unsigned int GetSize() const;
-
-	// Same thing as GetSize(), actually :I
-	// REMOVE
-	unsigned int GetPos() const;
-
-	//
-	// Reference handling
-	//
-public:
-	void AddReference(unsigned int location, Anchor* target);
-	void AddReference(unsigned int location, int offset, int length, Anchor* target);
-
-	void AddAnchor(Anchor* anchor);
-	void AddAnchor(int location, Anchor* anchor);
-	
-	std::vector<Reference> GetReferencesInRange(unsigned int start, unsigned int size) const;
-	std::vector<Reference> GetReferences() const;
-	std::vector<Anchor*> GetAnchors() const;
-
-	void SetBaseAddress(unsigned int adr);
-	void ResolveReferences();
-
-private:
-	void TranslateReferences(ByteChunk& destination,
-		int offset, unsigned int start, unsigned int len) const;
-
-
-	//
-	// Output primitives
-	//
-public:
-	void Byte(unsigned int n);
-	void Char(unsigned int n);
-	void Short(unsigned int n);
-	void Long(unsigned int n);
-
-	
-
-	// Writes a series of hex bytes to the code chunk from a string.
-	// NOTE: string must be a valid sequence of hex digit pairs, optionally separated by spaces.
-	// Performs no bounds checking. For internal use only.
-	void Code(const std::string &code);
-
-
-	//
-	// String operations
-	//
-
-	// Truncates the chunk to the given size
-	void Truncate(unsigned int newsize);
-
-	// Appends the contents of another ByteChunk to this one
-	void Append(const ByteChunk& other);
-
-	// Returns a substring of this ByteChunk
-	ByteChunk Substring(unsigned int start, unsigned int len) const;
-
-
-	// Some methods for reading data out of a chunk
-	unsigned char ReadByte(unsigned int pos) const;
-	unsigned short ReadShort(unsigned int pos) const;
-	unsigned int ReadLong(unsigned int pos) const;
-
-	// Writes the contents of the chunk to a buffer
-	bool WriteChunk(char* buffer, int location, int bufsize) const;
-
-
-	//
-	// String printing
-	//
-	std::string ToString() const;
-	friend std::ostream& operator<<(std::ostream& stream, const ByteChunk& rhs);
-
-
-private:
-	std::vector<unsigned char> bytes;
-	std::vector<Reference> refs;
-	std::vector<Anchor*> anchors;
-
-	unsigned int pos;
-	unsigned int baseaddress;
-
-	// temporary parallel vector for debug printing
-	std::vector<bool> cinfo;
-};
-
+/* bytechunk class */
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+
+class Anchor;
+
+
+// Changes for CCScript 2.0:
+//
+// Firstly, this class will be renamed to "String" to represent its place
+// as one of CCScript 2.0's fundamental types.
+//
+// Beyond that, its interface will be changed somewhat: it will no longer
+// support operations like SetBaseAddress(), which pertain to its now
+// outmoded role as a close interactor with the underlying ROM data. It
+// will also no longer have an internal "position".
+//
+// It will still have internal References, and what is more we will also
+// add "Anchors," providing relative locations for References to be linked
+// to. (This is necessary because in CCScript 2.0 it will often be the case
+// that we evaluate a string mutator like "and" that needs internal jump
+// codes before we actually know its location in the ROM.)
+//
+// The first immediate change, though, is the addition of an Append method,
+// which allows one ByteChunk to be appended to another.
+//
+// We'll also need a Substring method, which returns a specified portion of
+// the ByteChunk, with anchors and possibly truncated references. (This
+// raises a question: what do we do when a substring slices out an anchor
+// to which a reference in the remaining portion refers? Hrm. I can't think
+// of any situation in which you'd want to be able to do that, and I also
+// can't think of any reasonable way to recover from it. I think that should
+// be an error case.)
+
+
+class ByteChunk
+{
+public:
+	// Internal references
+	//
+	// NOTE: this structure is a little weird. The 'location' field does not
+	// necessarily identify the offset in the string where the reference data
+	// starts. Rather, it identifies the offset where the reference _would_
+	// start if it were "whole" -- if a reference is truncated by having its
+	// first two bytes shaved off, its location will remain the same, but its
+	// "offset" will become 2.
+	//
+	// Thus, location+offset is the actual beginning of the reference.
+	struct Reference {
+		int location;	// relative location of the first byte of the reference
+		int offset;	// first byte of reference that will actually be written
+		int length; // length; bytes in (offset, offset+length) of target are put at location
+		Anchor* target;
+		int jump;	// the jump code this is the operand of, or NoJump (see Jump)
+
+		Reference()
+			: location(0), offset(0), length(0), target(NULL), jump(0) { }
+		Reference(unsigned int loc, int off, int len, Anchor* t)
+			: location(loc), offset(off), length(len), target(t), jump(0) { }
+
+		bool operator==(const Reference& rhs) const;
+		bool operator!=(const Reference& rhs) const;
+	};
+
+public:
+	ByteChunk();
+	ByteChunk(const std::string& str);
+	ByteChunk(const ByteChunk&);
+
+	//
+	// Relational operators
+	//
+	bool operator==(const ByteChunk& rhs) const;
+	bool operator!=(const ByteChunk& rhs) const;
+	// Allow comparisons to std::strings:
+	bool operator==(const std::string& rhs) const;
+	bool operator!=(const std::string& rhs) const;
+	friend bool operator==(const std::string& lhs, const ByteChunk& rhs);
+	friend bool operator!=(const std::string& lhs, const ByteChunk& rhs);
+
+	unsigned int GetSize() const;
+
+	// Same thing as GetSize(), actually :I
+	// REMOVE
+	unsigned int GetPos() const;
+
+	//
+	// Reference handling
+	//
+public:
+	void AddReference(unsigned int location, Anchor* target);
+	void AddReference(unsigned int location, int offset, int length, Anchor* target);
+
+	void AddAnchor(Anchor* anchor);
+	void AddAnchor(int location, Anchor* anchor);
+
+	// Jumps generated by the compiler itself. These are marked as such, so
+	// that the optimizer can tell them apart from raw control codes.
+	enum JumpCode {
+		NoJump,
+		Goto,		// [0A]
+		IfFalse,	// [1B 02]
+		IfTrue,		// [1B 03]
+		Call		// [08]
+	};
+	void Jump(JumpCode code, Anchor* target);	// Appends a jump to the given anchor
+	
+	std::vector<Reference> GetReferencesInRange(unsigned int start, unsigned int size) const;
+	std::vector<Reference> GetReferences() const;
+	bool HasReferences() const;
+	std::vector<Anchor*> GetAnchors() const;
+
+	void SetBaseAddress(unsigned int adr);
+	void SetRangeAddress(unsigned int start, unsigned int end,	// Sets the targets of anchors in [start, end),
+		unsigned int adr);										// with 'start' placed at address 'adr'
+	void ResolveReferences();
+
+private:
+	void TranslateReferences(ByteChunk& destination,
+		int offset, unsigned int start, unsigned int len) const;
+
+
+	//
+	// Output primitives
+	//
+public:
+	void Byte(unsigned int n);
+	void Byte(unsigned int n, bool ischar);	// Appends a raw byte with the given character mask bit
+	void Char(unsigned int n);
+	void Short(unsigned int n);
+	void Long(unsigned int n);
+
+	
+
+	// Writes a series of hex bytes to the code chunk from a string.
+	// NOTE: string must be a valid sequence of hex digit pairs, optionally separated by spaces.
+	// Performs no bounds checking. For internal use only.
+	void Code(const std::string &code);
+
+
+	//
+	// String operations
+	//
+
+	// Truncates the chunk to the given size
+	void Truncate(unsigned int newsize);
+
+	// Appends the contents of another ByteChunk to this one
+	void Append(const ByteChunk& other);
+
+	// Returns a substring of this ByteChunk
+	ByteChunk Substring(unsigned int start, unsigned int len) const;
+
+	// Removes the given ranges of bytes, which must be sorted and disjoint.
+	// References that lose any of their bytes are dropped, and anchors
+	// inside a removed range move to where it was.
+	typedef std::pair<unsigned int, unsigned int> Range;	// [first, second)
+	void Remove(const std::vector<Range>& ranges);
+
+	// Replaces each of the given ranges, which must be sorted, disjoint and
+	// no shorter than a jump, with a jump of the given kind to the matching
+	// target. References in the ranges are dropped.
+	void ReplaceWithJumps(const std::vector<Range>& ranges, JumpCode code,
+		const std::vector<Anchor*>& targets);
+
+
+	// Some methods for reading data out of a chunk
+	unsigned char ReadByte(unsigned int pos) const;
+	unsigned short ReadShort(unsigned int pos) const;
+	unsigned int ReadLong(unsigned int pos) const;
+	bool IsChar(unsigned int pos) const;	// true if the byte was output as a text character
+
+	// Writes the contents of the chunk to a buffer
+	bool WriteChunk(char* buffer, int location, int bufsize) const;
+	bool WriteChunk(char* buffer, int location, int bufsize,		// Writes only the bytes in
+		unsigned int start, unsigned int len) const;				// [start, start+len)
+
+	// Writes the chunk to a buffer in pieces, the bytes from each of the
+	// given positions up to the next going to the matching location, and
+	// fills in its references in the buffer as it goes. The chunk itself
+	// is left unresolved.
+	bool WriteResolved(char* buffer, int bufsize, const std::vector<unsigned int>& starts,
+		const std::vector<int>& locations) const;
+
+
+	//
+	// String printing
+	//
+	std::string ToString() const;
+	friend std::ostream& operator<<(std::ostream& stream, const ByteChunk& rhs);
+
+
+private:
+	friend class Peephole;
+	friend class TailMerger;
+	friend class Outliner;
+	friend class TextCompressor;
+	friend class DeadCode;
+
+	std::vector<unsigned char> bytes;
+	std::vector<Reference> refs;
+	std::vector<Anchor*> anchors;
+
+	unsigned int pos;
+	unsigned int baseaddress;
+
+	// temporary parallel vector for debug printing
+	std::vector<bool> cinfo;
+};
+
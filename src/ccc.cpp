@@ -1,282 +1,629 @@
-// ccscript.cpp : Defines the entry point for the console application.
-//
-#include <stdio.h>
-#include <iomanip>
-#include <vector>
-#include <string>
-#include <sstream>
-#include <signal.h>
-
-#include <experimental/filesystem>
-namespace fs = std::experimental::filesystem::v1;
-
-#include "compiler.h"
-#include "module.h"
-
-using std::vector;
-using std::string;
-using std::stringstream;
-using std::cout;
-using std::endl;
-
-
-
-string getbasepath(const char* p)
-{
-	string path = p;
-	size_t n = path.find_last_of("/\\");
-	if(n == string::npos)
-		return "";
-	return path.substr(0, n) + "/";
-}
-
-void printversion()
-{
-	cout << "ccc version 1.337 Duck Tape Edition" << endl;
-}
-
-void printusage()
-{
-	cout << "Usage: ccc [options] [files] ... " << endl
-		 << "Options: " << endl
-		 << "   -o <file>             Dump compiled text into <file> at <address>" << endl
-		 << "   -s,--start <adr>      Begin dumping at this address" << endl
-		 << "   -e,--end <adr>        Do not write past this address" << endl
-		 << "                           Addresses must be SNES offset, e.g., F00000" << endl
-		 << "   -n,--no-reset         Do not use a 'reset' file to refresh ROM image" << endl
-		 << "   --libs <path>         Look in <path> for all libraries" << endl
-		 << "   --nostdlibs           Do not include the default standard libraries" << endl
-		 << "   --summary <file>      Writes a compilation summary to <file>" << endl
-		 << "                           Useful if you want to know where stuff went." << endl
-		 //<< "   --shortpause <n>      Short pauses '/' are <n> frames long (default 5)" << endl
-		 //<< "   --longpause <n>       Long pauses '|' are <n> frames long (default 15)" << endl
-		 << "   --printAST            Prints the abstract syntax tree for each module" << endl
-		 << "   --printRT             Prints the root symbol table for each module" << endl
-		 << "   --printJumps          Prints the compiled addresses of all labels" << endl
-		 << "   --printCode           Prints compiled code for each module" << endl
-		 << "   -v                    Prints version number and exits" << endl
-		 << endl
-		 << "Example:" << endl
-		 << endl
-		 << "   ccc -o Earthbound.smc -s F20000 onett.ccs twoson.ccs threed.ccs" << endl
-		 << endl
-		 << "   This will compile onett.ccs, twoson.ccs, and threed.ccs together, and" << endl
-		 << "   put the resulting compiled text at $F20000 in the ROM Earthbound.smc" << endl;
-}
-
-int main(int argc, char* argv[])
-{
-
-	//
-	// Get the default libs path
-	//
-	string libspath = ( fs::path(argv[0]).parent_path() / "lib" ).string();
-
-
-	if(argc < 2) {
-		printusage();
-		return -1;
-	}
-
-
-	string outfile;
-	string startstr;
-	string endstr;
-	string summaryfile;
-	unsigned long outadr = 0;
-	unsigned long endadr = 0;
-	vector<string> files;
-	vector<string> libs;
-	bool noreset = false;
-	bool nostdlibs = false;
-	unsigned char shortpause;
-	unsigned char longpause;
-	bool printAST = false;
-	bool printRT = false;
-	bool printJumps = false;
-	bool printCode = false;
-	bool verbose = false;
-
-	// Command-line options:
-	//  -o <file>			output filename
-	//  -s <address>		output start
-	//  -e <address>		output end
-	//  -l <file>			include library file
-	//  --libs <dir>         look in <dir> for standard libraries
-	//  -h,--help			print help message
-	//  --nostdlibs			do not include default libraries
-	//  --shortpause <n>	duration of short pauses ('/')
-	//  --longpause <n>		duration of long pauses ('|')
-	//  --printAST			print AST for each module
-	//  --printRT			print root table for each module
-	//  --printJumps		print a list of jumps and addresses
-	//  --printCode			print the code output for each module
-	//  --summary <file>	output summary file
-	//  --verbose			verbose output
-
-	int p = 1;
-	while(p < argc) {
-		if(!strcmp(argv[p],"-o")) {
-			p++;
-			if(p >= argc) {
-				std::cout << "argument error: no output file specified" << std::endl;
-				return -1;
-			}
-			outfile = argv[p++];
-		}
-		else if(!strcmp(argv[p], "--start") || !strcmp(argv[p], "-s"))
-		{
-			p++;
-			if(p >= argc) {
-				std::cout << "argument error: no start address specified after -s" << std::endl;
-				return -1;
-			}
-			startstr = argv[p++];
-		}
-		else if(!strcmp(argv[p], "--end") || !strcmp(argv[p], "-e"))
-		{
-			p++;
-			if(p >= argc) {
-				std::cout << "argument error: no end address specified after -e" << std::endl;
-				return -1;
-			}
-			endstr = argv[p++];
-		}
-		else if(!strcmp(argv[p], "-v")) {
-			printversion();
-			return 0;
-		}
-		else if(!strcmp(argv[p],"--libs")) {
-			p++;
-			if(p >= argc) {
-				std::cout << "argument error: no library path specified" << std::endl;
-				return -1;
-			}
-			libspath = argv[p++];
-		}
-		else if(!strcmp(argv[p], "-h") || !strcmp(argv[p], "--help") || !strcmp(argv[p], "?")) {
-			printusage();
-			return 0;
-		}
-		else if(!strcmp(argv[p],"-l")) {
-			p++;
-			if(p >= argc) {
-				std::cout << "argument error: no library file specified" << std::endl;
-				return -1;
-			}
-			std::cerr << "WARNING: -l flag deprecated. Use 'import' statement to include libraries." << std::endl;
-			libs.push_back(argv[p++]);
-		}
-		else if(!strcmp(argv[p],"-n") || !strcmp(argv[p], "--no-reset")) {
-			p++;
-			noreset = true;
-		}
-		else if(!strcmp(argv[p],"--nostdlibs")) {
-			p++;
-			nostdlibs = true;
-		}
-		else if(!strcmp(argv[p],"--summary") || !strcmp(argv[p], "--sum")) {
-			p++;
-			if(p >= argc) {
-				std::cout << "argument error: no summary file specified" << std::endl;
-				return -1;
-			}
-			summaryfile = argv[p++];
-		}
-		else if(!strcmp(argv[p],"--shortpause")) {
-			p++;
-			shortpause = (unsigned char)strtoul(argv[p++], NULL, 10);
-		}
-		else if(!strcmp(argv[p],"--longpause")) {
-			p++;
-			longpause = (unsigned char)strtoul(argv[p++], NULL, 10);
-		}
-		else if(!strcmp(argv[p],"--printAST")) {
-			p++;
-			printAST = true;
-		}
-		else if(!strcmp(argv[p],"--printRT")) {
-			p++;
-			printRT = true;
-		}
-		else if(!strcmp(argv[p],"--printJumps")) {
-			p++;
-			printJumps = true;
-		}
-		else if(!strcmp(argv[p],"--printCode")) {
-			p++;
-			printCode = true;
-		}
-		else if(!strcmp(argv[p],"--verbose"))
-		{
-			p++;
-			verbose = true;
-		}
-		else {
-			files.push_back(argv[p++]);
-		}
-	}
-
-
-
-	if(!startstr.empty())
-	{
-		stringstream ss(startstr);
-		ss >> std::setbase(16) >> outadr;
-	}
-	else
-	{
-		// Default to start of HiROM file
-		outadr = 0xC00000;
-	}
-
-	if(!endstr.empty())
-	{
-		stringstream ss(endstr);
-		ss >> std::setbase(16) >> endadr;
-	}
-
-	// Create compiler and set options
-	Compiler compiler(outfile, outadr, endadr);
-	compiler.printAST = printAST;
-	compiler.printRT = printRT;
-	compiler.printCode = printCode;
-	compiler.printJumps = printJumps;
-	compiler.verbose = verbose;
-	compiler.libdir = libspath;
-	compiler.noreset = noreset;
-	compiler.nostdlibs = nostdlibs;
-
-	/*
-	 * 7/25/2009:
-	 * Library loading has been fixed!
-	 */
-
-	for(unsigned int i = 0; i < libs.size(); ++i) {
-		compiler.LoadModule(libs[i]);
-	}
-
-	for(unsigned int i = 0; i < files.size(); ++i) {
-		compiler.LoadModule(files[i]);
-	}
-
-	// Do the stuff.
-	compiler.Compile();
-	compiler.WriteOutput();
-	compiler.Results();
-
-	// Write summary file
-	if(!summaryfile.empty())
-	{
-		std::fstream file;
-		file.open(summaryfile.c_str(), std::ios_base::out|std::ios_base::trunc);
-		if(file.fail())
-		{
-			std::cerr << "Couldn't open " << summaryfile << " to write summary file." << std::endl;
-			return -1;
-		}
-		compiler.WriteSummary(file);
-	}
-
-	return compiler.Failed();
+// ccscript.cpp : Defines the entry point for the console application.
+//
+#include <stdio.h>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <signal.h>
+
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem::v1;
+
+#include "compiler.h"
+#include "module.h"
+#include "patch.h"
+#include "trace.h"
+
+using std::vector;
+using std::string;
+using std::stringstream;
+using std::cout;
+using std::endl;
+
+
+
+string getbasepath(const char* p)
+{
+	string path = p;
+	size_t n = path.find_last_of("/\\");
+	if(n == string::npos)
+		return "";
+	return path.substr(0, n) + "/";
+}
+
+void printversion()
+{
+	cout << "ccc version " CCC_VERSION " Duck Tape Edition" << endl;
+}
+
+void printusage()
+{
+	cout << "Usage: ccc [options] [files] ... " << endl
+		 << "Options: " << endl
+		 << "   -o <file>             Dump compiled text into <file> at <address>" << endl
+		 << "   -s,--start <adr>      Begin dumping at this address" << endl
+		 << "   -e,--end <adr>        Do not write past this address" << endl
+		 << "                           Addresses must be SNES offset, e.g., F00000" << endl
+		 << "   -n,--no-reset         Do not use a 'reset' file to refresh ROM image" << endl
+		 << "   --libs <path>         Look in <path> for all libraries" << endl
+		 << "   --nostdlibs           Do not include the default standard libraries" << endl
+		 << "   --cache <dir>         Cache parsed modules in <dir> to skip reparsing" << endl
+		 << "                           unchanged sources on later builds" << endl
+		 << "   --precompile          Writes precompiled images of [files] instead of" << endl
+		 << "                           compiling; used to build the library images" << endl
+		 << "   --incremental         Keeps build state in <file>.build, and only evaluates" << endl
+		 << "                           modules whose sources or imports have changed" << endl
+		 << "   --stable              Keeps modules at the addresses they had in the last" << endl
+		 << "                           build where possible, to minimize changes" << endl
+		 << "   --pack <method>       Packs modules into banks using <method>:" << endl
+		 << "                           greedy (default), bfd (best-fit decreasing)," << endl
+		 << "                           or exact (searches for the best packing)" << endl
+		 << "   --pack-time <ms>      Time limit for --pack exact (default 1000)" << endl
+		 << "   -O                    Optimizes the jumps generated for if, menu, and," << endl
+		 << "                           and or, removing redundant and unreachable code" << endl
+		 << "   --merge-text          Replaces text that repeats, or ends the same way as" << endl
+		 << "                           other text, with a jump to a single copy; turns" << endl
+		 << "                           off --incremental" << endl
+		 << "   --outline <n>         Moves command expansions of at least <n> bytes that" << endl
+		 << "                           repeat into subroutines, and calls them instead;" << endl
+		 << "                           turns off --incremental" << endl
+		 << "   --compress <n>        Compresses text with a dictionary of up to <n>" << endl
+		 << "                           common strings, which replace the entries of the" << endl
+		 << "                           game's dictionary given by --dictionary; turns" << endl
+		 << "                           off --incremental" << endl
+		 << "   --dictionary <f-l>    Entries <f> to <l> (0-767) of the game's text" << endl
+		 << "                           dictionary, which no text left in the game uses," << endl
+		 << "                           for --compress to replace; required with it" << endl
+		 << "   --strip-unused        Removes code that can't be reached from any ROM" << endl
+		 << "                           write or --roots label; turns off --incremental" << endl
+		 << "   --roots <file>        Reads labels for --strip-unused to keep from <file>," << endl
+		 << "                           one per line: module.label, or a module name for" << endl
+		 << "                           all of its labels" << endl
+		 << "   --size-only           Works out where everything would go, and reports" << endl
+		 << "                           each module's size and how it changed since the" << endl
+		 << "                           last build, without writing to the ROM" << endl
+		 << "   --time-report <file>  Writes the wall and CPU time spent in each phase" << endl
+		 << "                           of the build, and on each module, to <file>; as" << endl
+		 << "                           JSON if it ends in .json, and '-' for stdout" << endl
+		 << "   --trace <file>        Records what the build spends its time on, down to" << endl
+		 << "                           each command expanded, as Chrome trace events in" << endl
+		 << "                           <file>, for chrome://tracing or Perfetto" << endl
+		 << "   --profile <file>      Samples which commands are being expanded while" << endl
+		 << "                           modules are evaluated, and writes the samples to" << endl
+		 << "                           <file> as folded stacks (for flame graphs) and" << endl
+		 << "                           the time spent in each command to stdout" << endl
+		 << "   --profile-interval <us>" << endl
+		 << "                         Time between samples for --profile (default 1000)" << endl
+		 << "   --split-labels        Places each module's output in pieces split at its" << endl
+		 << "                           labels, to fill banks more tightly and to place" << endl
+		 << "                           modules over 64KB" << endl
+		 << "   --region <start-end>  Places output in this region instead of the -s/-e" << endl
+		 << "                           window, e.g. F00000-F10000; may be repeated" << endl
+		 << "   --regions <file>      Reads regions from <file>, one per line" << endl
+		 << "   --scan-free <n>       Also places output in any runs of at least <n>" << endl
+		 << "                           bytes of 00 or FF found in the ROM" << endl
+		 << "   --patch <file>        Writes an IPS or BPS patch (chosen by extension)" << endl
+		 << "                           to <file> instead of modifying the ROM" << endl
+		 << "   --summary <file>      Writes a compilation summary to <file>" << endl
+		 << "                           Useful if you want to know where stuff went." << endl
+		 //<< "   --shortpause <n>      Short pauses '/' are <n> frames long (default 5)" << endl
+		 //<< "   --longpause <n>       Long pauses '|' are <n> frames long (default 15)" << endl
+		 << "   --printAST            Prints the abstract syntax tree for each module" << endl
+		 << "   --printRT             Prints the root symbol table for each module" << endl
+		 << "   --printJumps          Prints the compiled addresses of all labels" << endl
+		 << "   --printCode           Prints compiled code for each module" << endl
+		 << "   -v                    Prints version number and exits" << endl
+		 << endl
+		 << "Example:" << endl
+		 << endl
+		 << "   ccc -o Earthbound.smc -s F20000 onett.ccs twoson.ccs threed.ccs" << endl
+		 << endl
+		 << "   This will compile onett.ccs, twoson.ccs, and threed.ccs together, and" << endl
+		 << "   put the resulting compiled text at $F20000 in the ROM Earthbound.smc" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+
+	//
+	// Get the default libs path
+	//
+	string libspath = ( fs::path(argv[0]).parent_path() / "lib" ).string();
+
+
+	if(argc < 2) {
+		printusage();
+		return -1;
+	}
+
+
+	string outfile;
+	string startstr;
+	string endstr;
+	string summaryfile;
+	string cachedir;
+	string patchfile;
+	bool incremental = false;
+	bool stable = false;
+	bool splitlabels = false;
+	bool optimize = false;
+	bool mergetext = false;
+	unsigned int outline = 0;
+	unsigned int compress = 0;
+	unsigned int dictionaryfirst = 0;
+	unsigned int dictionarylast = 0;
+	bool hasdictionary = false;
+	bool strip = false;
+	bool sizeonly = false;
+	string timereport;
+	string tracefile;
+	string profilefile;
+	unsigned int profileinterval = 1000;
+	string rootsfile;
+	BankPacker::Method packmethod = BankPacker::Greedy;
+	unsigned int packtime = 1000;
+	FreeSpace freespace;
+	string regionfile;
+	unsigned int scanfree = 0;
+	unsigned long outadr = 0;
+	unsigned long endadr = 0;
+	vector<string> files;
+	vector<string> libs;
+	bool noreset = false;
+	bool nostdlibs = false;
+	bool precompile = false;
+	unsigned char shortpause;
+	unsigned char longpause;
+	bool printAST = false;
+	bool printRT = false;
+	bool printJumps = false;
+	bool printCode = false;
+	bool verbose = false;
+
+	// Command-line options:
+	//  -o <file>			output filename
+	//  -s <address>		output start
+	//  -e <address>		output end
+	//  -l <file>			include library file
+	//  --libs <dir>         look in <dir> for standard libraries
+	//  -h,--help			print help message
+	//  --nostdlibs			do not include default libraries
+	//  --cache <dir>		cache parsed modules in <dir>
+	//  --precompile		write precompiled module images
+	//  --shortpause <n>	duration of short pauses ('/')
+	//  --longpause <n>		duration of long pauses ('|')
+	//  --printAST			print AST for each module
+	//  --printRT			print root table for each module
+	//  --printJumps		print a list of jumps and addresses
+	//  --printCode			print the code output for each module
+	//  --incremental		reuse output of unchanged modules from the last build
+	//  --stable			keep modules where the last build put them
+	//  --pack <method>		bank packing method
+	//  --pack-time <ms>	time limit for exact packing
+	//  --size-only		report sizes and placement without writing anything
+	//  --time-report <file>	write the time taken by each phase of the build
+	//  --trace <file>		write trace events for the build
+	//  --profile <file>	sample the script call stack and write folded stacks
+	//  --profile-interval <us>	time between profiler samples
+	//  --split-labels		place modules in pieces split at their labels
+	//  -O					optimize jumps in the generated code
+	//  --merge-text		share one copy of repeated text
+	//  --outline <n>		outline repeated command expansions of at least n bytes
+	//  --compress <n>		compress text with a dictionary of up to n entries
+	//  --dictionary <f-l>	game dictionary entries compression may replace
+	//  --strip-unused		remove code that can't be reached
+	//  --roots <file>		read labels to keep from a file
+	//  --region <s-e>		place output in this region
+	//  --regions <file>	read regions from a file
+	//  --scan-free <n>		place output in runs of free bytes found in the ROM
+	//  --patch <file>		write a patch instead of modifying the ROM
+	//  --summary <file>	output summary file
+	//  --verbose			verbose output
+
+	int p = 1;
+	while(p < argc) {
+		if(!strcmp(argv[p],"-o")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no output file specified" << std::endl;
+				return -1;
+			}
+			outfile = argv[p++];
+		}
+		else if(!strcmp(argv[p], "--start") || !strcmp(argv[p], "-s"))
+		{
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no start address specified after -s" << std::endl;
+				return -1;
+			}
+			startstr = argv[p++];
+		}
+		else if(!strcmp(argv[p], "--end") || !strcmp(argv[p], "-e"))
+		{
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no end address specified after -e" << std::endl;
+				return -1;
+			}
+			endstr = argv[p++];
+		}
+		else if(!strcmp(argv[p], "-v")) {
+			printversion();
+			return 0;
+		}
+		else if(!strcmp(argv[p],"--libs")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no library path specified" << std::endl;
+				return -1;
+			}
+			libspath = argv[p++];
+		}
+		else if(!strcmp(argv[p], "-h") || !strcmp(argv[p], "--help") || !strcmp(argv[p], "?")) {
+			printusage();
+			return 0;
+		}
+		else if(!strcmp(argv[p],"-l")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no library file specified" << std::endl;
+				return -1;
+			}
+			std::cerr << "WARNING: -l flag deprecated. Use 'import' statement to include libraries." << std::endl;
+			libs.push_back(argv[p++]);
+		}
+		else if(!strcmp(argv[p],"-n") || !strcmp(argv[p], "--no-reset")) {
+			p++;
+			noreset = true;
+		}
+		else if(!strcmp(argv[p],"--nostdlibs")) {
+			p++;
+			nostdlibs = true;
+		}
+		else if(!strcmp(argv[p],"--cache")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no cache directory specified" << std::endl;
+				return -1;
+			}
+			cachedir = argv[p++];
+		}
+		else if(!strcmp(argv[p],"--precompile")) {
+			p++;
+			precompile = true;
+		}
+		else if(!strcmp(argv[p],"--incremental")) {
+			p++;
+			incremental = true;
+		}
+		else if(!strcmp(argv[p],"--pack")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no packing method specified" << std::endl;
+				return -1;
+			}
+			if(!BankPacker::MethodFromName(argv[p], packmethod)) {
+				std::cout << "argument error: unknown packing method '" << argv[p] << "'" << std::endl;
+				return -1;
+			}
+			p++;
+		}
+		else if(!strcmp(argv[p],"--pack-time")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no time limit specified" << std::endl;
+				return -1;
+			}
+			packtime = strtoul(argv[p++], NULL, 10);
+		}
+		else if(!strcmp(argv[p],"-O")) {
+			p++;
+			optimize = true;
+		}
+		else if(!strcmp(argv[p],"--merge-text")) {
+			p++;
+			mergetext = true;
+		}
+		else if(!strcmp(argv[p],"--outline")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no outlining size specified" << std::endl;
+				return -1;
+			}
+			outline = strtoul(argv[p++], NULL, 10);
+		}
+		else if(!strcmp(argv[p],"--compress")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no dictionary size specified" << std::endl;
+				return -1;
+			}
+			compress = strtoul(argv[p++], NULL, 10);
+		}
+		else if(!strcmp(argv[p],"--dictionary")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no dictionary range specified" << std::endl;
+				return -1;
+			}
+			char* end;
+			dictionaryfirst = strtoul(argv[p], &end, 10);
+			dictionarylast = dictionaryfirst;
+			if(*end == '-')
+				dictionarylast = strtoul(end + 1, &end, 10);
+			if(*end || end == argv[p] || dictionarylast < dictionaryfirst || dictionarylast > 767) {
+				std::cout << "argument error: bad dictionary range '" << argv[p] << "'" << std::endl;
+				return -1;
+			}
+			hasdictionary = true;
+			p++;
+		}
+		else if(!strcmp(argv[p],"--strip-unused")) {
+			p++;
+			strip = true;
+		}
+		else if(!strcmp(argv[p],"--roots")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no roots file specified" << std::endl;
+				return -1;
+			}
+			rootsfile = argv[p++];
+		}
+		else if(!strcmp(argv[p],"--size-only")) {
+			p++;
+			sizeonly = true;
+		}
+		else if(!strcmp(argv[p],"--time-report")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no time report file specified" << std::endl;
+				return -1;
+			}
+			timereport = argv[p++];
+		}
+		else if(!strcmp(argv[p],"--trace")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no trace file specified" << std::endl;
+				return -1;
+			}
+			tracefile = argv[p++];
+		}
+		else if(!strcmp(argv[p],"--profile")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no profile file specified" << std::endl;
+				return -1;
+			}
+			profilefile = argv[p++];
+		}
+		else if(!strcmp(argv[p],"--profile-interval")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no sampling interval specified" << std::endl;
+				return -1;
+			}
+			profileinterval = strtoul(argv[p++], NULL, 10);
+			if(profileinterval == 0) {
+				std::cout << "argument error: sampling interval must be at least 1 us" << std::endl;
+				return -1;
+			}
+		}
+		else if(!strcmp(argv[p],"--split-labels")) {
+			p++;
+			splitlabels = true;
+		}
+		else if(!strcmp(argv[p],"--region")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no region specified" << std::endl;
+				return -1;
+			}
+			unsigned int start, end;
+			if(!FreeSpace::ParseRegion(argv[p], start, end) || !freespace.Add(start, end)) {
+				std::cout << "argument error: bad region '" << argv[p] << "'" << std::endl;
+				return -1;
+			}
+			p++;
+		}
+		else if(!strcmp(argv[p],"--regions")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no region file specified" << std::endl;
+				return -1;
+			}
+			regionfile = argv[p++];
+		}
+		else if(!strcmp(argv[p],"--scan-free")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no minimum length specified" << std::endl;
+				return -1;
+			}
+			scanfree = strtoul(argv[p++], NULL, 10);
+		}
+		else if(!strcmp(argv[p],"--stable")) {
+			p++;
+			stable = true;
+		}
+		else if(!strcmp(argv[p],"--patch")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no patch file specified" << std::endl;
+				return -1;
+			}
+			patchfile = argv[p++];
+			if(Patch::FormatFromFilename(patchfile) == Patch::Unknown) {
+				std::cout << "argument error: patch file must end in .ips or .bps" << std::endl;
+				return -1;
+			}
+		}
+		else if(!strcmp(argv[p],"--summary") || !strcmp(argv[p], "--sum")) {
+			p++;
+			if(p >= argc) {
+				std::cout << "argument error: no summary file specified" << std::endl;
+				return -1;
+			}
+			summaryfile = argv[p++];
+		}
+		else if(!strcmp(argv[p],"--shortpause")) {
+			p++;
+			shortpause = (unsigned char)strtoul(argv[p++], NULL, 10);
+		}
+		else if(!strcmp(argv[p],"--longpause")) {
+			p++;
+			longpause = (unsigned char)strtoul(argv[p++], NULL, 10);
+		}
+		else if(!strcmp(argv[p],"--printAST")) {
+			p++;
+			printAST = true;
+		}
+		else if(!strcmp(argv[p],"--printRT")) {
+			p++;
+			printRT = true;
+		}
+		else if(!strcmp(argv[p],"--printJumps")) {
+			p++;
+			printJumps = true;
+		}
+		else if(!strcmp(argv[p],"--printCode")) {
+			p++;
+			printCode = true;
+		}
+		else if(!strcmp(argv[p],"--verbose"))
+		{
+			p++;
+			verbose = true;
+		}
+		else {
+			files.push_back(argv[p++]);
+		}
+	}
+
+
+
+	// The game's own text uses its dictionary, so compression can only
+	// replace entries the project says it has freed up
+	if(compress > 0 && !hasdictionary) {
+		std::cout << "argument error: --compress needs the --dictionary entries it may replace" << std::endl;
+		return -1;
+	}
+	if(compress > dictionarylast - dictionaryfirst + 1) {
+		std::cout << "argument error: --compress " << compress << " needs more entries than --dictionary "
+			<< dictionaryfirst << "-" << dictionarylast << " has" << std::endl;
+		return -1;
+	}
+
+	// Precompiling libraries doesn't involve a ROM at all
+	if(precompile)
+	{
+		Compiler compiler;
+		for(unsigned int i = 0; i < files.size(); ++i)
+			compiler.Precompile(files[i]);
+		compiler.Results();
+		return compiler.Failed();
+	}
+
+	if(!startstr.empty())
+	{
+		stringstream ss(startstr);
+		ss >> std::setbase(16) >> outadr;
+	}
+	else
+	{
+		// Default to start of HiROM file
+		outadr = 0xC00000;
+	}
+
+	if(!endstr.empty())
+	{
+		stringstream ss(endstr);
+		ss >> std::setbase(16) >> endadr;
+	}
+
+	// Tracing starts before the compiler, which starts loading the ROM
+	if(!tracefile.empty())
+		Trace::Enable();
+
+	// Create compiler and set options
+	Compiler compiler(outfile, outadr, endadr);
+	compiler.printAST = printAST;
+	compiler.printRT = printRT;
+	compiler.printCode = printCode;
+	compiler.printJumps = printJumps;
+	compiler.verbose = verbose;
+	compiler.libdir = libspath;
+	compiler.noreset = noreset;
+	compiler.nostdlibs = nostdlibs;
+	compiler.cachedir = cachedir;
+	compiler.patchfile = patchfile;
+	compiler.stable = stable;
+	compiler.packmethod = packmethod;
+	compiler.packtime = packtime;
+	compiler.splitlabels = splitlabels;
+	compiler.optimize = optimize;
+	compiler.mergetext = mergetext;
+	compiler.outline = outline;
+	compiler.compress = compress;
+	compiler.dictionaryfirst = dictionaryfirst;
+	compiler.dictionarylast = dictionarylast;
+	compiler.strip = strip;
+	compiler.sizeonly = sizeonly;
+	if(!timereport.empty())
+		compiler.timing.Enable();
+	if(!profilefile.empty())
+		compiler.profiler.Enable(profileinterval);
+	compiler.rootsfile = rootsfile;
+	compiler.freespace = freespace;
+	compiler.regionfile = regionfile;
+	compiler.scanfree = scanfree;
+	compiler.summaryfile = summaryfile;
+	if(incremental)
+		compiler.statefile = outfile + ".build";
+
+	/*
+	 * 7/25/2009:
+	 * Library loading has been fixed!
+	 */
+
+	for(unsigned int i = 0; i < libs.size(); ++i) {
+		compiler.LoadModule(libs[i]);
+	}
+
+	for(unsigned int i = 0; i < files.size(); ++i) {
+		compiler.LoadModule(files[i]);
+	}
+
+	// Do the stuff.
+	compiler.Compile();
+	if(sizeonly)
+		compiler.WriteSizeReport(std::cout);
+	else
+		compiler.WriteOutput();
+	if(!timereport.empty())
+		compiler.WriteTimeReport(timereport);
+	if(!tracefile.empty())
+		compiler.WriteTrace(tracefile);
+	if(!profilefile.empty())
+		compiler.WriteProfile(profilefile);
+	compiler.Results();
+
+	// Write summary file. With --size-only nothing went into the ROM, so the
+	// summary of the last build is left to match it.
+	if(!summaryfile.empty() && !sizeonly)
+	{
+		std::fstream file;
+		file.open(summaryfile.c_str(), std::ios_base::out|std::ios_base::trunc);
+		if(file.fail())
+		{
+			std::cerr << "Couldn't open " << summaryfile << " to write summary file." << std::endl;
+			return -1;
+		}
+		compiler.WriteSummary(file);
+	}
+
+	return compiler.Failed();
 }
\ No newline at end of file
@@ -0,0 +1,35 @@
+/* checksum implementation */
+
+#include "checksum.h"
+
+static unsigned int crctable[256];
+static bool crctable_ready = false;
+
+static void MakeCrcTable()
+{
+	for(unsigned int n = 0; n < 256; ++n) {
+		unsigned int c = n;
+		for(int k = 0; k < 8; ++k)
+			c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		crctable[n] = c;
+	}
+	crctable_ready = true;
+}
+
+unsigned int Crc32(const char* data, size_t len, unsigned int crc)
+{
+	if(!crctable_ready)
+		MakeCrcTable();
+
+	crc = ~crc;
+	for(size_t i = 0; i < len; ++i)
+		crc = crctable[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+unsigned long long Fnv1a64(const char* data, size_t len, unsigned long long h)
+{
+	for(size_t i = 0; i < len; ++i)
+		h = (h ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+	return h;
+}
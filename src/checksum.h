@@ -0,0 +1,13 @@
+/* checksums */
+#pragma once
+
+#include <cstddef>
+
+// Standard CRC-32 (as used by zip, PNG and BPS patches). To checksum data in
+// pieces, pass the result for the previous piece as 'crc'.
+unsigned int Crc32(const char* data, size_t len, unsigned int crc = 0);
+
+// 64-bit FNV-1a hash. As with Crc32, pass a previous result as 'h' to
+// hash data in pieces.
+unsigned long long Fnv1a64(const char* data, size_t len,
+	unsigned long long h = 14695981039346656037ULL);
@@ -1,753 +1,2264 @@
-/* compiler class implementation */
-
-#include "compiler.h"
-
-#include <algorithm>
-#include <fstream>
-#include <iostream>
-#include <vector>
-#include <iomanip>
-#include <sstream>
-
-#include <experimental/filesystem>
-namespace fs = std::experimental::filesystem::v1;
-
-#include "module.h"
-
-#include "anchor.h"
-#include "ast.h"
-#include "bytechunk.h"
-#include "module.h"
-#include "symboltable.h"
-#include "exception.h"
-
-using namespace std;
-
-/*
- * Reports a compiler error
- */
-void Compiler::Error(const string& msg)
-{
-	std::cerr << " error: " << msg << std::endl;
-	errorcount++;
-	failed = true;
-}
-
-
-/*
- * Reports a compiler warning
- */
-void Compiler::Warning(const string& msg)
-{
-	std::cerr << " warning: " << msg << std::endl;
-	warningcount++;
-}
-
-
-/*
- * Constructs a compiler object targeting the specified output file and address
- */
-Compiler::Compiler(const string& romfile, unsigned int adr, unsigned int endadr)
-{
-	failed = false;
-	errorcount = 0;
-	warningcount = 0;
-	filebuffer = NULL;
-	libtable = NULL;
-	filename = romfile;
-	verbose = false;
-	noreset = false;
-	nostdlibs = false;
-
-	// Open the file
-	ifstream file(filename.c_str(), ifstream::binary);
-
-	if(file.fail()) {
-		Error("failed to open file " + filename + " for reading.");
-		return;
-	}
-
-	// Ensure that the address given is valid
-	if(MapVirtualAddress(adr) == 0xFBADF00D) {
-		stringstream ss;
-		ss << "bad virtual address for start: " << std::setbase(16) << adr;
-		Error(ss.str());
-		return;
-	}
-	if((endadr != 0) && MapVirtualAddress(endadr) == 0xFBADF00D) {
-		stringstream ss;
-		ss << "bad virtual address for end: " << std::setbase(16) << endadr;
-		Error(ss.str());
-		return;
-	}
-
-	file.seekg(0, ifstream::end);
-	filesize = file.tellg();
-	file.seekg(0);
-	filebuffer = new char[filesize];
-	file.read(filebuffer, filesize);
-	file.close();
-
-	// Check for header
-	has_header = ((filesize & 0x200) != 0);
-
-	// Ensure ROM has integral number of banks
-	if( filesize & 0xFDFF ) {
-		stringstream ss;
-		ss << filename << " has incorrect filesize: " << filesize << " bytes";
-		Error(ss.str());
-	}
-
-	this->outadr = adr;
-	this->endadr = endadr;
-	libtable = new SymbolTable();
-}
-
-Compiler::~Compiler()
-{
-	while(!modules.empty()) {
-		delete modules.back();
-		modules.pop_back();
-	}
-// NOTE: libs no longer owns the pointers
-//	while(!libs.empty()) {
-//		delete libs.back();
-//		libs.pop_back();
-//	}
-	while(!romwrites.empty())
-	{
-		delete romwrites.back();
-		romwrites.pop_back();
-	}
-	delete libtable;
-	delete[] filebuffer;
-}
-
-
-/*
- * Writes buffer to the output file
- */
-void Compiler::WriteOutput()
-{
-	if(failed) return;
-	ofstream file(filename.c_str(), ofstream::binary);
-
-	if(file.fail()) {
-		Error("failed to open file " + filename + " for writing.");
-		return;
-	}
-	file.seekp(0);
-	file.write(filebuffer, filesize);
-	file.close();
-}
-
-/*
- * Loads, parses, and performs initial typechecking of a code file
- */
-Module* Compiler::LoadModule(const std::string &filename)
-{
-	//if(failed) return NULL;
-
-	//if(verbose)
-	//	std::cerr << "Compiling " << filename << "..." << std::endl;
-
-	Module* m = new Module(filename, this);
-
-	if(m->Failed()) {
-		failed = true;
-		return NULL;
-	}
-
-	if(printAST)
-		m->PrintAST();
-
-	// TODO:
-	// instead of SetLibTable, we should use m->Include(othermodule).
-	//m->SetLibTable(libtable);
-	string name = m->GetName();
-	
-	if(GetModule(name) != NULL) {
-		Error("attempt to redefine module " + name + "; module names must be unique");
-		return NULL;
-	}
-
-	modules.push_back(m);
-	return m;
-}
-
-
-/*
- * Searches for a module with a given name in the include path and
- * returns a relative path to it, if found.
- *
- * The directories checked are as follows:
- *
- *  0. If the path is complete, no searching is done
- *  1. The directory which contains the file performing the import.
- *  2. The project working directory
- *  3. The compiler's /lib directory.
- */
-
-string Compiler::FindModule(const string& name, const string& filedir)
-{
-	// Complete paths aren't looked for in include directories
-	if (fs::path(name).is_absolute())
-		return fs::exists( name )? name : "";
-
-	// First, try in the provided file directory.
-	fs::path base(filedir);
-	base /= name;
-	if( fs::exists( base ) )
-		return base.string();
-
-	// Next, try in the compilation working directory
-	if( fs::exists( name ) )
-		return name;
-
-	// Finally, check the libs directory.
-	fs::path libpath = fs::path(libdir) / name;
-	if( fs::exists(libpath) )
-		return libpath.string();
-
-	return "";
-}
-
-/*
- * Searches the include paths for a module and loads it if found.
- */
-Module* Compiler::FindAndLoadModule(const string& name, const string& filedir)
-{
-	string found = FindModule(name, filedir);
-
-	if(found.empty())
-		return NULL;
-
-	return LoadModule(found);
-}
-
-/*
- * Returns the module with the given name
- */
-Module* Compiler::GetModule(const std::string &name)
-{
-	for(unsigned int i = 0; i < modules.size(); ++i) {
-		string mname = modules[i]->GetName();
-		if(modules[i]->GetName() == name)
-			return modules[i];
-	}
-	return NULL;
-}
-
-
-/*
- * Evaluates all modules and produces output
- */
-void Compiler::Compile()
-{
-	// Don't try to execute if a previous error stopped compilation
-	if(failed)
-		return;
-
-	if(verbose) {
-		// This is a pretty flagrant abuse of cerr. Oh well.
-		std::cerr << "Compiling modules..." << std::endl;
-	}
-
-	string resetfile = filename + ".reset.txt";
-
-	try
-	{
-		if(!noreset)
-			ApplyResetInfo(resetfile);
-
-		ProcessImports();
-		EvaluateModules();
-		AssignModuleAddresses();
-		OutputModules();
-
-		if(!failed && !noreset)
-			WriteResetInfo(resetfile);
-
-		DoDelayedWrites();
-	}
-	catch(Exception& e)
-	{
-		Error(e.GetMessage());
-	}
-}
-
-void Compiler::ProcessImports()
-{
-
-	// TO BEGIN WITH, we have the set of modules that are explicitly
-	// included in the project command line. We will extend this set
-	// by also checking the modules imported by any of the modules
-	// in the project. These in turn might import other modules, so
-	// we need to traverse the whole dependency network.
-	//
-	// Initially we have a set of modules needing to be processed.
-	//
-	// Each module processed, we remove from the list.
-	//
-	// When processing a module, we check its list of imports. For
-	// each imported module name, we search for a loaded module with
-	// that name. If the module is already loaded, we continue.
-	// If the module is not loaded, we search for it in the include
-	// paths and, if it is found, load it and add it to the list of
-	// modules that need processing.
-	//
-
-	vector<Module*> remaining = modules;
-
-	while(!remaining.empty()) {
-		Module* m = remaining.back();
-		remaining.pop_back();
-
-		if(!nostdlibs) {
-			m->AddImport( (fs::path(libdir) / "std.ccs").string() );
-			m->AddImport( (fs::path(libdir) / "stdarg.ccs").string() );
-		}
-
-		vector<string> imports = m->GetImports();
-
-		for(vector<string>::const_iterator it = imports.begin();
-				it != imports.end(); ++it)
-		{
-			Module *imp;
-			string filename = *it;
-
-			fs::path module_path( m->GetFileName() );
-			fs::path module_dir = module_path.parent_path();
-
-			string name = Module::NameFromFilename(filename);
-
-			imp = GetModule(name);
-
-			// If the imported module doesn't exist already, load it
-			if(!imp) {
-				imp = FindAndLoadModule( filename, module_dir.string() );
-
-				// We'll need to process the newly loaded module's imports as well
-				if( imp )
-					remaining.push_back(imp);
-			}
-			else {
-				// Check this new import; if it refers to the same file that we've already
-				// included in the project, it's okay; otherwise it's an error, since module
-				// names must be unique.
-				fs::path newpath		( FindModule(filename, module_dir.string()) );
-				fs::path existingpath	( imp->GetFileName() );
-
-				if( !fs::equivalent(existingpath, newpath) ) {
-					throw Exception("attempted to import " + newpath.string() + "; module name collides with " + existingpath.string());
-				}
-			}
-
-
-			if( !imp )
-				throw Exception("Couldn't find module '" + filename + "'");
-
-			m->Include( imp );
-		}
-	}
-}
-
-
-/*
- * Evaluates all loaded modules
- */
-void Compiler::EvaluateModules()
-{
-	// Evaluate each module to determine its code size
-	for(unsigned int i = 0; i < modules.size(); ++i)
-	{
-		Module* m = modules[i];
-
-		if(verbose && m->GetName().substr(0,3) != "std")	// This is a hack.
-			std::cerr << "Evaluating " << m->GetFileName() << "..." << std::endl;
-		m->Execute();
-
-		if(m->Failed())
-			failed = true;
-
-		if(printRT && m->GetName().substr(0,3) != "std")
-			m->PrintRootTable();
-
-		// Any module larger than 64K is a fatal error.
-		if(m->GetCodeSize() > 0x10000)
-			throw Exception("module '" + m->GetName() + "' exceeds 64KB");
-	}
-}
-
-/*
- * Predicate for comparing modules (used by AssignModuleAddresses)
- */
-bool module_pred(Module* a, Module* b) {
-	return a->GetCodeSize() > b->GetCodeSize();
-}
-
-/*
- * Assigns base addresses to all modules
- */
-void Compiler::AssignModuleAddresses()
-{
-	if(failed)
-		return;
-
-	// Here, we set the base address of each module.
-	// We do this by repeatedly selecting the largest module that will fit between
-	// the current base and the next bank boundary, and assigning it that base address,
-	// then increasing the base address by the size of the module. If we do not find a
-	// module that will fit, we increase the base address to the start of the next bank.
-
-	vector<Module*> sorted = modules;
-	std::sort(sorted.begin(), sorted.end(), module_pred);
-	unsigned int base = this->outadr;
-
-	totalfrag = 0;
-	actual_start = -1;
-	actual_end = -1;
-
-	while(!sorted.empty())
-	{
-		vector<Module*>::iterator i;
-		bool found = false;
-		for(i = sorted.begin(); i != sorted.end(); ++i)
-		{
-			unsigned int size = (*i)->GetCodeSize();		
-			if((base & 0xFFFF) + size <= 0x10000) 
-			{
-				// Check for overwriting maximum address
-				if((endadr > 0) && (base + size >= endadr))
-					throw Exception("error: module " + (*i)->GetName() + " exceeded specified end address -- aborting");
-
-				// Update write bounds
-				if(actual_start == -1)
-					actual_start = base;
-				if(sorted.size() == 1)
-					actual_end = base + size;
-
-				(*i)->SetBaseAddress(base);
-				base += size;
-				sorted.erase(i);
-				found = true;
-				break;
-			}
-		}
-		if(!found)
-		{
-			unsigned int nextbase = GetNextBank(base);
-			if(!nextbase)
-				throw Exception("fatal error - ran out of space writing module " + sorted[0]->GetName());
-
-			totalfrag += (nextbase - base);
-			base = nextbase;
-		}
-	}
-}
-
-
-/*
- * Resolves references and writes modules to the output file
- */
-void Compiler::OutputModules()
-{
-	if(failed)
-		return;
-
-	if(verbose)
-		std::cerr << "Writing output to ROM..." << std::endl;
-
-	// Next, resolve all references in every module and write it to the buffer
-	for(unsigned int i = 0; i < modules.size(); ++i) {
-		Module* m = modules[i];
-		m->ResolveReferences();
-
-		unsigned int outadr = MapVirtualAddress(m->GetBaseAddress());
-
-		if(outadr == 0xFBADF00D) {
-			stringstream ss;
-			ss << "Module has bad virtual address (" << std::setbase(16) << m->GetBaseAddress() << "), aborting";
-			throw Exception(ss.str());
-		}
-
-		m->WriteCode(filebuffer, MapVirtualAddress(m->GetBaseAddress()), filesize);
-
-		if(printJumps && m->GetName().substr(0,3) != "std")
-			m->PrintJumps();
-		if(printCode && m->GetName().substr(0,3) != "std")
-			m->PrintCode();
-	}
-}
-
-
-
-/*
- * Bank management and virtual address translation functions
- */
-
-/*
- * Returns the address of the next virtual bank above the bank
- * containing the given virtual address.
- * Returns zero if there is no valid higher bank.
- */
-unsigned int Compiler::GetNextBank(unsigned int adr)
-{
-	// Virtual banks are physically contiguous between two groups:
-	//  [C0, FF], which are mapped to [00, 3F], and
-	//  [40, 5F], which are mapped to [40, 5F].
-	// However, we treat bank 40 as unusable, because some expanders will
-	// copy the upper half of bank C0 into the upper half of bank 40 in
-	// the process of 48Mbit ExHiROM expansion. I'm not entirely sure if
-	// this is necessary for EarthBound, but better safe than sorry for now.
-	int bank = (adr & 0xFF0000) >> 16;
-
-	if(bank >= 0xC0 && bank < 0xFF)
-		return (bank + 1) << 16;
-	if(bank == 0xFF)
-		return (0x41) << 16;
-	if(bank >= 0x41 && bank < 0x5F)
-		return (bank + 1) << 16;
-	return 0;
-}
-
-/*
- * Returns the physical address corresponding to a given virtual address.
- * Returns 0xFBADF00D if the virtual address is invalid.
- */
-
-unsigned int Compiler::MapVirtualAddress(unsigned int vadr)
-{
-	if(vadr >= 0xC00000 && vadr <= 0xFFFFFF)
-		return vadr - 0xC00000 + (has_header? 0x200 : 0);
-	if(vadr >= 0x400000 && vadr <= 0x5FFFFF)
-		return vadr + (has_header? 0x200 : 0);
-	return 0xFBADF00D;
-}
-
-
-/*
- * Registers a delayed write to the output file
- */
-void Compiler::RegisterDelayedWrite(RomAccess* w)
-{
-	if(failed) return;
-	romwrites.push_back(w);
-}
-
-/*
- * Performs all direct ROM access instructions registered
- */
-void Compiler::DoDelayedWrites()
-{
-	if(failed) return;
-	for(unsigned int i = 0; i < romwrites.size(); ++i)
-	{
-		// Resolve any references
-		romwrites[i]->ResolveReferences();
-
-		// Get the physical address of the write
-		unsigned int padr = MapVirtualAddress(romwrites[i]->GetVirtualAddress());
-		if(padr == 0xFBADF00D) {
-			stringstream ss;
-			ss << "error in ROM write statement: bad virtual address: " << std::setbase(16)
-				<< romwrites[i]->GetVirtualAddress();
-			throw Exception(ss.str());
-		}
-		romwrites[i]->DoWrite(filebuffer, padr, filesize);
-	}
-}
-
-
-/*
- * Writes a "reset info" file, which contains information about the changes
- * the compiler made to the output file in this compilation. Specifically:
- *  - the range of primary compiled output
- *  - the previous contents of any ROM direct-write areas
- *
- * Format is text:
- * [start address] [end address]
- * {[hex address] [hex bytes] [newline]}
- *
- * e.g.,
- * F00000 F00412
- * F02000 0a 0b 0c 11 22 33
- * F15a02 00 00 00 00 00 00 00 00 00 00
- */
-void Compiler::WriteResetInfo(const std::string &filename)
-{
-	ofstream file(filename.c_str());
-
-	if(file.fail())
-		throw Exception("couldn't create info file '" + filename + "'");
-
-	file << std::hex << std::setfill('0');
-
-	if(actual_start == -1 || actual_start == actual_end) {
-		file << std::setw(6) << 0 << " " << 0 << std::endl;
-	}
-	else {
-		file << std::setw(6) << actual_start
-			 << " " << actual_end << std::endl;
-	}
-
-	for(vector<RomAccess*>::const_iterator it = romwrites.begin();
-			it != romwrites.end(); ++it)
-	{
-		RomAccess* w = *it;
-
-		unsigned int padr = MapVirtualAddress(w->GetVirtualAddress());
-		unsigned int len = w->cache_value->GetSize();
-
-		if(padr != 0xFBADF00D) {
-
-			file << std::hex << std::setfill('0') << std::setw(6) << w->GetVirtualAddress() << " ";
-
-			// Read data from the ROM at padr
-			for(unsigned int i = 0; i < len; ++i) {
-				unsigned int tmp = static_cast<unsigned char>(filebuffer[padr+i]);
-				file << std::hex << std::setw(2) << tmp << " ";
-			}
-
-			file << std::endl;
-		}
-	}
-
-	if(verbose)
-		std::cerr << "Final output written from " << std::setbase(16) << actual_start
-			<< " to " << actual_end << std::endl;
-
-}
-
-void Compiler::ApplyResetInfo(const std::string& filename)
-{
-	ifstream file(filename.c_str());
-
-	if(file.fail())
-		return;
-
-	int start,end;
-
-	// First read the 'clear' range
-	file >> hex >> start >> end;
-
-	if(verbose)
-		std::cerr << "Zeroing previous output (" << std::setbase(16) << start << " to " << end << ")" << std::endl;
-	start = Compiler::MapVirtualAddress(start);
-	end = Compiler::MapVirtualAddress(end);
-	for(int i = start; (i >= 0) && (i < filesize) && (i < end); i++)
-		filebuffer[i] = 0;
-
-	// Next restore whatever we had written via ROM[] statements previously
-	while(!file.eof()) {
-		string line;
-		getline( file, line );
-
-		if( line.empty()) continue;
-
-		unsigned int vadr;
-		stringstream ss(line);
-		ss >> hex >> vadr;
-
-		unsigned int padr = MapVirtualAddress( vadr );
-
-		while(!ss.eof()) {
-			unsigned int byte;
-			ss >> byte;
-			if(ss.fail()) break;
-			filebuffer[padr++] = static_cast<unsigned char>(byte);
-		}
-	}
-}
-
-
-
-/*
- * Prints a summary of the number of errors and warnings issued, if any
- */
-void Compiler::Results()
-{
-	if(!verbose && errorcount == 0 && warningcount == 0) return;
-	std::cerr << std::endl << std::dec << errorcount << " error(s), " << warningcount << " warning(s)" << std::endl;
-}
-
-
-using std::endl;
-using std::setbase;
-using std::setw;
-using std::setfill;
-using std::left;
-
-void Compiler::WriteSummary(std::ostream& out)
-{
-	out << filename << std::endl;
-	out << "CCScript Compilation Summary" << endl;
-	out << "============================" << endl;
-	out << endl << endl;
-
-	if(failed)
-	{
-		out << "COMPILATION FAILED";
-			return;
-	}
-	//
-	// Statistics
-	//
-	out << "Compilation statistics" << endl;
-	out << "=================================================================" << endl;
-	out << "Compilation start:           $" << setbase(16) << actual_start << endl;
-	out << "Compilation end:             $" << setbase(16) << actual_end << endl;
-	out << "Total compiled size:         " << setbase(10) << actual_end - actual_start << " bytes" << endl;
-	out << "Fragmented space:            " << setbase(10) << totalfrag << " bytes" << endl;
-	out << "-----------------------------------------------------------------" << endl;
-	out << endl << endl;
-
-	//
-	// Module summaries
-	//
-	out << "Module information" << endl;
-	out << "=================================================================" << endl;
-	out << "Name                         Address     Size" << endl;
-	out << "-----------------------------------------------------------------" << endl;
-	for(unsigned int i = 0; i < modules.size(); ++i)
-	{
-		Module* m = modules[i];
-
-		out << setfill(' ') << setw(29) << left << m->GetName() <<
-			"$" << setw(12) << left << setbase(16) << m->GetBaseAddress() <<
-			setw(6) << left << setbase(10) << m->GetCodeSize() << " bytes" << endl;
-	}
-	out << "-----------------------------------------------------------------" << endl;
-	out << endl << endl;
-
-
-	//
-	// Label locations
-	//
-	out << "Label locations" << endl;
-	out << "=================================================================" << endl << endl;
-	for(unsigned int i = 0; i < modules.size(); ++i)
-	{
-		Module* m = modules[i];
-
-		out << "Labels in module " << m->GetName() << endl;
-		out << "Name                         Address" << endl;
-		out << "-----------------------------------------------------------------" << endl;
-
-		const std::map<std::string,Anchor*>& jumps = m->GetRootTable()->GetJumpTable();
-
-		std::map<string,Anchor*>::const_iterator j;
-		for(j = jumps.begin(); j != jumps.end(); ++j) {
-			// Skip internal labels
-			if(j->first.empty() || !isalpha(j->first.at(0)))
-				continue;
-
-			out << left << setw(28) << j->first << ' ';
-			out << "$" << setbase(16) << j->second->GetTarget() << endl;
-		}
-		out << "-----------------------------------------------------------------" << endl;
-		out << endl << endl;
-
-	}
-}
-
+/* compiler class implementation */
+
+#include "compiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <iomanip>
+#include <sstream>
+
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem::v1;
+
+#include "module.h"
+
+#include "anchor.h"
+#include "ast.h"
+#include "bytechunk.h"
+#include "module.h"
+#include "symboltable.h"
+#include "exception.h"
+#include "resetjournal.h"
+#include "patch.h"
+#include "checksum.h"
+#include "intervalset.h"
+#include "peephole.h"
+#include "tailmerge.h"
+#include "outliner.h"
+#include "textcompress.h"
+#include "deadcode.h"
+#include "trace.h"
+
+using namespace std;
+
+/*
+ * Reports a compiler error
+ */
+void Compiler::Error(const string& msg)
+{
+	std::cerr << " error: " << msg << std::endl;
+	errorcount++;
+	failed = true;
+}
+
+
+/*
+ * Reports a compiler warning
+ */
+void Compiler::Warning(const string& msg)
+{
+	std::cerr << " warning: " << msg << std::endl;
+	warningcount++;
+}
+
+
+/*
+ * Sets the initial state shared by all constructors
+ */
+void Compiler::Init()
+{
+	failed = false;
+	errorcount = 0;
+	warningcount = 0;
+	filebuffer = NULL;
+	filesize = 0;
+	romloadtime = 0;
+	romwaittime = 0;
+	libtable = NULL;
+	verbose = false;
+	noreset = false;
+	nostdlibs = false;
+	stable = false;
+	packmethod = BankPacker::Greedy;
+	splitlabels = false;
+	optimize = false;
+	optimizedbytes = 0;
+	mergetext = false;
+	outline = 0;
+	outlinedbytes = 0;
+	compress = 0;
+	dictionaryfirst = 0;
+	dictionarylast = 0;
+	compressedbytes = 0;
+	dictionarysize = 0;
+	strip = false;
+	strippedbytes = 0;
+	sizeonly = false;
+	packtime = 1000;
+	scanfree = 0;
+	banksused = 0;
+	bankbound = 0;
+	packtimedout = false;
+	keptmodules = 0;
+	repacked = false;
+	changedbytes = -1;
+}
+
+/*
+ * Constructs a compiler object with no output file, for operations
+ * that work on modules alone (such as precompiling libraries)
+ */
+Compiler::Compiler()
+{
+	Init();
+	outadr = 0;
+	endadr = 0;
+	has_header = false;
+}
+
+/*
+ * Constructs a compiler object targeting the specified output file and address
+ */
+Compiler::Compiler(const string& romfile, unsigned int adr, unsigned int endadr)
+{
+	Init();
+	filename = romfile;
+
+	// Only the size is needed up front; the contents are loaded later
+	std::error_code ec;
+	uintmax_t size = fs::file_size(filename, ec);
+
+	if(ec) {
+		Error("failed to open file " + filename + " for reading.");
+		return;
+	}
+
+	// Ensure that the address given is valid
+	if(MapVirtualAddress(adr) == 0xFBADF00D) {
+		stringstream ss;
+		ss << "bad virtual address for start: " << std::setbase(16) << adr;
+		Error(ss.str());
+		return;
+	}
+	if((endadr != 0) && MapVirtualAddress(endadr) == 0xFBADF00D) {
+		stringstream ss;
+		ss << "bad virtual address for end: " << std::setbase(16) << endadr;
+		Error(ss.str());
+		return;
+	}
+
+	filesize = static_cast<int>(size);
+
+	// Check for header
+	has_header = ((filesize & 0x200) != 0);
+
+	// Ensure ROM has integral number of banks
+	if( filesize & 0xFDFF ) {
+		stringstream ss;
+		ss << filename << " has incorrect filesize: " << filesize << " bytes";
+		Error(ss.str());
+	}
+
+	this->outadr = adr;
+	this->endadr = endadr;
+	libtable = new SymbolTable();
+
+	// Start reading the ROM in the background
+	romload = std::async(std::launch::async, &Compiler::LoadRom, this);
+}
+
+Compiler::~Compiler()
+{
+	if(romload.valid())
+		romload.wait();
+
+	while(!modules.empty()) {
+		delete modules.back();
+		modules.pop_back();
+	}
+	modulesbyname.clear();
+// NOTE: libs no longer owns the pointers
+//	while(!libs.empty()) {
+//		delete libs.back();
+//		libs.pop_back();
+//	}
+	while(!romwrites.empty())
+	{
+		delete romwrites.back().access;
+		romwrites.pop_back();
+	}
+	delete libtable;
+}
+
+
+/*
+ * Loads the ROM image. Runs on a background thread started by the
+ * constructor, so it mustn't touch anything but the image.
+ */
+bool Compiler::LoadRom()
+{
+	Trace::Span span("rom", "ROM load");
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	bool ok = rom.Open(filename);
+	if(ok)
+		rom.Prefetch();
+
+	romloadtime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	return ok;
+}
+
+/*
+ * Blocks until the background ROM load has finished, and sets up the
+ * file buffer. Throws if the ROM couldn't be read.
+ */
+void Compiler::WaitForRom()
+{
+	if(!romload.valid())
+		return;
+
+	TimeReport::Timer timer(timing, "ROM wait");
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	bool ok = romload.get();
+	romwaittime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	if(verbose)
+		std::cerr << "ROM loaded in " << std::fixed << std::setprecision(1) << romloadtime
+			<< " ms (waited " << romwaittime << " ms)" << std::endl;
+
+	if(!ok || rom.GetSize() != filesize)
+		throw Exception("failed to read file " + filename);
+
+	filebuffer = rom.GetData();
+}
+
+/*
+ * Writes the modified parts of the buffer back to the output file,
+ * or to a patch file if one was requested
+ */
+void Compiler::WriteOutput()
+{
+	if(failed) return;
+
+	TimeReport::Timer timer(timing, "write");
+
+	if(!patchfile.empty()) {
+		if(verbose)
+			std::cerr << "Writing patch for " << std::dec << rom.GetDirtySize() << " bytes in "
+				<< rom.GetDirtyRanges().size() << " range(s) to " << patchfile << std::endl;
+		try {
+			Patch::Write(patchfile, Patch::FormatFromFilename(patchfile), rom);
+		}
+		catch(Exception& e) {
+			Error(e.GetMessage());
+		}
+		return;
+	}
+
+	if(verbose)
+		std::cerr << "Writing " << std::dec << rom.GetDirtySize() << " bytes in "
+			<< rom.GetDirtyRanges().size() << " range(s) to " << filename << std::endl;
+
+	if(!rom.Flush())
+		Error("failed to write to file " + filename);
+}
+
+/*
+ * Loads, parses, and performs initial typechecking of a code file
+ */
+Module* Compiler::LoadModule(const std::string &filename)
+{
+	//if(failed) return NULL;
+
+	//if(verbose)
+	//	std::cerr << "Compiling " << filename << "..." << std::endl;
+
+	Module* m;
+	{
+		Trace::Span span("module", "load");
+		span.Arg("file", filename);
+		m = new Module(filename, this);
+	}
+
+	if(m->Failed()) {
+		failed = true;
+		return NULL;
+	}
+
+	if(printAST)
+		m->PrintAST();
+
+	// TODO:
+	// instead of SetLibTable, we should use m->Include(othermodule).
+	//m->SetLibTable(libtable);
+	string name = m->GetName();
+	
+	if(GetModule(name) != NULL) {
+		Error("attempt to redefine module " + name + "; module names must be unique");
+		return NULL;
+	}
+
+	modules.push_back(m);
+	modulesbyname[name] = m;
+	return m;
+}
+
+
+/*
+ * Parses a module and writes a precompiled image of it next to its source,
+ * to be picked up by later compilations instead of parsing the source.
+ */
+bool Compiler::Precompile(const std::string& filename)
+{
+	Module m(filename, this);
+
+	if(m.Failed()) {
+		failed = true;
+		return false;
+	}
+
+	if(!m.WriteImage()) {
+		Error("couldn't write precompiled image for " + filename);
+		return false;
+	}
+	return true;
+}
+
+
+/*
+ * Searches for a module with a given name in the include path and
+ * returns a relative path to it, if found. Results are cached, so
+ * repeated imports of a module from one directory cost no file system
+ * lookups after the first.
+ */
+string Compiler::FindModule(const string& name, const string& filedir)
+{
+	string key = filedir;
+	key += '\0';
+	key += name;
+
+	unordered_map<string, string>::const_iterator it = resolvedpaths.find(key);
+	if(it != resolvedpaths.end())
+		return it->second;
+
+	string found = SearchIncludePaths(name, filedir);
+	resolvedpaths[key] = found;
+	return found;
+}
+
+/*
+ * Does the actual include path search for FindModule.
+ *
+ * The directories checked are as follows:
+ *
+ *  0. If the path is complete, no searching is done
+ *  1. The directory which contains the file performing the import.
+ *  2. The project working directory
+ *  3. The compiler's /lib directory.
+ */
+
+string Compiler::SearchIncludePaths(const string& name, const string& filedir)
+{
+	// Complete paths aren't looked for in include directories
+	if (fs::path(name).is_absolute())
+		return fs::exists( name )? name : "";
+
+	// First, try in the provided file directory.
+	fs::path base(filedir);
+	base /= name;
+	if( fs::exists( base ) )
+		return base.string();
+
+	// Next, try in the compilation working directory
+	if( fs::exists( name ) )
+		return name;
+
+	// Finally, check the libs directory.
+	fs::path libpath = fs::path(libdir) / name;
+	if( fs::exists(libpath) )
+		return libpath.string();
+
+	return "";
+}
+
+/*
+ * Returns the canonical form of a path to an existing file, with symbolic
+ * links and relative components resolved, for comparing file identities.
+ * Results are cached.
+ */
+const string& Compiler::CanonicalPath(const string& path)
+{
+	unordered_map<string, string>::const_iterator it = canonicalpaths.find(path);
+	if(it != canonicalpaths.end())
+		return it->second;
+
+	string canonical;
+	try {
+		canonical = fs::canonical(path).string();
+	}
+	catch(fs::filesystem_error&) {
+		canonical = fs::absolute(path).string();
+	}
+	return canonicalpaths[path] = canonical;
+}
+
+/*
+ * Returns true if a file is in the library directory, or below it, where
+ * precompiled module images are installed
+ */
+bool Compiler::IsLibraryFile(const string& path)
+{
+	if(libdir.empty())
+		return false;
+
+	const string& lib = CanonicalPath(libdir);
+	const string& file = CanonicalPath(path);
+	return file.size() > lib.size() && file.compare(0, lib.size(), lib) == 0
+		&& (file[lib.size()] == '/' || file[lib.size()] == '\\');
+}
+
+/*
+ * Searches the include paths for a module and loads it if found.
+ */
+Module* Compiler::FindAndLoadModule(const string& name, const string& filedir)
+{
+	string found = FindModule(name, filedir);
+
+	if(found.empty())
+		return NULL;
+
+	return LoadModule(found);
+}
+
+/*
+ * Returns the module with the given name
+ */
+Module* Compiler::GetModule(const std::string &name)
+{
+	unordered_map<string, Module*>::const_iterator it = modulesbyname.find(name);
+	if(it == modulesbyname.end())
+		return NULL;
+	return it->second;
+}
+
+
+/*
+ * Evaluates all modules and produces output
+ */
+void Compiler::Compile()
+{
+	// Don't try to execute if a previous error stopped compilation
+	if(failed)
+		return;
+
+	if(verbose) {
+		// This is a pretty flagrant abuse of cerr. Oh well.
+		std::cerr << "Compiling modules..." << std::endl;
+	}
+
+	string resetfile = filename + ".reset";
+
+	try
+	{
+		ProcessImports();
+		EvaluateModules();
+
+		// Evaluation doesn't touch the ROM, so the reset is done afterwards
+		// to give the background load as long as possible to finish
+		if(!noreset) {
+			TimeReport::Timer timer(timing, "reset I/O");
+			ApplyResetInfo(resetfile);
+		}
+
+		{
+			TimeReport::Timer timer(timing, "place");
+
+			// Without a reset file to take the previous layout from, fall back
+			// to the last summary
+			if((stable || sizeonly) && previouslayout.empty() && !summaryfile.empty())
+				ReadSummaryLayout(summaryfile);
+
+			// Scanning for free space has to wait for the reset, so that the
+			// space used by the last build shows up as free again
+			if(!regionfile.empty())
+				freespace.ReadFile(regionfile);
+			if(scanfree > 0) {
+				WaitForRom();
+				freespace.Scan(filebuffer, filesize, has_header ? 0x200 : 0, scanfree);
+			}
+
+			AssignModuleAddresses();
+		}
+
+		// Where everything would go is all that's wanted; nothing is
+		// resolved or written
+		if(sizeonly)
+			return;
+
+		OutputModules();
+
+		{
+			TimeReport::Timer timer(timing, "delayed writes");
+			PrepareDelayedWrites();
+		}
+
+		// When writing a patch the ROM itself is never changed, so there's
+		// nothing to undo next time
+		if(!failed && !noreset && patchfile.empty()) {
+			TimeReport::Timer timer(timing, "reset I/O");
+			WriteResetInfo(resetfile);
+		}
+
+		{
+			TimeReport::Timer timer(timing, "delayed writes");
+			DoDelayedWrites();
+			CheckOverlaps();
+		}
+
+		if(!failed && !statefile.empty() && compress == 0 && !strip && outline == 0 && !mergetext) {
+			TimeReport::Timer timer(timing, "build state");
+			SaveBuildState();
+		}
+
+		if(stable && !failed) {
+			// A patch is made against the original ROM, not the previous build
+			if(patchfile.empty())
+				changedbytes = rom.CountChangedBytes();
+
+			if(verbose) {
+				std::cerr << "Kept " << std::dec << keptmodules << " of " << modules.size()
+					<< " modules in place";
+				if(changedbytes >= 0)
+					std::cerr << "; " << changedbytes << " bytes changed since the last build";
+				std::cerr << std::endl;
+			}
+		}
+	}
+	catch(Exception& e)
+	{
+		Error(e.GetMessage());
+	}
+}
+
+void Compiler::ProcessImports()
+{
+	// Loading the modules found is timed as parsing, not as part of this
+	TimeReport::Timer timer(timing, "import discovery");
+
+	// TO BEGIN WITH, we have the set of modules that are explicitly
+	// included in the project command line. We will extend this set
+	// by also checking the modules imported by any of the modules
+	// in the project. These in turn might import other modules, so
+	// we need to traverse the whole dependency network.
+	//
+	// Initially we have a set of modules needing to be processed.
+	//
+	// Each module processed, we remove from the list.
+	//
+	// When processing a module, we check its list of imports. For
+	// each imported module name, we search for a loaded module with
+	// that name. If the module is already loaded, we continue.
+	// If the module is not loaded, we search for it in the include
+	// paths and, if it is found, load it and add it to the list of
+	// modules that need processing.
+	//
+
+	vector<Module*> remaining = modules;
+
+	while(!remaining.empty()) {
+		Module* m = remaining.back();
+		remaining.pop_back();
+
+		if(!nostdlibs) {
+			m->AddImport( (fs::path(libdir) / "std.ccs").string() );
+			m->AddImport( (fs::path(libdir) / "stdarg.ccs").string() );
+		}
+
+		vector<string> imports = m->GetImports();
+
+		string module_dir = fs::path( m->GetFileName() ).parent_path().string();
+
+		for(vector<string>::const_iterator it = imports.begin();
+				it != imports.end(); ++it)
+		{
+			Module *imp;
+			const string& filename = *it;
+
+			string name = Module::NameFromFilename(filename);
+
+			imp = GetModule(name);
+
+			// If the imported module doesn't exist already, load it
+			if(!imp) {
+				imp = FindAndLoadModule( filename, module_dir );
+
+				// We'll need to process the newly loaded module's imports as well
+				if( imp )
+					remaining.push_back(imp);
+			}
+			else {
+				// Check this new import; if it refers to the same file that we've already
+				// included in the project, it's okay; otherwise it's an error, since module
+				// names must be unique.
+				string newpath = FindModule(filename, module_dir);
+				const string& existingpath = imp->GetFileName();
+
+				if( newpath.empty() )
+					imp = NULL;
+				else if( newpath != existingpath
+					&& CanonicalPath(newpath) != CanonicalPath(existingpath)
+					&& !fs::equivalent(existingpath, newpath) )
+				{
+					throw Exception("attempted to import " + newpath + "; module name collides with " + existingpath);
+				}
+			}
+
+
+			if( !imp )
+				throw Exception("Couldn't find module '" + filename + "'");
+
+			m->Include( imp );
+		}
+	}
+
+	IndexSymbols();
+}
+
+/*
+ * Builds the global index of root-scope identifiers, and uses it to mark
+ * identifiers that are ambiguous in the scope of each importing module.
+ */
+void Compiler::IndexSymbols()
+{
+	symbolindex.clear();
+
+	map<Module*, vector<Module*> > importers;
+
+	for(unsigned int i = 0; i < modules.size(); ++i)
+	{
+		Module* m = modules[i];
+
+		vector<string> names;
+		m->GetRootTable()->GetNames(names);
+
+		for(unsigned int j = 0; j < names.size(); ++j) {
+			vector<Module*>& defining = symbolindex[names[j]];
+			// A name can be both a symbol and a label within one module
+			if(defining.empty() || defining.back() != m)
+				defining.push_back(m);
+		}
+
+		const vector<Module*>& includes = m->GetIncludes();
+		for(unsigned int j = 0; j < includes.size(); ++j)
+			importers[includes[j]].push_back(m);
+	}
+
+	// Only identifiers with more than one definition can be ambiguous, and
+	// only in modules that import two or more of the defining modules
+	for(map<string, vector<Module*> >::const_iterator it = symbolindex.begin();
+		it != symbolindex.end(); ++it)
+	{
+		const vector<Module*>& defining = it->second;
+		if(defining.size() < 2)
+			continue;
+
+		map<Module*, vector<Module*> > candidates;
+
+		for(unsigned int i = 0; i < defining.size(); ++i) {
+			const vector<Module*>& users = importers[defining[i]];
+			for(unsigned int j = 0; j < users.size(); ++j)
+				candidates[users[j]].push_back(defining[i]);
+		}
+
+		for(map<Module*, vector<Module*> >::const_iterator c = candidates.begin();
+			c != candidates.end(); ++c)
+		{
+			if(c->second.size() > 1)
+				c->first->DefineAmbiguous(it->first, c->second);
+		}
+	}
+}
+
+
+/*
+ * Evaluates all loaded modules
+ */
+void Compiler::EvaluateModules()
+{
+	// Compressed, stripped, outlined or merged output depends on every
+	// module, so none of it can be reused
+	bool incremental = false;
+	if(!statefile.empty() && compress == 0 && !strip && outline == 0 && !mergetext) {
+		TimeReport::Timer timer(timing, "build state");
+		incremental = buildstate.Read(statefile);
+	}
+	unsigned int reused = 0;
+
+	profiler.Start();
+
+	// Evaluate each module to determine its code size
+	for(unsigned int i = 0; i < modules.size(); ++i)
+	{
+		Module* m = modules[i];
+
+		// Modules whose inputs haven't changed since the last build reuse
+		// their saved output. This has to happen in module order, like
+		// evaluation, so that ROM writes are registered in the same order.
+		if(incremental) {
+			TimeReport::Timer timer(timing, "restore", m->GetName());
+			const set<string>* siblingrefs = buildstate.GetSiblingRefs(m->GetName());
+			if(siblingrefs && buildstate.Restore(m, ModuleInputKey(m, *siblingrefs), this)) {
+				reused++;
+				continue;
+			}
+		}
+
+		if(verbose && m->GetName().substr(0,3) != "std")	// This is a hack.
+			std::cerr << "Evaluating " << m->GetFileName() << "..." << std::endl;
+		{
+			TimeReport::Timer timer(timing, "evaluate", m->GetName());
+			m->Execute();
+		}
+
+		if(m->Failed())
+			failed = true;
+		else if(optimize) {
+			TimeReport::Timer timer(timing, "optimize", m->GetName());
+			optimizedbytes += Peephole::Optimize(*m->GetCodeChunk());
+		}
+
+		if(printRT && m->GetName().substr(0,3) != "std")
+			m->PrintRootTable();
+
+	}
+
+	profiler.Stop();
+
+	// Outlining and merging text link modules' output together, so they
+	// have to wait until every module has been evaluated. Outlining goes
+	// first, as it works on whole command expansions.
+	if(outline > 0 && !failed) {
+		TimeReport::Timer timer(timing, "outline");
+		vector<Outliner::Result> outlined = Outliner::Outline(modules);
+		for(unsigned int i = 0; i < outlined.size(); ++i) {
+			outlinedbytes += outlined[i].Saved();
+			if(verbose)
+				std::cerr << "Outlined " << std::dec << outlined[i].calls << " expansions of '"
+					<< outlined[i].command << "' (" << outlined[i].size << " bytes), saving "
+					<< outlined[i].Saved() << " bytes" << std::endl;
+		}
+	}
+
+	// Code that can't be reached goes before merging and compression, so
+	// that it isn't shared with or counted for the code that's kept
+	if(strip && !failed) {
+		TimeReport::Timer timer(timing, "strip");
+		StripDeadCode();
+	}
+
+	if(mergetext && !failed) {
+		TimeReport::Timer timer(timing, "merge text");
+		vector<ByteChunk*> chunks;
+		for(unsigned int i = 0; i < modules.size(); ++i)
+			chunks.push_back(modules[i]->GetCodeChunk());
+		mergedbytes = TailMerger::Merge(chunks);
+
+		if(verbose) {
+			for(unsigned int i = 0; i < modules.size(); ++i) {
+				if(mergedbytes[i] > 0)
+					std::cerr << "Merged text: removed " << std::dec << mergedbytes[i]
+						<< " bytes from " << modules[i]->GetName() << std::endl;
+			}
+		}
+	}
+
+	// Compression goes last, since the codes it leaves in the text would
+	// stop it from being merged
+	if(compress > 0 && !failed && !modules.empty()) {
+		TimeReport::Timer timer(timing, "compress");
+		CompressText();
+	}
+
+	// Modules can't cross bank boundaries, so unless modules are split at
+	// their labels to be placed in pieces, any module larger than 64K is a
+	// fatal error. So is more than 64K between two labels when splitting.
+	TimeReport::Timer timer(timing, "split");
+	for(unsigned int i = 0; i < modules.size(); ++i)
+	{
+		Module* m = modules[i];
+		if(m->Split(splitlabels))
+			continue;
+		if(!splitlabels)
+			throw Exception("module '" + m->GetName() + "' exceeds 64KB; use --split-labels to place it in pieces");
+		throw Exception("module '" + m->GetName() + "' has more than 64KB between two labels");
+	}
+
+	if(verbose && incremental)
+		std::cerr << "Reused previous output of " << std::dec << reused << " of "
+			<< modules.size() << " modules" << std::endl;
+	if(verbose && optimize)
+		std::cerr << "Optimizer removed " << std::dec << optimizedbytes << " bytes" << std::endl;
+}
+
+/*
+ * Computes the key identifying everything a module's evaluation depends on:
+ * the source and counter state of the module itself, of the modules it
+ * imports or refers to by qualified names, and of everything those import.
+ */
+unsigned long long Compiler::ModuleInputKey(Module* m, const set<string>& siblingrefs)
+{
+	map<string, Module*> deps;
+	vector<Module*> pending = m->GetIncludes();
+	string missing;
+
+	for(set<string>::const_iterator it = siblingrefs.begin(); it != siblingrefs.end(); ++it) {
+		Module* sibling = GetModule(*it);
+		if(sibling)
+			pending.push_back(sibling);
+		else
+			missing += *it + '\n';
+	}
+
+	while(!pending.empty()) {
+		Module* dep = pending.back();
+		pending.pop_back();
+
+		if(dep == m || !deps.insert(make_pair(dep->GetName(), dep)).second)
+			continue;
+
+		const vector<Module*>& includes = dep->GetIncludes();
+		pending.insert(pending.end(), includes.begin(), includes.end());
+	}
+
+	unsigned long long key = m->GetStateKey();
+
+	// Saved output is only good for builds with the same optimization
+	if(optimize)
+		key = Fnv1a64("-O", 2, key);
+	if(outline > 0) {
+		key = Fnv1a64("--outline", 9, key);
+		key = Fnv1a64(reinterpret_cast<const char*>(&outline), sizeof(outline), key);
+	}
+
+	for(map<string, Module*>::const_iterator it = deps.begin(); it != deps.end(); ++it) {
+		unsigned long long depkey = it->second->GetStateKey();
+		key = Fnv1a64(it->first.data(), it->first.size() + 1, key);
+		key = Fnv1a64(reinterpret_cast<const char*>(&depkey), sizeof(depkey), key);
+	}
+	return Fnv1a64(missing.data(), missing.size(), key);
+}
+
+/*
+ * Compresses the text of all modules with a dictionary, which is added to
+ * the end of the first module's code and pointed to by the game's table
+ */
+void Compiler::CompressText()
+{
+	vector<ByteChunk*> chunks;
+	int before = 0;
+	for(unsigned int i = 0; i < modules.size(); ++i) {
+		chunks.push_back(modules[i]->GetCodeChunk());
+		before += chunks.back()->GetSize();
+	}
+
+	// Only the entries the project has freed up are replaced, since the
+	// game's own text uses the rest
+	if(dictionarylast < dictionaryfirst || dictionarylast >= TextCompressor::MaxEntries)
+		throw Exception("bad text dictionary range");
+	if(compress > dictionarylast - dictionaryfirst + 1)
+		throw Exception("text compression needs more dictionary entries than the range given has");
+
+	vector<TextCompressor::Entry> dictionary = TextCompressor::Compress(chunks, dictionaryfirst, compress);
+	dictionarysize = dictionary.size();
+
+	ByteChunk* code = chunks.front();
+	RomAccess* table = new RomAccess();
+	table->cache_base = new ByteChunk();
+	table->cache_base->Long(TextCompressor::TableAddress + 4 * dictionaryfirst);
+	table->cache_value = new ByteChunk();
+
+	for(unsigned int i = 0; i < dictionary.size(); ++i) {
+		Anchor* entry = new Anchor("<dictionary>");
+		code->AddAnchor(code->GetSize(), entry);
+		for(unsigned int j = 0; j < dictionary[i].text.size(); ++j)
+			code->Byte(dictionary[i].text[j], true);
+		code->Byte(0);
+
+		table->cache_value->Long(0);
+		table->cache_value->AddReference(table->cache_value->GetSize() - 4, entry);
+	}
+	RegisterDelayedWrite(table);
+
+	int after = 0;
+	for(unsigned int i = 0; i < chunks.size(); ++i)
+		after += chunks[i]->GetSize();
+	compressedbytes = before - after;
+
+	if(verbose)
+		std::cerr << "Compressed text with " << std::dec << dictionarysize
+			<< " dictionary entries, saving " << compressedbytes << " bytes" << std::endl;
+}
+
+/*
+ * Removes the code in all modules that can't be reached from the labels in
+ * the roots file, or from any ROM write
+ */
+void Compiler::StripDeadCode()
+{
+	// Labels the game reaches through the summary's addresses, rather than
+	// a ROM write, are only kept if they're listed
+	vector<Anchor*> roots;
+	if(rootsfile.empty())
+		Warning("--strip-unused without --roots keeps only code reached from ROM writes; "
+			"any other label the game uses will be removed");
+	else
+	{
+		ifstream in(rootsfile.c_str());
+		if(in.fail())
+			throw Exception("couldn't open roots file '" + rootsfile + "'");
+
+		// Each line is a label, as module.label, or a module name to keep
+		// all of its labels
+		string line;
+		for(int n = 1; getline(in, line); ++n)
+		{
+			string::size_type comment = line.find('#');
+			if(comment != string::npos)
+				line.erase(comment);
+
+			string::size_type first = line.find_first_not_of(" \t\r");
+			if(first == string::npos)
+				continue;
+			string::size_type last = line.find_last_not_of(" \t\r");
+			line = line.substr(first, last - first + 1);
+
+			string::size_type dot = line.rfind('.');
+			Module* m = GetModule(line.substr(0, dot));
+			const map<string, Anchor*>* jumps = m ? &m->GetRootTable()->GetJumpTable() : NULL;
+			if(jumps && dot == string::npos) {
+				for(map<string, Anchor*>::const_iterator it = jumps->begin(); it != jumps->end(); ++it)
+					roots.push_back(it->second);
+				continue;
+			}
+
+			map<string, Anchor*>::const_iterator label;
+			if(!jumps || (label = jumps->find(line.substr(dot + 1))) == jumps->end()) {
+				stringstream ss;
+				ss << rootsfile << ":" << n << ": no label '" << line << "'";
+				Warning(ss.str());
+				continue;
+			}
+			roots.push_back(label->second);
+		}
+	}
+
+	// Writes resolved when they were made refer to nothing
+	vector<const ByteChunk*> writes;
+	for(vector<DelayedWrite>::const_iterator it = romwrites.begin(); it != romwrites.end(); ++it) {
+		if(!it->access)
+			continue;
+		writes.push_back(it->access->cache_base);
+		writes.push_back(it->access->cache_size);
+		writes.push_back(it->access->cache_index);
+		writes.push_back(it->access->cache_value);
+	}
+
+	vector<ByteChunk*> chunks;
+	for(unsigned int i = 0; i < modules.size(); ++i)
+		chunks.push_back(modules[i]->GetCodeChunk());
+
+	vector<DeadCode::Block> removed = DeadCode::Strip(chunks, writes, roots);
+
+	// Report each block by the labels it had
+	for(vector<DeadCode::Block>::const_iterator it = removed.begin(); it != removed.end(); ++it)
+	{
+		Module* m = modules[it->chunk];
+		set<const Anchor*> inside(it->anchors.begin(), it->anchors.end());
+
+		string name;
+		const map<string, Anchor*>& jumps = m->GetRootTable()->GetJumpTable();
+		for(map<string, Anchor*>::const_iterator j = jumps.begin(); j != jumps.end(); ++j) {
+			// Skip internal labels
+			if(j->first.empty() || !isalpha(j->first.at(0)) || !inside.count(j->second))
+				continue;
+			name += (name.empty() ? "" : ", ") + m->GetName() + "." + j->first;
+			removedlabels.insert(j->second);
+		}
+		if(name.empty())
+			name = m->GetName();
+
+		removedcode.push_back(make_pair(name, it->size));
+		strippedbytes += it->size;
+
+		if(verbose)
+			std::cerr << "Removed " << std::dec << it->size << " bytes of unreachable code: "
+				<< name << std::endl;
+	}
+}
+
+/*
+ * Saves the output of all modules for the next incremental build
+ */
+void Compiler::SaveBuildState()
+{
+	vector<unsigned long long> keys;
+	for(unsigned int i = 0; i < modules.size(); ++i)
+		keys.push_back(ModuleInputKey(modules[i], modules[i]->GetSiblingRefs()));
+
+	unsigned int saved = buildstate.Save(modules, keys, romwrites, writevalues);
+
+	if(!buildstate.Write(statefile))
+		Warning("couldn't write build state to '" + statefile + "'");
+	else if(verbose)
+		std::cerr << "Saved output of " << std::dec << saved << " of " << modules.size()
+			<< " modules to " << statefile << std::endl;
+}
+
+/*
+ * Lists the sections to be placed: every module, or every fragment of a
+ * module that has been split
+ */
+void Compiler::GetSections(vector<Section>& sections) const
+{
+	sections.clear();
+	for(unsigned int i = 0; i < modules.size(); ++i)
+	{
+		Module* m = modules[i];
+		unsigned int count = m->GetFragmentCount();
+
+		for(unsigned int j = 0; j < count; ++j) {
+			Section s;
+			s.module = i;
+			s.fragment = j;
+			s.size = m->GetFragmentSize(j);
+			if(j + 1 < count)
+				s.size += Module::JumpSize;
+			s.name = m->GetName();
+			if(count > 1) {
+				stringstream ss;
+				ss << s.name << "#" << j;
+				s.name = ss.str();
+			}
+			sections.push_back(s);
+		}
+	}
+}
+
+/*
+ * Places every module's fragments at the addresses given, by section
+ */
+void Compiler::PlaceSections(const vector<Section>& sections, const vector<unsigned int>& addresses)
+{
+	vector<vector<unsigned int> > placed(modules.size());
+	for(unsigned int i = 0; i < sections.size(); ++i) {
+		vector<unsigned int>& v = placed[sections[i].module];
+		if(v.size() <= sections[i].fragment)
+			v.resize(sections[i].fragment + 1);
+		v[sections[i].fragment] = addresses[i];
+	}
+
+	for(unsigned int i = 0; i < modules.size(); ++i)
+		modules[i]->SetFragmentAddresses(placed[i]);
+}
+
+/*
+ * Assigns base addresses to all modules
+ */
+void Compiler::AssignModuleAddresses()
+{
+	if(failed)
+		return;
+
+	vector<Section> sections;
+	GetSections(sections);
+
+	if(stable && !previouslayout.empty()) {
+		if(AssignStableAddresses(sections))
+			return;
+
+		Warning("the modules no longer fit around those kept in place; all of them were packed again");
+		repacked = true;
+		keptmodules = 0;
+	}
+
+	// Here, we set the base address of each module, or of each fragment of
+	// the modules that have been split. These can't cross bank boundaries,
+	// so we work out which banks (or parts of banks) are available, and
+	// leave it to the packer to decide which sections go in each one.
+	// Within a bank, sections are laid out in the order given.
+
+	vector<unsigned int> bankstarts;
+	vector<unsigned int> capacities;
+	GetBanks(bankstarts, capacities);
+
+	vector<unsigned int> sizes;
+	unsigned int total = 0;
+	for(unsigned int i = 0; i < sections.size(); ++i) {
+		sizes.push_back(sections[i].size);
+		total += sizes[i];
+	}
+
+	BankPacker packer(capacities);
+	vector<vector<unsigned int> > bins;
+	unsigned int unplaced;
+
+	if(!packer.Pack(sizes, packmethod, packtime, bins, unplaced)) {
+		if(endadr > 0 && freespace.Empty())
+			throw Exception("error: module " + sections[unplaced].name + " exceeded specified end address -- aborting");
+		throw Exception("fatal error - ran out of space writing module " + sections[unplaced].name);
+	}
+
+	// Fragments of the same module that end up in the same bank are put
+	// in order, so that they can follow on without a jump
+	if(sections.size() > modules.size()) {
+		for(unsigned int i = 0; i < bins.size(); ++i)
+			std::sort(bins[i].begin(), bins[i].end());
+	}
+
+	totalfrag = 0;
+	actual_start = -1;
+	actual_end = -1;
+	banksused = 0;
+	bankbound = packer.LowerBound(total);
+	packtimedout = packer.TimedOut();
+
+	unsigned int last = 0;
+	for(unsigned int i = 0; i < bins.size(); ++i)
+		if(!bins[i].empty())
+			last = i;
+
+	vector<unsigned int> addresses(sections.size());
+
+	for(unsigned int i = 0; i < bins.size(); ++i)
+	{
+		unsigned int base = bankstarts[i];
+
+		for(unsigned int j = 0; j < bins[i].size(); ++j)
+		{
+			const Section& s = sections[bins[i][j]];
+
+			// Update write bounds
+			if(actual_start == -1)
+				actual_start = base;
+
+			addresses[bins[i][j]] = base;
+
+			// No jump is needed if the next fragment comes right after
+			if(j + 1 < bins[i].size() && bins[i][j + 1] == bins[i][j] + 1
+				&& sections[bins[i][j] + 1].module == s.module)
+				base += s.size - Module::JumpSize;
+			else
+				base += s.size;
+			actual_end = base;
+		}
+
+		if(!bins[i].empty())
+			banksused++;
+
+		// Whatever's left at the end of every bank but the last is wasted
+		if(i < last)
+			totalfrag += capacities[i] - (base - bankstarts[i]);
+	}
+
+	PlaceSections(sections, addresses);
+
+	if(verbose)
+		std::cerr << "Packed " << std::dec << sections.size() << " sections of " << modules.size()
+			<< " modules into " << banksused << " bank(s) (" << BankPacker::MethodName(packmethod)
+			<< "), wasting " << totalfrag << " bytes" << std::endl;
+}
+
+
+/*
+ * Resolves references and writes modules to the output file
+ */
+void Compiler::OutputModules()
+{
+	if(failed)
+		return;
+
+	if(verbose)
+		std::cerr << "Writing output to ROM..." << std::endl;
+
+	WaitForRom();
+
+	// Every address is known once modules are placed, so each module is
+	// written straight to the buffer with its references filled in on the
+	// way, instead of resolving them in its code first
+	for(unsigned int i = 0; i < modules.size(); ++i) {
+		Module* m = modules[i];
+		TimeReport::Timer timer(timing, "resolve", m->GetName());
+
+		vector<int> locations;
+		for(unsigned int j = 0; j < m->GetFragmentCount(); ++j) {
+			unsigned int outadr = MapVirtualAddress(m->GetFragmentAddress(j));
+
+			if(outadr == 0xFBADF00D) {
+				stringstream ss;
+				ss << "Module has bad virtual address (" << std::setbase(16) << m->GetFragmentAddress(j) << "), aborting";
+				throw Exception(ss.str());
+			}
+			locations.push_back(outadr);
+		}
+
+		m->WriteFragments(filebuffer, filesize, locations);
+		for(unsigned int j = 0; j < m->GetFragmentCount(); ++j)
+			rom.MarkDirty(locations[j], locations[j] + m->GetFragmentExtent(j));
+
+		if(printJumps && m->GetName().substr(0,3) != "std")
+			m->PrintJumps();
+		if(printCode && m->GetName().substr(0,3) != "std") {
+			// Only the printout needs the code itself resolved
+			m->ResolveReferences();
+			m->PrintCode();
+		}
+	}
+}
+
+
+
+/*
+ * Bank management and virtual address translation functions
+ */
+/*
+ * Returns true if nothing in 'used' overlaps [start, end). Both the range
+ * and the contents of 'used' are in bank order.
+ */
+static bool IsFree(const map<unsigned int, unsigned int>& used, unsigned int start, unsigned int end)
+{
+	// The ranges are disjoint, so only the last one starting at or before
+	// 'start' and the first one after it can overlap
+	map<unsigned int, unsigned int>::const_iterator it = used.upper_bound(start);
+	if(it != used.end() && it->first < end)
+		return false;
+	if(it != used.begin() && (--it)->second > start)
+		return false;
+	return true;
+}
+
+/*
+ * Returns true if [start, end) lies within one of the banks, given by their
+ * starts and capacities. Everything is in bank order.
+ */
+static bool InBank(const vector<unsigned int>& starts, const vector<unsigned int>& capacities,
+	unsigned int start, unsigned int end)
+{
+	vector<unsigned int>::const_iterator it = std::upper_bound(starts.begin(), starts.end(), start);
+	if(it == starts.begin())
+		return false;
+	--it;
+	return end <= *it + capacities[it - starts.begin()];
+}
+
+/*
+ * Predicate for ordering sections largest first (used by AssignStableAddresses)
+ */
+struct SectionOrder {
+	const vector<Compiler::Section>* sections;
+	bool operator()(unsigned int a, unsigned int b) const {
+		return (*sections)[a].size > (*sections)[b].size;
+	}
+};
+
+/*
+ * Assigns base addresses to all modules, keeping each module (or fragment)
+ * at the address it had in the previous build wherever possible. Returns
+ * false, having placed nothing, if the modules can't be fitted around the
+ * ones kept.
+ */
+bool Compiler::AssignStableAddresses(const vector<Section>& sections)
+{
+	// A section keeps its previous address if it still fits there. Sections
+	// that shrank or stayed the same size always do, leaving the space they
+	// no longer need as slack; sections that grew do if the space after them
+	// is free. Everything else -- new sections, and sections that grew past
+	// their neighbours -- is then placed largest first at the lowest free
+	// address that will hold it, so unchanged sections never move. If that
+	// leaves something with nowhere to go, those sections are packed into
+	// the gaps with the normal packer instead.
+
+	map<string, const ResetJournal::Placement*> previous;
+	for(vector<ResetJournal::Placement>::const_iterator it = previouslayout.begin();
+		it != previouslayout.end(); ++it)
+		previous[it->module] = &*it;
+
+	// The space available, and the space taken so far, in bank order
+	vector<unsigned int> banks;
+	vector<unsigned int> capacities;
+	GetBanks(banks, capacities);
+	for(unsigned int i = 0; i < banks.size(); ++i)
+		banks[i] = FreeSpace::BankOrder(banks[i]);
+
+	map<unsigned int, unsigned int> used;	// occupied [start, end)
+	vector<unsigned int> addresses(sections.size());
+	vector<bool> kept(sections.size(), false);
+	vector<unsigned int> remaining;
+	vector<pair<unsigned int, unsigned int> > grown;
+
+	// A fragment that was followed directly by the next one needs no room
+	// for a jump, as long as the next one stays put too (checked below)
+	vector<unsigned int> needed(sections.size());
+	for(unsigned int i = 0; i < sections.size(); ++i) {
+		needed[i] = sections[i].size;
+		if(i + 1 < sections.size() && sections[i + 1].module == sections[i].module) {
+			map<string, const ResetJournal::Placement*>::const_iterator p = previous.find(sections[i].name);
+			map<string, const ResetJournal::Placement*>::const_iterator q = previous.find(sections[i + 1].name);
+			if(p != previous.end() && q != previous.end()
+				&& q->second->address == p->second->address + p->second->size)
+				needed[i] -= Module::JumpSize;
+		}
+	}
+
+	for(int pass = 0; pass < 2; ++pass)
+	{
+		// The first pass keeps sections that didn't grow, and collects those
+		// that did; the second tries to keep those, in address order
+		vector<unsigned int> candidates;
+		if(pass == 0) {
+			for(unsigned int i = 0; i < sections.size(); ++i)
+				candidates.push_back(i);
+		}
+		else {
+			std::sort(grown.begin(), grown.end());
+			for(unsigned int i = 0; i < grown.size(); ++i)
+				candidates.push_back(grown[i].second);
+		}
+
+		for(vector<unsigned int>::iterator it = candidates.begin(); it != candidates.end(); ++it)
+		{
+			const Section& s = sections[*it];
+			unsigned int size = needed[*it];
+
+			map<string, const ResetJournal::Placement*>::const_iterator p = previous.find(s.name);
+			if(p == previous.end()) {
+				remaining.push_back(*it);
+				continue;
+			}
+
+			unsigned int base = p->second->address;
+			if(pass == 0 && size > p->second->size) {
+				grown.push_back(make_pair(FreeSpace::BankOrder(base), *it));
+				continue;
+			}
+
+			unsigned int start = FreeSpace::BankOrder(base);
+			if(!FreeSpace::IsUsable(base) || !InBank(banks, capacities, start, start + size)
+				|| (size > 0 && !IsFree(used, start, start + size)))
+			{
+				remaining.push_back(*it);
+				continue;
+			}
+
+			addresses[*it] = base;
+			kept[*it] = true;
+			if(size > 0)
+				used[start] = start + size;
+		}
+	}
+
+	// Fragments kept without room for a jump need one after all if the next
+	// fragment didn't stay right after them. Going backwards, so that moving
+	// one fragment is seen by the one before it.
+	for(unsigned int i = sections.size(); i-- > 0; )
+	{
+		if(!kept[i] || needed[i] == sections[i].size)
+			continue;
+
+		unsigned int start = FreeSpace::BankOrder(addresses[i]);
+		unsigned int end = start + needed[i];
+		if(kept[i + 1] && FreeSpace::BankOrder(addresses[i + 1]) == end)
+			continue;
+
+		if(InBank(banks, capacities, start, end + Module::JumpSize)
+			&& IsFree(used, end, end + Module::JumpSize))
+		{
+			used[start] = end + Module::JumpSize;
+			continue;
+		}
+
+		used.erase(start);
+		kept[i] = false;
+		remaining.push_back(i);
+	}
+
+	SectionOrder pred = { &sections };
+	std::sort(remaining.begin(), remaining.end(), pred);
+
+	const map<unsigned int, unsigned int> keptused = used;
+	bool fitted = true;
+
+	for(vector<unsigned int>::iterator it = remaining.begin(); it != remaining.end() && fitted; ++it)
+	{
+		const Section& s = sections[*it];
+		unsigned int size = s.size;
+		unsigned int start = 0;
+		bool placed = false;
+
+		for(unsigned int b = 0; b < banks.size() && !placed; ++b)
+		{
+			start = banks[b];
+			while(start + size <= banks[b] + capacities[b])
+			{
+				// Skip past anything in the way
+				map<unsigned int, unsigned int>::const_iterator u = used.upper_bound(start);
+				if(u != used.begin()) {
+					map<unsigned int, unsigned int>::const_iterator prev = u;
+					if((--prev)->second > start) {
+						start = prev->second;
+						continue;
+					}
+				}
+				if(u != used.end() && u->first < start + size) {
+					start = u->second;
+					continue;
+				}
+				placed = true;
+				break;
+			}
+		}
+
+		if(!placed) {
+			fitted = false;
+			break;
+		}
+
+		addresses[*it] = FreeSpace::FromBankOrder(start);
+		if(size > 0)
+			used[start] = start + size;
+	}
+
+	if(!fitted)
+	{
+		// Lowest first left something out, so pack the same sections into
+		// the gaps between the kept ones, each gap a bank of its own
+		used = keptused;
+
+		vector<unsigned int> gapstarts;
+		vector<unsigned int> gapsizes;
+		for(unsigned int b = 0; b < banks.size(); ++b)
+		{
+			unsigned int start = banks[b];
+			unsigned int end = banks[b] + capacities[b];
+			for(map<unsigned int, unsigned int>::const_iterator u = used.lower_bound(start);
+				u != used.end() && u->first < end; ++u)
+			{
+				if(u->first > start) {
+					gapstarts.push_back(start);
+					gapsizes.push_back(u->first - start);
+				}
+				start = u->second;
+			}
+			if(end > start) {
+				gapstarts.push_back(start);
+				gapsizes.push_back(end - start);
+			}
+		}
+
+		vector<unsigned int> sizes;
+		for(unsigned int i = 0; i < remaining.size(); ++i)
+			sizes.push_back(sections[remaining[i]].size);
+
+		BankPacker packer(gapsizes);
+		vector<vector<unsigned int> > bins;
+		unsigned int unplaced;
+		if(!packer.Pack(sizes, packmethod, packtime, bins, unplaced))
+			return false;
+
+		for(unsigned int i = 0; i < bins.size(); ++i)
+		{
+			unsigned int base = gapstarts[i];
+			for(unsigned int j = 0; j < bins[i].size(); ++j) {
+				unsigned int n = remaining[bins[i][j]];
+				addresses[n] = FreeSpace::FromBankOrder(base);
+				base += sections[n].size;
+			}
+		}
+
+		for(unsigned int i = 0; i < remaining.size(); ++i)
+		{
+			const Section& s = sections[remaining[i]];
+			map<string, const ResetJournal::Placement*>::const_iterator p = previous.find(s.name);
+			if(s.size == 0 || p == previous.end() || p->second->address == addresses[remaining[i]])
+				continue;
+
+			stringstream ss;
+			ss << "module " << s.name << " moved from $" << std::setbase(16) << p->second->address
+				<< " to $" << addresses[remaining[i]] << " to make room";
+			Warning(ss.str());
+		}
+	}
+
+	PlaceSections(sections, addresses);
+
+	// A module counts as kept if all of it was
+	keptmodules = 0;
+	for(unsigned int i = 0; i < sections.size(); ++i) {
+		bool all = true;
+		unsigned int j = i;
+		for(; j < sections.size() && sections[j].module == sections[i].module; ++j)
+			all = all && kept[j];
+		if(all)
+			keptmodules++;
+		i = j - 1;
+	}
+
+	// Update write bounds
+	actual_start = -1;
+	actual_end = -1;
+	totalfrag = 0;
+
+	if(sections.empty())
+		return true;
+
+	vector<unsigned int> extents(sections.size());
+	for(unsigned int i = 0; i < sections.size(); ++i)
+		extents[i] = modules[sections[i].module]->GetFragmentExtent(sections[i].fragment);
+
+	unsigned int first = 0, last = 0, total = 0;
+	for(unsigned int i = 0; i < sections.size(); ++i)
+	{
+		if(FreeSpace::BankOrder(addresses[i]) < FreeSpace::BankOrder(addresses[first]))
+			first = i;
+		if(FreeSpace::BankOrder(addresses[i]) + extents[i] > FreeSpace::BankOrder(addresses[last]) + extents[last])
+			last = i;
+		total += extents[i];
+	}
+
+	actual_start = addresses[first];
+	actual_end = addresses[last] + extents[last];
+
+	// Slack and bank padding between sections both count as fragmentation
+	totalfrag = (FreeSpace::BankOrder(addresses[last]) + extents[last] - FreeSpace::BankOrder(addresses[first])) - total;
+
+	return true;
+}
+
+
+/*
+ * Reads the module layout from a summary file written by a previous build.
+ * Returns false if there was none.
+ */
+bool Compiler::ReadSummaryLayout(const std::string& file)
+{
+	ifstream in(file.c_str());
+	if(in.fail())
+		return false;
+
+	string line;
+	while(getline(in, line) && line.compare(0, 18, "Module information") != 0)
+		;
+
+	// Skip the rule, the column headings, and the rule below them
+	for(int i = 0; i < 3 && getline(in, line); ++i)
+		;
+
+	// Each line is the module name, then its address and size
+	while(getline(in, line))
+	{
+		size_t dollar = line.rfind('$');
+		if(dollar == string::npos)
+			break;
+
+		ResetJournal::Placement p;
+		p.module = line.substr(0, line.find_last_not_of(' ', dollar - 1) + 1);
+
+		stringstream ss(line.substr(dollar + 1));
+		ss >> std::hex >> p.address >> std::dec >> p.size;
+		if(ss.fail() || p.module.empty())
+			break;
+
+		previouslayout.push_back(p);
+	}
+	return !previouslayout.empty();
+}
+
+
+/*
+ * Returns the address of the next virtual bank above the bank
+ * containing the given virtual address.
+ * Returns zero if there is no valid higher bank.
+ */
+unsigned int Compiler::GetNextBank(unsigned int adr)
+{
+	// Virtual banks are physically contiguous between two groups:
+	//  [C0, FF], which are mapped to [00, 3F], and
+	//  [40, 5F], which are mapped to [40, 5F].
+	// However, we treat bank 40 as unusable, because some expanders will
+	// copy the upper half of bank C0 into the upper half of bank 40 in
+	// the process of 48Mbit ExHiROM expansion. I'm not entirely sure if
+	// this is necessary for EarthBound, but better safe than sorry for now.
+	int bank = (adr & 0xFF0000) >> 16;
+
+	if(bank >= 0xC0 && bank < 0xFF)
+		return (bank + 1) << 16;
+	if(bank == 0xFF)
+		return (0x41) << 16;
+	if(bank >= 0x41 && bank < 0x5F)
+		return (bank + 1) << 16;
+	return 0;
+}
+
+/*
+ * Gets the banks, or parts of banks, that output can be placed in, in the
+ * order they are filled: the free space regions if any were given, or else
+ * every bank from the output address up to the end address
+ */
+void Compiler::GetBanks(vector<unsigned int>& starts, vector<unsigned int>& capacities)
+{
+	if(!freespace.Empty()) {
+		freespace.GetBanks(starts, capacities);
+		return;
+	}
+
+	starts.clear();
+	capacities.clear();
+	for(unsigned int base = this->outadr; base != 0; base = GetNextBank(base))
+	{
+		if((endadr > 0) && (base >= endadr))
+			break;
+
+		// Modules must end before the maximum address
+		unsigned int room = 0x10000 - (base & 0xFFFF);
+		if((endadr > 0) && (base + room >= endadr))
+			room = endadr - base - 1;
+
+		starts.push_back(base);
+		capacities.push_back(room);
+	}
+}
+
+/*
+ * Returns the physical address corresponding to a given virtual address.
+ * Returns 0xFBADF00D if the virtual address is invalid.
+ */
+
+unsigned int Compiler::MapVirtualAddress(unsigned int vadr)
+{
+	if(vadr >= 0xC00000 && vadr <= 0xFFFFFF)
+		return vadr - 0xC00000 + (has_header? 0x200 : 0);
+	if(vadr >= 0x400000 && vadr <= 0x5FFFFF)
+		return vadr + (has_header? 0x200 : 0);
+	return 0xFBADF00D;
+}
+
+
+/*
+ * Registers a delayed write to the output file, made by the given module
+ * (or by the compiler itself, if none). A write with nothing left to
+ * resolve is resolved now, and its code freed.
+ */
+void Compiler::RegisterDelayedWrite(RomAccess* w, Module* m)
+{
+	if(failed) {
+		delete w;
+		return;
+	}
+
+	DelayedWrite d = { 0, w->cache_value->GetSize(), 0, w->line, m, w };
+	if(w->IsConstant()) {
+		d.vaddress = w->GetVirtualAddress();
+		d.offset = writevalues.size();
+		writevalues.resize(d.offset + d.size);
+		if(d.size > 0)
+			w->DoWrite(&writevalues[0], d.offset, writevalues.size());
+		delete w;
+		d.access = NULL;
+	}
+	romwrites.push_back(d);
+}
+
+/*
+ * Index of a ROM write and where it goes, for sorting (used by
+ * PrepareDelayedWrites)
+ */
+struct PendingWrite {
+	unsigned int address;	// physical
+	unsigned int size;
+	unsigned int index;		// into the list of writes, in the order they were made
+};
+
+static bool AddressOrder(const PendingWrite& a, const PendingWrite& b)
+{
+	return a.address < b.address || (a.address == b.address && a.index < b.index);
+}
+
+static bool WriteOrder(const PendingWrite& a, const PendingWrite& b)
+{
+	return a.index < b.index;
+}
+
+/*
+ * Resolves all direct ROM access instructions registered, and merges them
+ * into runs of contiguous output, ready to be written and journaled
+ */
+void Compiler::PrepareDelayedWrites()
+{
+	writeruns.clear();
+	writearena.clear();
+	if(failed) return;
+
+	vector<PendingWrite> pending;
+	pending.reserve(romwrites.size());
+
+	for(unsigned int i = 0; i < romwrites.size(); ++i)
+	{
+		DelayedWrite& d = romwrites[i];
+
+		// Writes that were waiting on labels can be resolved now
+		if(d.access) {
+			d.access->ResolveReferences();
+			d.vaddress = d.access->GetVirtualAddress();
+			d.offset = writevalues.size();
+			writevalues.resize(d.offset + d.size);
+			if(d.size > 0)
+				d.access->DoWrite(&writevalues[0], d.offset, writevalues.size());
+		}
+
+		// Get the physical address of the write
+		unsigned int padr = MapVirtualAddress(d.vaddress);
+		if(padr == 0xFBADF00D) {
+			stringstream ss;
+			ss << "error in ROM write statement: bad virtual address: " << std::setbase(16) << d.vaddress;
+			throw Exception(ss.str());
+		}
+
+		PendingWrite w = { padr, d.size, i };
+		pending.push_back(w);
+	}
+
+	std::sort(pending.begin(), pending.end(), AddressOrder);
+
+	for(unsigned int i = 0; i < pending.size(); )
+	{
+		// A run takes in every write that overlaps or adjoins it
+		unsigned int start = pending[i].address;
+		unsigned int end = start + pending[i].size;
+		unsigned int j = i + 1;
+		for(; j < pending.size() && pending[j].address <= end; ++j)
+			end = std::max(end, pending[j].address + pending[j].size);
+
+		WriteRun run = { start, romwrites[pending[i].index].vaddress,
+			end - start, (unsigned int)writearena.size() };
+		writearena.resize(writearena.size() + run.size);
+
+		// Where writes overlap, the last one made wins
+		std::sort(pending.begin() + i, pending.begin() + j, WriteOrder);
+		for(; i < j; ++i) {
+			const DelayedWrite& d = romwrites[pending[i].index];
+			if(d.size > 0)
+				memcpy(&writearena[run.offset + pending[i].address - start], &writevalues[d.offset], d.size);
+		}
+
+		writeruns.push_back(run);
+	}
+}
+
+/*
+ * Performs all direct ROM access instructions registered
+ */
+void Compiler::DoDelayedWrites()
+{
+	if(failed) return;
+	for(vector<WriteRun>::const_iterator it = writeruns.begin(); it != writeruns.end(); ++it)
+	{
+		if(it->address >= (unsigned int)filesize)
+			continue;
+
+		unsigned int len = std::min(it->size, filesize - it->address);
+		memcpy(filebuffer + it->address, &writearena[it->offset], len);
+		rom.MarkDirty(it->address, it->address + len);
+	}
+}
+
+/*
+ * Warns about any output that overwrites other output: modules placed on
+ * top of each other, ROM writes into modules, or ROM writes into other ROM
+ * writes. Each warning names both sources and the bytes they share.
+ */
+void Compiler::CheckOverlaps()
+{
+	if(failed) return;
+
+	// Everything is tagged in the order it was written: modules first, then
+	// ROM writes in the order they were made
+	IntervalSet spans;
+	vector<string> sources;
+	vector<unsigned int> addresses;		// virtual addresses, for the messages
+
+	vector<Section> sections;
+	GetSections(sections);
+	for(vector<Section>::const_iterator it = sections.begin(); it != sections.end(); ++it) {
+		Module* m = modules[it->module];
+		unsigned int adr = m->GetFragmentAddress(it->fragment);
+		unsigned int padr = MapVirtualAddress(adr);
+		if(padr == 0xFBADF00D)
+			continue;
+
+		spans.Add(padr, padr + m->GetFragmentExtent(it->fragment), sources.size());
+		sources.push_back("module '" + it->name + "'");
+		addresses.push_back(adr);
+	}
+
+	for(vector<DelayedWrite>::const_iterator it = romwrites.begin(); it != romwrites.end(); ++it) {
+		unsigned int adr = it->vaddress;
+		unsigned int padr = MapVirtualAddress(adr);
+		if(padr == 0xFBADF00D)
+			continue;
+
+		stringstream ss;
+		ss << "ROM write";
+		if(it->module)
+			ss << " (" << it->module->GetFileName() << ", line " << it->line << ")";
+
+		spans.Add(padr, padr + it->size, sources.size());
+		sources.push_back(ss.str());
+		addresses.push_back(adr);
+	}
+
+	vector<pair<unsigned int, unsigned int> > overlaps;
+	spans.FindOverlaps(overlaps);
+
+	const vector<IntervalSet::Interval>& intervals = spans.GetIntervals();
+	for(vector<pair<unsigned int, unsigned int> >::const_iterator it = overlaps.begin();
+		it != overlaps.end(); ++it)
+	{
+		const IntervalSet::Interval* a = &intervals[it->first];
+		const IntervalSet::Interval* b = &intervals[it->second];
+		if(a->tag > b->tag)
+			std::swap(a, b);
+
+		// Both are contiguous in the ROM, so the shared bytes can be given
+		// by their offset into the first
+		unsigned int start = std::max(a->start, b->start) - a->start + addresses[a->tag];
+		unsigned int end = std::min(a->end, b->end) - a->start + addresses[a->tag];
+
+		stringstream ss;
+		ss << sources[b->tag] << " overwrites " << sources[a->tag] << " at $" << std::setbase(16) << start;
+		if(end - start > 1)
+			ss << "-$" << end - 1;
+		Warning(ss.str());
+	}
+}
+
+
+/*
+ * Writes a "reset info" file, which contains information about the changes
+ * the compiler made to the output file in this compilation. Specifically:
+ *  - the range of primary compiled output
+ *  - the previous contents of any ROM direct-write areas
+ *
+ * See ResetJournal for the format.
+ */
+void Compiler::WriteResetInfo(const std::string &filename)
+{
+	ResetJournal journal;
+
+	// Output spread over separate regions has no one range to clear; the
+	// placements below are cleared one by one instead
+	if(actual_start != -1 && actual_start != actual_end && freespace.Empty()) {
+		journal.start = actual_start;
+		journal.end = actual_end;
+	}
+
+	for(vector<WriteRun>::const_iterator it = writeruns.begin(); it != writeruns.end(); ++it)
+	{
+		if(it->address < (unsigned int)filesize) {
+			unsigned int len = std::min(it->size, filesize - it->address);
+			journal.AddRecord(it->vaddress, filebuffer + it->address, len);
+		}
+	}
+
+	vector<Section> sections;
+	GetSections(sections);
+	for(vector<Section>::const_iterator it = sections.begin(); it != sections.end(); ++it)
+		journal.AddPlacement(it->name, modules[it->module]->GetFragmentAddress(it->fragment),
+			modules[it->module]->GetFragmentExtent(it->fragment));
+
+	if(!journal.Write(filename))
+		throw Exception("couldn't create info file '" + filename + "'");
+
+	// The binary journal supersedes any reset file left in the old format
+	std::error_code ec;
+	fs::remove(LegacyResetFile(filename), ec);
+
+	if(verbose)
+		std::cerr << "Final output written from " << std::setbase(16) << actual_start
+			<< " to " << actual_end << std::endl;
+
+}
+
+/*
+ * Returns the name of the text reset file used by older versions
+ * in place of the given binary one.
+ */
+string Compiler::LegacyResetFile(const std::string& filename)
+{
+	return filename + ".txt";
+}
+
+void Compiler::ApplyResetInfo(const std::string& filename)
+{
+	ResetJournal journal;
+
+	if(!journal.Read(filename) && !journal.ReadText(LegacyResetFile(filename)))
+		return;
+
+	previouslayout = journal.layout;
+
+	// Without any output, the previous layout is only used for comparison
+	if(sizeonly)
+		return;
+
+	WaitForRom();
+
+	// First clear the previous output: the whole range it was written in,
+	// or if it was placed in separate regions, each module in turn
+	vector<RomImage::Range> ranges;
+	if(journal.start != journal.end)
+		ranges.push_back(RomImage::Range(journal.start, journal.end));
+	else {
+		for(vector<ResetJournal::Placement>::const_iterator it = journal.layout.begin();
+			it != journal.layout.end(); ++it)
+			ranges.push_back(RomImage::Range(it->address, it->address + it->size));
+	}
+
+	for(vector<RomImage::Range>::const_iterator it = ranges.begin(); it != ranges.end(); ++it) {
+		if(verbose)
+			std::cerr << "Zeroing previous output (" << std::setbase(16) << it->first
+				<< " to " << it->second << ")" << std::endl;
+
+		// Mapped by its last byte, since the range can end with a bank
+		unsigned int start = MapVirtualAddress(it->first);
+		unsigned int last = MapVirtualAddress(it->second - 1);
+
+		if(start != 0xFBADF00D && last != 0xFBADF00D && start <= last) {
+			unsigned int end = std::min(last + 1, (unsigned int)filesize);
+			if(start < end) {
+				memset(filebuffer + start, 0, end - start);
+				rom.MarkDirty(start, end);
+			}
+		}
+	}
+
+	// Next restore whatever we had written via ROM[] statements previously
+	for(vector<ResetJournal::Record>::const_iterator it = journal.records.begin();
+		it != journal.records.end(); ++it)
+	{
+		unsigned int padr = MapVirtualAddress(it->address);
+
+		if(padr == 0xFBADF00D || padr >= (unsigned int)filesize)
+			continue;
+
+		unsigned int len = std::min(it->length, filesize - padr);
+		memcpy(filebuffer + padr, journal.GetBytes(*it), len);
+		rom.MarkDirty(padr, padr + len);
+	}
+}
+
+
+
+/*
+ * Writes the stacks sampled by the profiler to a file, and the time spent
+ * in each command to stdout (used by --profile)
+ */
+void Compiler::WriteProfile(const std::string& file)
+{
+	profiler.Stop();
+
+	ofstream out(file.c_str(), ofstream::trunc);
+	profiler.WriteFolded(out);
+	if(out.fail()) {
+		Error("couldn't write profile to " + file);
+		return;
+	}
+
+	profiler.WriteTable(std::cout);
+}
+
+/*
+ * Writes the trace events recorded during the build (used by --trace)
+ */
+void Compiler::WriteTrace(const std::string& file)
+{
+	// The background load records into the trace as well
+	if(romload.valid())
+		romload.wait();
+
+	if(!Trace::Write(file))
+		Error("couldn't write trace to " + file);
+}
+
+/*
+ * Writes the time spent in each phase of the build (used by --time-report)
+ */
+void Compiler::WriteTimeReport(const std::string& file)
+{
+	// The background load is only known to be done once it's been waited on
+	if(filebuffer)
+		timing.AddBackground("ROM load", romloadtime);
+
+	if(!timing.Write(file))
+		Error("couldn't write time report to " + file);
+}
+
+/*
+ * Writes the size of each module, and how it changed since the last
+ * build, along with how well the output fits (used by --size-only)
+ */
+void Compiler::WriteSizeReport(std::ostream& out)
+{
+	if(failed)
+		return;
+
+	// Sizes are compared by module, adding up the fragments of any that
+	// were split
+	map<string, unsigned int> previous;
+	unsigned int previoustotal = 0;
+	for(vector<ResetJournal::Placement>::const_iterator it = previouslayout.begin();
+		it != previouslayout.end(); ++it) {
+		previous[it->module.substr(0, it->module.find('#'))] += it->size;
+		previoustotal += it->size;
+	}
+
+	out << "Module                       Size        Previous    Change" << endl;
+	out << "-----------------------------------------------------------------" << endl;
+
+	unsigned int total = 0;
+	for(unsigned int i = 0; i < modules.size(); ++i)
+	{
+		Module* m = modules[i];
+		unsigned int size = 0;
+		for(unsigned int j = 0; j < m->GetFragmentCount(); ++j)
+			size += m->GetFragmentExtent(j);
+		total += size;
+
+		out << setfill(' ') << setw(29) << left << m->GetName()
+			<< setw(12) << left << setbase(10) << size;
+
+		map<string, unsigned int>::iterator p = previous.find(m->GetName());
+		if(p == previous.end())
+			out << (previouslayout.empty() ? "" : "new") << endl;
+		else {
+			int delta = (int)size - (int)p->second;
+			out << setw(12) << left << p->second << (delta > 0 ? "+" : "") << delta << endl;
+			previous.erase(p);
+		}
+	}
+	for(map<string, unsigned int>::const_iterator it = previous.begin(); it != previous.end(); ++it)
+		out << setfill(' ') << setw(29) << left << it->first
+			<< setw(12) << left << "-" << setw(12) << left << it->second << "removed" << endl;
+	out << "-----------------------------------------------------------------" << endl;
+	out << setw(29) << left << "Total" << setw(12) << left << total;
+	if(!previouslayout.empty()) {
+		int change = (int)total - (int)previoustotal;
+		out << setw(12) << left << previoustotal << (change > 0 ? "+" : "") << change;
+	}
+	out << endl << endl;
+
+	if(actual_start >= 0)
+		out << "Output:                      $" << setbase(16) << actual_start
+			<< " to $" << actual_end << endl;
+	out << "Fragmented space:            " << setbase(10) << totalfrag << " bytes" << endl;
+
+	// The room left is only meaningful if there's a limit
+	if(endadr > 0 || !freespace.Empty()) {
+		vector<unsigned int> starts, capacities;
+		GetBanks(starts, capacities);
+		unsigned int capacity = 0;
+		for(unsigned int i = 0; i < capacities.size(); ++i)
+			capacity += capacities[i];
+		out << "Space left:                  " << setbase(10) << capacity - total - totalfrag
+			<< " bytes" << endl;
+	}
+}
+
+/*
+ * Prints a summary of the number of errors and warnings issued, if any
+ */
+void Compiler::Results()
+{
+	if(!verbose && errorcount == 0 && warningcount == 0) return;
+	std::cerr << std::endl << std::dec << errorcount << " error(s), " << warningcount << " warning(s)" << std::endl;
+}
+
+
+using std::endl;
+using std::setbase;
+using std::setw;
+using std::setfill;
+using std::left;
+
+void Compiler::WriteSummary(std::ostream& out)
+{
+	out << filename << std::endl;
+	out << "CCScript Compilation Summary" << endl;
+	out << "============================" << endl;
+	out << endl << endl;
+
+	if(failed)
+	{
+		out << "COMPILATION FAILED";
+			return;
+	}
+	//
+	// Statistics
+	//
+	out << "Compilation statistics" << endl;
+	out << "=================================================================" << endl;
+	out << "Compilation start:           $" << setbase(16) << actual_start << endl;
+	out << "Compilation end:             $" << setbase(16) << actual_end << endl;
+	out << "Total compiled size:         " << setbase(10) << actual_end - actual_start << " bytes" << endl;
+	out << "Fragmented space:            " << setbase(10) << totalfrag << " bytes" << endl;
+	if(optimize)
+		out << "Optimizer saved:             " << setbase(10) << optimizedbytes << " bytes" << endl;
+	if(outline > 0)
+		out << "Outlining saved:             " << setbase(10) << outlinedbytes << " bytes" << endl;
+	if(mergetext) {
+		unsigned int merged = 0;
+		for(unsigned int i = 0; i < mergedbytes.size(); ++i)
+			merged += mergedbytes[i];
+		out << "Text merging saved:          " << setbase(10) << merged << " bytes" << endl;
+	}
+	if(strip)
+		out << "Unreachable code removed:    " << setbase(10) << strippedbytes << " bytes" << endl;
+	if(compress > 0)
+		out << "Text compression saved:      " << setbase(10) << compressedbytes << " bytes ("
+			<< dictionarysize << " dictionary entries)" << endl;
+	if(stable && !previouslayout.empty() && !repacked)
+		out << "Placement:                   stable" << endl;
+	else {
+		out << "Packing method:              " << BankPacker::MethodName(packmethod);
+		if(packtimedout)
+			out << " (stopped at time limit)";
+		out << endl;
+		out << "Banks used:                  " << setbase(10) << banksused
+			<< " (at least " << bankbound << " needed)" << endl;
+	}
+	unsigned int used = 0;
+	for(unsigned int i = 0; i < modules.size(); ++i)
+		used += modules[i]->GetCodeSize();
+	if(used > 0)
+		out << "Packing efficiency:          " << std::fixed << std::setprecision(1)
+			<< (100.0 * used / (used + totalfrag)) << "%" << endl;
+	if(stable) {
+		out << "Modules kept in place:       " << setbase(10) << keptmodules << " of " << modules.size() << endl;
+		if(changedbytes >= 0)
+			out << "Bytes changed:               " << setbase(10) << changedbytes << " bytes" << endl;
+	}
+	out << "-----------------------------------------------------------------" << endl;
+	out << endl << endl;
+
+	vector<Section> sections;
+	GetSections(sections);
+
+	//
+	// Free space regions, and how much of each was used
+	//
+	if(!freespace.Empty()) {
+		out << "Free space regions" << endl;
+		out << "=================================================================" << endl;
+		out << "Start       End         Size        Used" << endl;
+		out << "-----------------------------------------------------------------" << endl;
+
+		vector<FreeSpace::Region> regions = freespace.GetRegions();
+		for(unsigned int i = 0; i < regions.size(); ++i)
+		{
+			unsigned int start = FreeSpace::BankOrder(regions[i].first);
+			unsigned int end = FreeSpace::BankOrder(regions[i].second - 1) + 1;
+			unsigned int used = 0;
+
+			for(unsigned int j = 0; j < sections.size(); ++j) {
+				Module* m = modules[sections[j].module];
+				unsigned int a = FreeSpace::BankOrder(m->GetFragmentAddress(sections[j].fragment));
+				unsigned int b = a + m->GetFragmentExtent(sections[j].fragment);
+				if(a < end && b > start)
+					used += std::min(b, end) - std::max(a, start);
+			}
+
+			out << setfill(' ') << "$" << setw(11) << left << setbase(16) << regions[i].first
+				<< "$" << setw(11) << left << regions[i].second
+				<< setw(12) << left << setbase(10) << end - start
+				<< used << " (" << std::fixed << std::setprecision(1) << (100.0 * used / (end - start)) << "%)" << endl;
+		}
+		out << "-----------------------------------------------------------------" << endl;
+		out << endl << endl;
+	}
+
+	//
+	// Module summaries
+	//
+	out << "Module information" << endl;
+	out << "=================================================================" << endl;
+	out << "Name                         Address     Size" << endl;
+	out << "-----------------------------------------------------------------" << endl;
+	// Modules that have been split are listed by fragment
+	for(unsigned int i = 0; i < sections.size(); ++i)
+	{
+		Module* m = modules[sections[i].module];
+
+		out << setfill(' ') << setw(29) << left << sections[i].name <<
+			"$" << setw(12) << left << setbase(16) << m->GetFragmentAddress(sections[i].fragment) <<
+			setw(6) << left << setbase(10) << m->GetFragmentExtent(sections[i].fragment) << " bytes" << endl;
+	}
+	out << "-----------------------------------------------------------------" << endl;
+	out << endl << endl;
+
+
+	//
+	// Bytes saved in each module by merging text
+	//
+	if(mergetext) {
+		out << "Merged text" << endl;
+		out << "=================================================================" << endl;
+		out << "Name                         Saved" << endl;
+		out << "-----------------------------------------------------------------" << endl;
+		for(unsigned int i = 0; i < mergedbytes.size(); ++i)
+		{
+			if(mergedbytes[i] == 0)
+				continue;
+			out << setfill(' ') << setw(29) << left << modules[i]->GetName()
+				<< setbase(10) << mergedbytes[i] << " bytes" << endl;
+		}
+		out << "-----------------------------------------------------------------" << endl;
+		out << endl << endl;
+	}
+
+
+	//
+	// Code removed because nothing could reach it
+	//
+	if(strip) {
+		out << "Removed code" << endl;
+		out << "=================================================================" << endl;
+		out << "Size         Labels" << endl;
+		out << "-----------------------------------------------------------------" << endl;
+		for(unsigned int i = 0; i < removedcode.size(); ++i)
+			out << setfill(' ') << setw(13) << left << setbase(10) << removedcode[i].second
+				<< removedcode[i].first << endl;
+		out << "-----------------------------------------------------------------" << endl;
+		out << endl << endl;
+	}
+
+
+	//
+	// Label locations
+	//
+	out << "Label locations" << endl;
+	out << "=================================================================" << endl << endl;
+	for(unsigned int i = 0; i < modules.size(); ++i)
+	{
+		Module* m = modules[i];
+
+		out << "Labels in module " << m->GetName() << endl;
+		out << "Name                         Address" << endl;
+		out << "-----------------------------------------------------------------" << endl;
+
+		const std::map<std::string,Anchor*>& jumps = m->GetRootTable()->GetJumpTable();
+
+		std::map<string,Anchor*>::const_iterator j;
+		for(j = jumps.begin(); j != jumps.end(); ++j) {
+			// Skip internal labels, and those that were removed
+			if(j->first.empty() || !isalpha(j->first.at(0)) || removedlabels.count(j->second))
+				continue;
+
+			out << left << setw(28) << j->first << ' ';
+			out << "$" << setbase(16) << j->second->GetTarget() << endl;
+		}
+		out << "-----------------------------------------------------------------" << endl;
+		out << endl << endl;
+
+	}
+}
+
@@ -1,96 +1,236 @@
-/* compiler class */
-#pragma once
-
-#include <vector>
-#include <map>
-#include <string>
-#include <iostream>
-#include <fstream>
-#include <cstdlib>
-#include <cstring>
-
-class Module;
-class SymbolTable;
-class RomAccess;
-
-
-class Compiler
-{
-public:
-	bool printAST;
-	bool printRT;
-	bool printJumps;
-	bool printCode;
-	bool verbose;
-	bool noreset;
-	bool nostdlibs;
-	std::string libdir;
-
-public:
-	Compiler(const std::string& romfile, unsigned int outadr, unsigned int endadr = 0);
-	~Compiler();
-
-	bool Failed() { return failed; }
-
-	std::string FindModule(const std::string& name, const std::string& filedir);
-	Module* FindAndLoadModule(const std::string& name, const std::string& filedir);
-	Module* LoadModule(const std::string& filename);
-	Module* GetModule(const std::string& name);
-
-	// Errors
-	void Error(const std::string& msg);
-	void Warning(const std::string& msg);
-
-	void Compile();
-	void RegisterDelayedWrite(RomAccess* w);
-	void DoDelayedWrites();
-	void WriteOutput();
-	void Results();
-
-	void WriteSummary(std::ostream& out);
-
-
-
-
-private:
-	static unsigned int GetNextBank(unsigned int adr);
-
-	unsigned int MapVirtualAddress(unsigned int adr);
-
-	void ProcessImports();
-	void EvaluateModules();
-	void EvaluateLibraries();
-	void AssignModuleAddresses();
-	void OutputModules();
-
-	void WriteResetInfo(const std::string& file);
-	void ApplyResetInfo(const std::string& file);
-
-	bool failed;	// indicates a fatal error in any module
-
-
-private:
-	int errorcount;
-	int warningcount;
-
-	std::vector<Module*> modules;
-	std::vector<Module*> libs;
-	SymbolTable* libtable;
-
-	// File info
-	std::string filename;
-	char* filebuffer;
-	int filesize;
-	int actual_start;
-	int actual_end;
-	int totalfrag;
-
-	// Header/headerless ROM
-	bool has_header;
-
-	// Output and addressing
-	unsigned int outadr;
-	unsigned int endadr;
-	std::vector<RomAccess*> romwrites;
-};
-
+/* compiler class */
+#pragma once
+
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <chrono>
+
+#include "romimage.h"
+#include "buildstate.h"
+#include "resetjournal.h"
+#include "packer.h"
+#include "freespace.h"
+#include "timereport.h"
+#include "profiler.h"
+
+#define CCC_VERSION "1.337"
+
+class Module;
+class SymbolTable;
+class RomAccess;
+class Anchor;
+
+// A ROM write as the compiler keeps it until the output is written. Most
+// writes have a fixed address and value, and are resolved as soon as they
+// are made, leaving only this record and the value in the compiler's
+// arena; the rest keep their code until every label has an address.
+struct DelayedWrite
+{
+	unsigned int vaddress;	// virtual address, once resolved
+	unsigned int size;		// bytes in the value
+	unsigned int offset;	// of the value in the arena, once resolved
+	int line;				// of the statement, or 0 if made by the compiler
+	Module* module;			// that made the write, or NULL
+	RomAccess* access;		// its code, if it wasn't fixed when made; otherwise NULL
+};
+
+
+class Compiler
+{
+public:
+	bool printAST;
+	bool printRT;
+	bool printJumps;
+	bool printCode;
+	bool verbose;
+	bool noreset;
+	bool nostdlibs;
+	std::string libdir;
+	std::string cachedir;	// AST cache directory; empty to disable caching
+	std::string patchfile;	// if set, a patch is written here instead of modifying the ROM
+	std::string statefile;	// if set, build state is kept here for incremental compilation
+	bool stable;			// keep modules where the previous build placed them
+	std::string summaryfile;	// previous summary; read for the layout if there's no reset file
+	BankPacker::Method packmethod;	// how modules are packed into banks
+	bool splitlabels;		// place each module's output in fragments split at its labels
+	bool optimize;			// run the peephole optimizer over each module's output
+	bool mergetext;			// replace text repeated across modules with jumps to one copy
+	unsigned int outline;	// outline repeated command expansions of at least this size; 0 to disable
+	unsigned int compress;	// compress text with a dictionary of up to this many entries; 0 to disable
+	unsigned int dictionaryfirst;	// first entry of the game's text dictionary compression may replace
+	unsigned int dictionarylast;	// last such entry
+	bool strip;				// remove code that nothing can reach
+	std::string rootsfile;	// if set, labels listed here are reachable for strip
+	bool sizeonly;			// only work out the size and placement of the output; write nothing
+	unsigned int packtime;	// time limit for exact packing, in ms
+	FreeSpace freespace;	// regions output may be placed in; the start/end window if empty
+	std::string regionfile;	// if set, regions are also read from here
+	unsigned int scanfree;	// if nonzero, runs of 00/FF at least this long are also used
+	TimeReport timing;		// time spent in each phase of the build, if enabled
+	Profiler profiler;		// samples the script call stack during evaluation, if enabled
+
+public:
+	Compiler();
+	Compiler(const std::string& romfile, unsigned int outadr, unsigned int endadr = 0);
+	~Compiler();
+
+	bool Failed() { return failed; }
+
+	std::string FindModule(const std::string& name, const std::string& filedir);
+	bool IsLibraryFile(const std::string& path);
+	Module* FindAndLoadModule(const std::string& name, const std::string& filedir);
+	Module* LoadModule(const std::string& filename);
+	Module* GetModule(const std::string& name);
+	bool Precompile(const std::string& filename);
+
+	// Errors
+	void Error(const std::string& msg);
+	void Warning(const std::string& msg);
+
+	void Compile();
+	void RegisterDelayedWrite(RomAccess* w, Module* m = NULL);
+	void PrepareDelayedWrites();
+	void DoDelayedWrites();
+	void CheckOverlaps();
+	void WriteOutput();
+	void Results();
+
+	void WriteSummary(std::ostream& out);
+	void WriteSizeReport(std::ostream& out);
+	void WriteTimeReport(const std::string& file);
+	void WriteTrace(const std::string& file);
+	void WriteProfile(const std::string& file);
+
+	// A piece of output that is placed as a unit: a whole module, or one
+	// fragment of a module that has been split at its labels
+	struct Section {
+		unsigned int module;	// index into the module list
+		unsigned int fragment;
+		unsigned int size;		// including room for a jump to the next fragment
+		std::string name;		// module name, with "#n" appended for fragments
+	};
+
+
+
+
+private:
+	void Init();
+
+	bool LoadRom();
+	void WaitForRom();
+
+	static unsigned int GetNextBank(unsigned int adr);
+	void GetBanks(std::vector<unsigned int>& starts, std::vector<unsigned int>& capacities);
+
+	unsigned int MapVirtualAddress(unsigned int adr);
+
+	std::string SearchIncludePaths(const std::string& name, const std::string& filedir);
+	const std::string& CanonicalPath(const std::string& path);
+
+	void ProcessImports();
+	void IndexSymbols();
+	void EvaluateModules();
+	unsigned long long ModuleInputKey(Module* m, const std::set<std::string>& siblingrefs);
+	void CompressText();
+	void StripDeadCode();
+	void SaveBuildState();
+	void EvaluateLibraries();
+	void GetSections(std::vector<Section>& sections) const;
+	void PlaceSections(const std::vector<Section>& sections, const std::vector<unsigned int>& addresses);
+	void AssignModuleAddresses();
+	bool AssignStableAddresses(const std::vector<Section>& sections);
+	bool ReadSummaryLayout(const std::string& file);
+	void OutputModules();
+
+	void WriteResetInfo(const std::string& file);
+	void ApplyResetInfo(const std::string& file);
+	static std::string LegacyResetFile(const std::string& file);
+
+	bool failed;	// indicates a fatal error in any module
+
+
+private:
+	int errorcount;
+	int warningcount;
+
+	std::vector<Module*> modules;
+	std::vector<Module*> libs;
+	std::unordered_map<std::string, Module*> modulesbyname;
+	SymbolTable* libtable;
+
+	// Global index of identifiers to the modules defining them at root scope
+	std::map<std::string, std::vector<Module*> > symbolindex;
+
+	// Memoized include path resolution. Resolved paths are keyed by the
+	// importing directory and the import name; canonical paths are keyed
+	// by the path they were computed from.
+	std::unordered_map<std::string, std::string> resolvedpaths;
+	std::unordered_map<std::string, std::string> canonicalpaths;
+
+	// Output of the previous compilation, for incremental builds
+	BuildState buildstate;
+
+	// File info
+	std::string filename;
+	RomImage rom;
+	char* filebuffer;		// rom.GetData(), once loaded
+	int filesize;
+	int actual_start;
+	int actual_end;
+	int totalfrag;
+	unsigned int banksused;
+	unsigned int bankbound;		// lower bound on the number of banks needed
+	bool packtimedout;			// exact packing stopped at the time limit
+	unsigned int optimizedbytes;	// bytes removed by the peephole optimizer
+	std::vector<unsigned int> mergedbytes;	// bytes removed from each module by text merging
+	unsigned int outlinedbytes;	// bytes saved by outlining command expansions
+	int compressedbytes;		// bytes saved by compressing text, less the dictionary
+	unsigned int dictionarysize;	// entries in the text compression dictionary
+
+	// Code removed as unreachable, by the labels it had (or the module, if
+	// it had none)
+	std::vector<std::pair<std::string, unsigned int> > removedcode;
+	std::set<const Anchor*> removedlabels;
+	unsigned int strippedbytes;
+
+	// Stable placement
+	std::vector<ResetJournal::Placement> previouslayout;
+	unsigned int keptmodules;	// modules left at their previous addresses
+	bool repacked;				// stable placement gave up and everything was packed again
+	int changedbytes;			// bytes that differ from the ROM file, or -1 if unknown
+
+	// Header/headerless ROM
+	bool has_header;
+
+	// Output and addressing
+	unsigned int outadr;
+	unsigned int endadr;
+	std::vector<DelayedWrite> romwrites;	// in the order they were made
+	std::vector<char> writevalues;			// the arena holding their values
+
+	// ROM writes, once resolved, are merged into runs of contiguous bytes
+	// whose final contents are kept back to back in a single arena
+	struct WriteRun {
+		unsigned int address;	// physical
+		unsigned int vaddress;	// virtual address of the first byte
+		unsigned int size;
+		unsigned int offset;	// into writearena
+	};
+	std::vector<WriteRun> writeruns;	// sorted by address
+	std::vector<char> writearena;
+
+	// The ROM is loaded in the background while modules are parsed and
+	// evaluated; anything that needs filebuffer must call WaitForRom first
+	std::future<bool> romload;
+	double romloadtime;		// time taken by the background load, in ms
+	double romwaittime;		// time spent blocked waiting for it, in ms
+};
+
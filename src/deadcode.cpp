@@ -0,0 +1,239 @@
+/* removal of unreachable code implementation */
+
+#include "deadcode.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "anchor.h"
+#include "bytechunk.h"
+
+using namespace std;
+
+
+/*
+ * A piece of code between two anchors
+ */
+struct DeadCode::Piece {
+	unsigned int start;
+	unsigned int end;
+	bool fallsthrough;			// false if it's known to end with an [02] or a goto
+	vector<Anchor*> targets;	// anchors referred to from inside it
+};
+
+typedef pair<unsigned int, unsigned int> PieceIndex;	// (chunk, piece)
+
+/*
+ * Marks the piece at an anchor as reached, if it isn't already
+ */
+static void Reach(Anchor* anchor, const map<Anchor*, PieceIndex>& pieceat,
+	vector<vector<bool> >& reached, vector<PieceIndex>& pending)
+{
+	map<Anchor*, PieceIndex>::const_iterator found = pieceat.find(anchor);
+	if(found == pieceat.end())
+		return;
+
+	const PieceIndex& p = found->second;
+	if(!reached[p.first][p.second]) {
+		reached[p.first][p.second] = true;
+		pending.push_back(p);
+	}
+}
+
+static bool StartsBefore(const DeadCode::Block& block, unsigned int pos)
+{
+	return block.start < pos;
+}
+
+
+vector<DeadCode::Block> DeadCode::Strip(const vector<ByteChunk*>& chunks,
+	const vector<const ByteChunk*>& others, const vector<Anchor*>& roots)
+{
+	vector<vector<Piece> > pieces(chunks.size());
+	vector<vector<bool> > reached(chunks.size());
+	map<Anchor*, PieceIndex> pieceat;
+
+	for(unsigned int c = 0; c < chunks.size(); ++c)
+	{
+		FindPieces(*chunks[c], pieces[c]);
+		reached[c].assign(pieces[c].size(), false);
+
+		// An anchor leads to the piece starting where it is; one at the very
+		// end of a chunk leads nowhere that's known
+		vector<unsigned int> starts;
+		for(unsigned int i = 0; i < pieces[c].size(); ++i)
+			starts.push_back(pieces[c][i].start);
+
+		for(vector<Anchor*>::const_iterator it = chunks[c]->anchors.begin(); it != chunks[c]->anchors.end(); ++it) {
+			unsigned int pos = (*it)->GetPosition();
+			vector<unsigned int>::const_iterator found = lower_bound(starts.begin(), starts.end(), pos);
+			if(found != starts.end() && *found == pos)
+				pieceat.insert(make_pair(*it, PieceIndex(c, found - starts.begin())));
+		}
+	}
+
+	vector<PieceIndex> pending;
+	for(vector<Anchor*>::const_iterator it = roots.begin(); it != roots.end(); ++it)
+		Reach(*it, pieceat, reached, pending);
+	for(vector<const ByteChunk*>::const_iterator it = others.begin(); it != others.end(); ++it) {
+		if(!*it)
+			continue;
+		const vector<ByteChunk::Reference>& refs = (*it)->refs;
+		for(unsigned int i = 0; i < refs.size(); ++i)
+			Reach(refs[i].target, pieceat, reached, pending);
+	}
+
+	while(!pending.empty())
+	{
+		PieceIndex p = pending.back();
+		pending.pop_back();
+
+		const Piece& piece = pieces[p.first][p.second];
+		for(vector<Anchor*>::const_iterator it = piece.targets.begin(); it != piece.targets.end(); ++it)
+			Reach(*it, pieceat, reached, pending);
+
+		if(piece.fallsthrough && p.second + 1 < pieces[p.first].size()
+			&& !reached[p.first][p.second + 1])
+		{
+			reached[p.first][p.second + 1] = true;
+			pending.push_back(PieceIndex(p.first, p.second + 1));
+		}
+	}
+
+	// Remove each run of pieces that wasn't reached
+	vector<Block> removed;
+	for(unsigned int c = 0; c < chunks.size(); ++c)
+	{
+		ByteChunk& chunk = *chunks[c];
+		unsigned int first = removed.size();
+		vector<ByteChunk::Range> ranges;
+
+		for(unsigned int i = 0; i < pieces[c].size(); ++i) {
+			if(reached[c][i])
+				continue;
+			if(!ranges.empty() && ranges.back().second == pieces[c][i].start)
+				ranges.back().second = pieces[c][i].end;
+			else
+				ranges.push_back(ByteChunk::Range(pieces[c][i].start, pieces[c][i].end));
+		}
+
+		for(vector<ByteChunk::Range>::const_iterator it = ranges.begin(); it != ranges.end(); ++it) {
+			Block block = { c, it->first, it->second - it->first, vector<Anchor*>() };
+			removed.push_back(block);
+		}
+
+		set<Anchor*> seen;
+		for(vector<Anchor*>::const_iterator it = chunk.anchors.begin(); it != chunk.anchors.end(); ++it) {
+			unsigned int pos = (*it)->GetPosition();
+			vector<Block>::iterator block = lower_bound(removed.begin() + first, removed.end(), pos + 1, StartsBefore);
+			if(block == removed.begin() + first)
+				continue;
+			--block;
+			if(pos < block->start + block->size && seen.insert(*it).second)
+				block->anchors.push_back(*it);
+		}
+
+		chunk.Remove(ranges);
+	}
+
+	return removed;
+}
+
+/*
+ * Cuts a chunk into pieces at its anchors
+ */
+void DeadCode::FindPieces(const ByteChunk& chunk, vector<Piece>& pieces)
+{
+	const vector<unsigned char>& bytes = chunk.bytes;
+	const vector<ByteChunk::Reference>& refs = chunk.refs;
+	unsigned int size = bytes.size();
+
+	// The bytes that belong to references, and the references that are a
+	// whole address, by the position of their first byte
+	vector<bool> covered(size, false);
+	vector<int> refat(size + 1, -1);
+	for(unsigned int i = 0; i < refs.size(); ++i)
+	{
+		const ByteChunk::Reference& r = refs[i];
+		int first = max(r.location + r.offset, 0);
+		int last = min(r.location + r.offset + r.length, (int)size);
+		for(int p = first; p < last; ++p)
+			covered[p] = true;
+		if(r.offset == 0 && r.length == 4 && r.location >= 0 && r.location + 4 <= (int)size)
+			refat[r.location] = i;
+	}
+
+	vector<unsigned int> cuts;
+	cuts.push_back(0);
+	cuts.push_back(size);
+	for(vector<Anchor*>::const_iterator it = chunk.anchors.begin(); it != chunk.anchors.end(); ++it) {
+		int p = (*it)->GetPosition();
+		if(p >= 0 && p <= (int)size)
+			cuts.push_back(p);
+	}
+	std::sort(cuts.begin(), cuts.end());
+	cuts.erase(unique(cuts.begin(), cuts.end()), cuts.end());
+
+	// Positions known to be the start of a code, and where each of those
+	// codes ends, if that's known too
+	vector<bool> start(size + 1, false);
+	vector<unsigned int> next(size, 0);
+	for(vector<unsigned int>::const_iterator it = cuts.begin(); it != cuts.end(); ++it)
+		start[*it] = true;
+
+	for(unsigned int p = 0; p < size; ++p)
+	{
+		if(chunk.cinfo[p] && !covered[p]) {
+			next[p] = p + 1;
+			start[p + 1] = true;
+			continue;
+		}
+		if(!start[p] || covered[p])
+			continue;
+
+		switch(bytes[p]) {
+			case 0x00: case 0x01: case 0x02: case 0x03: case 0x12: case 0x13: case 0x14:
+				next[p] = p + 1;
+				break;
+			case 0x08: case 0x0A:
+				if(refat[p + 1] >= 0)
+					next[p] = p + 5;
+				break;
+			case 0x1B:
+				if(p + 2 < size && (bytes[p + 1] == 0x02 || bytes[p + 1] == 0x03)
+					&& !covered[p + 1] && refat[p + 2] >= 0)
+					next[p] = p + 6;
+				break;
+		}
+		if(next[p])
+			start[next[p]] = true;
+	}
+
+	pieces.clear();
+	for(unsigned int i = 0; i + 1 < cuts.size(); ++i)
+	{
+		Piece piece;
+		piece.start = cuts[i];
+		piece.end = cuts[i + 1];
+		piece.fallsthrough = true;
+
+		for(unsigned int p = piece.start; p < piece.end; ++p) {
+			if(start[p] && next[p] == piece.end && !chunk.cinfo[p]
+				&& (bytes[p] == 0x02 || bytes[p] == 0x0A))
+				piece.fallsthrough = false;
+		}
+
+		pieces.push_back(piece);
+	}
+
+	for(unsigned int r = 0; r < refs.size(); ++r) {
+		int first = refs[r].location + refs[r].offset;
+		if(first < 0 || first >= (int)size)
+			continue;
+		unsigned int i = upper_bound(cuts.begin(), cuts.end(), (unsigned int)first) - cuts.begin() - 1;
+		pieces[i].targets.push_back(refs[r].target);
+	}
+}
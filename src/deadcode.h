@@ -0,0 +1,43 @@
+/* removal of unreachable code */
+#pragma once
+
+#include <vector>
+
+class Anchor;
+class ByteChunk;
+
+// Every top-level statement of every module is output, whether or not
+// anything can ever reach it. This finds the code that can be reached
+// from a set of roots, and removes the rest.
+//
+// The code is cut into pieces at every anchor, labels and generated jump
+// targets alike. A piece is reached if an anchor at its start is a root,
+// or is referred to from a piece that is reached, or if the piece before
+// it is reached and can fall through into it. Only a piece that ends with
+// an [02] or a goto where a code is known to start (see TailMerger) is
+// taken not to fall through; anything else might.
+//
+// Everything referred to from outside the given chunks, such as by ROM
+// writes, is a root as well.
+class DeadCode
+{
+public:
+	// A stretch of code that was removed
+	struct Block {
+		unsigned int chunk;				// index of the chunk it was removed from
+		unsigned int start;				// position it had in the chunk, before anything was removed
+		unsigned int size;
+		std::vector<Anchor*> anchors;	// anchors that were placed in it
+	};
+
+	// Removes the code in the given chunks that can't be reached from the
+	// given anchors, or from anything the other chunks refer to. Returns
+	// what was removed, in order of chunk and position.
+	static std::vector<Block> Strip(const std::vector<ByteChunk*>& chunks,
+		const std::vector<const ByteChunk*>& others, const std::vector<Anchor*>& roots);
+
+private:
+	struct Piece;
+
+	static void FindPieces(const ByteChunk& chunk, std::vector<Piece>& pieces);
+};
@@ -0,0 +1,212 @@
+/* free space map implementation */
+
+#include "freespace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "exception.h"
+
+using namespace std;
+
+
+FreeSpace::FreeSpace()
+	: merged(true)
+{
+}
+
+unsigned int FreeSpace::BankOrder(unsigned int adr)
+{
+	return adr >= 0xC00000 ? adr - 0xC00000 : adr - 0x10000;
+}
+
+unsigned int FreeSpace::FromBankOrder(unsigned int key)
+{
+	return key < 0x400000 ? key + 0xC00000 : key + 0x10000;
+}
+
+bool FreeSpace::IsUsable(unsigned int adr)
+{
+	// Bank 40 is left out, as in Compiler::GetNextBank
+	return (adr >= 0xC00000 && adr <= 0xFFFFFF) || (adr >= 0x410000 && adr <= 0x5FFFFF);
+}
+
+bool FreeSpace::Add(unsigned int start, unsigned int end)
+{
+	if(start >= end || !IsUsable(start) || !IsUsable(end - 1))
+		return false;
+
+	// Both ends can be usable with unusable banks in between
+	if(BankOrder(end - 1) - BankOrder(start) != end - 1 - start)
+		return false;
+
+	regions.push_back(Region(BankOrder(start), BankOrder(end - 1) + 1));
+	merged = false;
+	return true;
+}
+
+bool FreeSpace::ParseRegion(const string& text, unsigned int& start, unsigned int& end)
+{
+	const char* s = text.c_str();
+	char* p;
+
+	start = strtoul(s, &p, 16);
+	if(p == s || *p != '-')
+		return false;
+
+	s = p + 1;
+	end = strtoul(s, &p, 16);
+	return p != s && *p == '\0';
+}
+
+void FreeSpace::ReadFile(const string& path)
+{
+	ifstream in(path.c_str());
+	if(in.fail())
+		throw Exception("couldn't open region file '" + path + "'");
+
+	string line;
+	for(int n = 1; getline(in, line); ++n)
+	{
+		string::size_type comment = line.find('#');
+		if(comment != string::npos)
+			line.erase(comment);
+
+		string::size_type first = line.find_first_not_of(" \t\r");
+		if(first == string::npos)
+			continue;
+		string::size_type last = line.find_last_not_of(" \t\r");
+		line = line.substr(first, last - first + 1);
+
+		unsigned int start, end;
+		if(!ParseRegion(line, start, end) || !Add(start, end)) {
+			stringstream ss;
+			ss << path << ":" << n << ": bad region '" << line << "'";
+			throw Exception(ss.str());
+		}
+	}
+}
+
+
+/*
+ * Returns the eight bytes at p as one word
+ */
+static inline uint64_t Word(const unsigned char* p)
+{
+	uint64_t w;
+	memcpy(&w, p, sizeof(w));
+	return w;
+}
+
+/*
+ * Returns nonzero if any byte of the word is zero
+ */
+static inline uint64_t HasZeroByte(uint64_t w)
+{
+	return (w - 0x0101010101010101ULL) & ~w & 0x8080808080808080ULL;
+}
+
+/*
+ * Adds the runs of 00 or FF found in [begin, end) of 'data', which starts
+ * at virtual address 'base'
+ */
+static void ScanSpan(FreeSpace& space, const unsigned char* data, unsigned int begin, unsigned int end,
+	unsigned int base, unsigned int minlength)
+{
+	unsigned int i = begin;
+	while(i < end)
+	{
+		// Skip a word at a time while it has neither a 00 nor an FF in it,
+		// which is almost everywhere in a full ROM
+		while(i + 8 <= end) {
+			uint64_t w = Word(data + i);
+			if(HasZeroByte(w) || HasZeroByte(~w))
+				break;
+			i += 8;
+		}
+		if(i == end)
+			break;
+
+		unsigned char c = data[i];
+		if(c != 0x00 && c != 0xFF) {
+			i++;
+			continue;
+		}
+
+		// Then extend the run a word at a time, and finish byte by byte
+		unsigned int start = i++;
+		uint64_t fill = c ? ~0ULL : 0;
+		while(i + 8 <= end && Word(data + i) == fill)
+			i += 8;
+		while(i < end && data[i] == c)
+			i++;
+
+		if(i - start >= minlength)
+			space.Add(base + start - begin, base + i - begin);
+	}
+}
+
+void FreeSpace::Scan(const char* data, unsigned int size, unsigned int header, unsigned int minlength)
+{
+	if(size <= header || minlength == 0)
+		return;
+
+	const unsigned char* rom = reinterpret_cast<const unsigned char*>(data) + header;
+	unsigned int romsize = size - header;
+
+	// Banks C0-FF are the first 4MB of the ROM, and 41-5F follow bank 40
+	ScanSpan(*this, rom, 0, min(romsize, 0x400000u), 0xC00000, minlength);
+	if(romsize > 0x410000)
+		ScanSpan(*this, rom, 0x410000, min(romsize, 0x600000u), 0x410000, minlength);
+}
+
+
+void FreeSpace::Merge() const
+{
+	if(merged)
+		return;
+
+	std::sort(regions.begin(), regions.end());
+
+	vector<Region> out;
+	for(vector<Region>::const_iterator it = regions.begin(); it != regions.end(); ++it) {
+		if(!out.empty() && it->first <= out.back().second)
+			out.back().second = max(out.back().second, it->second);
+		else
+			out.push_back(*it);
+	}
+	regions.swap(out);
+	merged = true;
+}
+
+vector<FreeSpace::Region> FreeSpace::GetRegions() const
+{
+	Merge();
+
+	vector<Region> out;
+	for(vector<Region>::const_iterator it = regions.begin(); it != regions.end(); ++it)
+		out.push_back(Region(FromBankOrder(it->first), FromBankOrder(it->second - 1) + 1));
+	return out;
+}
+
+void FreeSpace::GetBanks(vector<unsigned int>& starts, vector<unsigned int>& capacities) const
+{
+	Merge();
+
+	starts.clear();
+	capacities.clear();
+
+	// Bank boundaries fall on multiples of 0x10000 in bank order too
+	for(vector<Region>::const_iterator it = regions.begin(); it != regions.end(); ++it) {
+		for(unsigned int key = it->first; key < it->second; ) {
+			unsigned int next = min((key & ~0xFFFFu) + 0x10000, it->second);
+			starts.push_back(FromBankOrder(key));
+			capacities.push_back(next - key);
+			key = next;
+		}
+	}
+}
@@ -0,0 +1,60 @@
+/* free space map */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+// The areas of the ROM that compiled output may be placed in.
+//
+// Without a free space map, output goes in the single window given by the
+// start and end addresses. With one, it can go in any number of separate
+// regions, given on the command line, read from a file, or found by
+// scanning the ROM for long runs of unused bytes.
+//
+// Regions are kept in bank order: banks C0-FF first, then 41-5F, the order
+// in which banks are filled (see Compiler::GetNextBank). In that order the
+// usable banks are contiguous, so regions can be sorted and merged simply.
+class FreeSpace
+{
+public:
+	typedef std::pair<unsigned int, unsigned int> Region;	// [first, second), virtual addresses
+
+	FreeSpace();
+
+	// Converts between virtual addresses and positions in bank order
+	static unsigned int BankOrder(unsigned int adr);
+	static unsigned int FromBankOrder(unsigned int key);
+
+	// Returns true if the virtual address is in a usable bank
+	static bool IsUsable(unsigned int adr);
+
+	// Adds a region. Returns false if it isn't a valid range of usable banks.
+	bool Add(unsigned int start, unsigned int end);
+
+	// Parses a region given as "start-end", in hex. Returns false if malformed.
+	static bool ParseRegion(const std::string& text, unsigned int& start, unsigned int& end);
+
+	// Adds the regions listed in a file, one "start-end" per line; anything
+	// after a '#' is a comment. Throws an Exception on failure.
+	void ReadFile(const std::string& path);
+
+	// Adds every run of at least 'minlength' bytes of 00 or FF in the given
+	// ROM data. 'header' is the size of the copier header, if any.
+	void Scan(const char* data, unsigned int size, unsigned int header, unsigned int minlength);
+
+	bool Empty() const { return regions.empty(); }
+
+	// Returns the regions, sorted and merged
+	std::vector<Region> GetRegions() const;
+
+	// Splits the regions at bank boundaries into the bins the packer fills:
+	// their start addresses and capacities
+	void GetBanks(std::vector<unsigned int>& starts, std::vector<unsigned int>& capacities) const;
+
+private:
+	void Merge() const;
+
+	mutable std::vector<Region> regions;	// [first, second), in bank order
+	mutable bool merged;				// true if 'regions' is sorted and merged
+};
@@ -1,9 +1,9 @@
-/* CCScript Functions */
-#pragma once
-
-
-class Function
-{
-
-};
-
+/* CCScript Functions */
+#pragma once
+
+
+class Function
+{
+
+};
+
@@ -0,0 +1,92 @@
+/* set of tagged address intervals implementation */
+
+#include "intervalset.h"
+
+#include <algorithm>
+
+using namespace std;
+
+
+IntervalSet::IntervalSet()
+	: sorted(true), uptodate(true)
+{
+}
+
+void IntervalSet::Add(unsigned int start, unsigned int end, unsigned int tag)
+{
+	if(start >= end)
+		return;
+
+	Interval i = { start, end, tag };
+
+	// Intervals mostly arrive in address order, which keeps the set sorted
+	if(!intervals.empty() && start < intervals.back().start)
+		sorted = false;
+
+	intervals.push_back(i);
+	uptodate = false;
+}
+
+void IntervalSet::Clear()
+{
+	intervals.clear();
+	merged.clear();
+	sorted = true;
+	uptodate = true;
+}
+
+
+/*
+ * Predicate for ordering intervals by start address; ties keep the order
+ * the intervals were added in
+ */
+static bool StartOrder(const IntervalSet::Interval& a, const IntervalSet::Interval& b)
+{
+	return a.start < b.start;
+}
+
+void IntervalSet::Sort()
+{
+	if(sorted)
+		return;
+	std::stable_sort(intervals.begin(), intervals.end(), StartOrder);
+	sorted = true;
+}
+
+const vector<IntervalSet::Interval>& IntervalSet::GetIntervals()
+{
+	Sort();
+	return intervals;
+}
+
+
+void IntervalSet::FindOverlaps(vector<pair<unsigned int, unsigned int> >& pairs)
+{
+	Sort();
+	pairs.clear();
+
+	// Everything that overlaps an interval and starts no earlier follows it
+	// directly in sorted order, up to the first one starting past its end
+	for(unsigned int i = 0; i < intervals.size(); ++i) {
+		for(unsigned int j = i + 1; j < intervals.size() && intervals[j].start < intervals[i].end; ++j)
+			pairs.push_back(make_pair(i, j));
+	}
+}
+
+const vector<IntervalSet::Range>& IntervalSet::GetUnion()
+{
+	if(uptodate)
+		return merged;
+
+	Sort();
+
+	merged.clear();
+	for(vector<Interval>::const_iterator it = intervals.begin(); it != intervals.end(); ++it) {
+		if(!merged.empty() && it->start <= merged.back().second)
+			merged.back().second = max(merged.back().second, it->end);
+		else
+			merged.push_back(Range(it->start, it->end));
+	}
+	uptodate = true;
+	return merged;
+}
@@ -0,0 +1,51 @@
+/* set of tagged address intervals */
+#pragma once
+
+#include <vector>
+#include <utility>
+
+// A collection of [start, end) intervals, each tagged with a number that
+// identifies where it came from.
+//
+// Intervals are only collected as they're added; the set is sorted by
+// start address the first time it is queried, so finding every pair that
+// overlaps takes O(n log n) plus the number of pairs found, and the union
+// of the intervals comes from a single pass over the sorted set.
+class IntervalSet
+{
+public:
+	typedef std::pair<unsigned int, unsigned int> Range;	// [first, second)
+
+	struct Interval {
+		unsigned int start;
+		unsigned int end;
+		unsigned int tag;
+	};
+
+	IntervalSet();
+
+	// Adds an interval. Empty intervals are ignored.
+	void Add(unsigned int start, unsigned int end, unsigned int tag = 0);
+
+	void Clear();
+	bool Empty() const { return intervals.empty(); }
+
+	// Returns the intervals, sorted by start address
+	const std::vector<Interval>& GetIntervals();
+
+	// Gets every pair of intervals that overlap, as indices into
+	// GetIntervals(), the earlier one first
+	void FindOverlaps(std::vector<std::pair<unsigned int, unsigned int> >& pairs);
+
+	// Returns the union of the intervals: sorted, with overlapping or
+	// adjacent ones merged
+	const std::vector<Range>& GetUnion();
+
+private:
+	void Sort();
+
+	std::vector<Interval> intervals;
+	std::vector<Range> merged;
+	bool sorted;			// true if 'intervals' is sorted
+	bool uptodate;			// true if 'merged' reflects 'intervals'
+};
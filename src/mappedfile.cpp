@@ -0,0 +1,88 @@
+/* read-only mapped file implementation */
+
+#include "mappedfile.h"
+
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+
+MappedFile::MappedFile()
+	: data(NULL), size(0), mapped(false)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const string& path)
+{
+	Close();
+
+#ifndef _WIN32
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+
+	struct stat st;
+	if(fstat(fd, &st) == 0) {
+		size = st.st_size;
+
+		// Zero-length files can't be mapped, but they're perfectly valid
+		if(size == 0) {
+			close(fd);
+			return true;
+		}
+
+		void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(p != MAP_FAILED) {
+			close(fd);
+			data = static_cast<const char*>(p);
+			mapped = true;
+			return true;
+		}
+	}
+	close(fd);
+	size = 0;
+#endif
+
+	// Fall back to reading the file into memory
+	ifstream file(path.c_str(), ifstream::binary);
+	if(file.fail())
+		return false;
+
+	file.seekg(0, ifstream::end);
+	buffer.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	if(!buffer.empty())
+		file.read(&buffer[0], buffer.size());
+	if(file.fail()) {
+		buffer.clear();
+		return false;
+	}
+
+	data = buffer.empty() ? NULL : &buffer[0];
+	size = buffer.size();
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifndef _WIN32
+	if(mapped)
+		munmap(const_cast<char*>(data), size);
+#endif
+	mapped = false;
+	data = NULL;
+	size = 0;
+	buffer.clear();
+}
@@ -0,0 +1,31 @@
+/* read-only mapped file */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// A read-only view of a whole file. On POSIX systems the file is mapped
+// into memory; elsewhere it is simply read into a private buffer. Either
+// way the contents stay valid until the object is closed or destroyed.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const std::string& path);		// Returns false if the file couldn't be opened
+	void Close();
+
+	const char* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const char* data;
+	size_t size;
+	bool mapped;				// true if data points into a mapping
+	std::vector<char> buffer;	// fallback storage when mapping isn't available
+};
@@ -1,408 +1,605 @@
-/* definition for module class */
-
-#include "module.h"
-
-#include <algorithm>
-#include <string>
-#include <sstream>
-#include <fstream>
-#include <iostream>
-#include <vector>
-
-#include "compiler.h"
-#include "ast.h"
-#include "lexer.h"
-#include "parser.h"
-#include "symboltable.h"
-#include "bytechunk.h"
-#include "exception.h"
-
-using namespace std;
-
-void Module::Error(const string& msg, int line, int col)
-{
-	stringstream ss;
-	ss << filename << ", line " << line << ": " << msg;
-	parent->Error(ss.str());
-	failed = true;
-}
-
-void Module::Warning(const string& msg, int line, int col)
-{
-	stringstream ss;
-	ss << filename << ", line " << line << ": warning: " << msg;
-	parent->Warning(ss.str());
-}
-
-
-/*
- * Constructs a code module from the given source file
- */
-Module::Module(const string& filename, Compiler* parent)
-{
-	this->parent = parent;
-	this->failed = false;
-	this->roottable = new SymbolTable();
-	Load(filename);
-}
-
-Module::Module(const string& filename, Compiler* parent, SymbolTable* root)
-{
-	this->parent = parent;
-	this->failed = false;
-	this->roottable = root;
-	Load(filename);
-}
-
-/*
- * Loads and parses a module from a given source filename.
- * Once loaded, the module should be ready for evaluation if Failed() is false.
- */
-void Module::Load(const string& filename)
-{
-	this->filename = filename;
-	this->modulename = NameFromFilename(filename);
-	// Check module name for validity
-	if(!CheckName(modulename)) {
-		parent->Error("module name '" + modulename + "' invalid. Module names can only contain alphanumeric characters and underscores.");
-		failed = true;
-		return;
-	}
-	ifstream in(filename.c_str());
-
-
-	if(in.fail())
-	{
-		parent->Error("couldn't open " + filename);
-		failed = true;
-		return;
-	}
-
-	stringbuf sb;
-	in >> std::noskipws >> &sb;
-	program = NULL;
-
-	// Parse the module
-	Parser parser(sb.str());
-	parser.SetErrorHandler(this);
-	this->program = parser.Parse();
-	if(failed) return;
-
-	// After parsing, we know if the module includes any others
-
-
-	// Build root table
-	program->PreTypecheck(roottable, true);
-	if(failed) return;
-
-	importtable = new SymbolTable();
-	roottable->SetParent(importtable);
-
-	code = new ByteChunk();
-
-	labelbase = 0;
-}
-
-/*
- * Produces a name string from a filename
- */
-string Module::NameFromFilename(const string& filename)
-{
-	// Get just the part of the filename between the last directory separator and the first period
-	size_t p1 = filename.find_last_of("/\\");
-	if(p1 == string::npos)
-		p1 = 0;
-	else
-		p1++;
-
-	size_t p2 = filename.find('.', p1);
-	if(p2 == string::npos)
-		p2 = filename.length();
-
-	return filename.substr(p1, p2-p1);
-}
-
-/*
- * Verifies that a string is a valid module name
- */
-bool Module::CheckName(const string& name)
-{
-	// String must contain only alphanumeric characters and _
-	// Also, cannot start with a number
-	if(isdigit(name[0])) return false;
-	for(unsigned int i = 0; i < name.length(); ++i) {
-		if(!isalnum(name[i]) && name[i] != '_')
-			return false;
-	}
-	return true;
-}
-
-
-/*
- * Returns the module's name.
- */
-string Module::GetName() const
-{
-	return modulename;
-}
-
-
-/*
- * Returns the module's filename
- */
-string Module::GetFileName() const
-{
-	return filename;
-}
-
-
-/*
- * Evaluates the program
- */
-void Module::Execute()
-{
-	if(failed) {
-		parent->Error("There were compilation errors. Cannot execute module.");
-		return;
-	}
-	EvalContext context;
-	context.module = this;
-	context.compiler = this->parent;
-	context.labels = this->GetRootTable();
-	context.output = this->GetCodeChunk();
-	program->Run(roottable, context);
-}
-
-/*
- * Returns true iff parsing or evaluation of the module failed.
- */
-bool Module::Failed() const
-{
-	return failed;
-}
-
-
-SymbolTable* Module::GetRootTable() const
-{
-	return roottable;
-}
-
-/*
- * Assigns the "library" table, a "fallback" root scope
- * intended to contain standard library identifiers
- */
-void Module::SetLibTable(SymbolTable *lib)
-{
-	roottable->SetParent(lib);
-}
-
-void Module::AddImport(const string& name)
-{
-	vector<string>::const_iterator it =
-		find(program->imports.begin(), program->imports.end(), name);
-	if(it == program->imports.end())
-		program->imports.insert(program->imports.begin(), name);
-}
-
-void Module::Include(Module* other)
-{
-	// To do this, we create a chain of root tables.
-	// Whenever an include is made, we insert a copy of the included
-	// module's root table directly above this module's root table in
-	// the chain. We then set the copied root table's parent to the
-	// former parent of this module's root table.
-
-	// Hmm. In this method, colliding symbols in includes would be
-	// silently resolved to the last-included symbol. I don't think
-	// this behavior is optimal. There should at least be a warning,
-	// and quite possibly the symbol should be simply omitted from the
-	// table, thus requiring resolution.
-
-	// Okay, instead, here's what we'll do. Each module still has an
-	// "inclusion" symbol table above its root table, and includes are
-	// *merged* into that table. Collisions generate a warning and
-	// result in the omission of all colliding symbols.
-
-	// Merge symbols
-
-	vector<string> collisions;
-	importtable->Merge( *other->GetRootTable(), collisions );
-
-	// Add ambiguity symbols for collisions
-	for(vector<string>::const_iterator it = collisions.begin();
-		it != collisions.end(); ++it)
-	{
-		Value existing = importtable->Get(*it);
-
-		if(existing.GetType() != Type::Macro || existing.GetNode()->GetType() != ambiguousid) {
-			AmbiguousID* ambig = new AmbiguousID(*it, this);
-
-			// This is kind of a hack. Scan through all the modules
-			// to find which ones include this symbol.
-			vector<string> defining = GetImportsDefining(*it);
-
-			for(vector<string>::const_iterator k = defining.begin();
-				k != defining.end(); ++k)
-			{
-				ambig->AddModule(*k);
-			}
-			
-			importtable->Define(*it, Value(ambig));
-		}
-		else {
-			AmbiguousID* ambig = dynamic_cast<AmbiguousID*>(existing.GetNode());
-			if(ambig)
-				ambig->AddModule(other->GetName());
-		}
-	}
-}
-
-vector<string> Module::GetImports()
-{
-	return program->imports;
-}
-
-vector<string> Module::GetImportsDefining(const string& id)
-{
-	vector<string> result;
-	for(vector<string>::const_iterator it = program->imports.begin();
-		it != program->imports.end(); ++it)
-	{
-		Module* mod = parent->GetModule(*it);
-		if(!mod) continue;
-
-		if(mod->roottable->Get(id) != Value::Undefined ||
-			mod->roottable->GetAnchor(id) != NULL)
-			result.push_back(*it);
-	}
-	return result;
-}
-
-
-
-
-
-/*
- * Prints the parse tree of the program
- */
-void Module::PrintAST() const
-{
-	if(!program) return;
-	printf("Parse tree of %s\n", this->filename.c_str());
-	printf("=============================================\n");
-	printf("%s\n", program->ToString().c_str());
-}
-
-/*
- * Prints identifiers and commands defined at the global scope of the module
- */
-void Module::PrintRootTable() const
-{
-	if(!roottable) return;
-	printf("Root table -- %s\n", this->filename.c_str());
-	printf("=============================================\n");
-	printf("%s\n", roottable->ToString().c_str());
-}
-
-/*
- * Prints a table of defined labels, including addresses
- */
-void Module::PrintJumps() const
-{
-	if(!roottable)	return;
-	printf("Jump table -- '%s'\n", this->filename.c_str());
-	printf("=============================================\n");
-	printf("%s\n", roottable->JumpsTable().c_str());
-
-	// TEMP: also print in-code anchors
-
-}
-
-/*
- * Prints compiled binary code
- */
-void Module::PrintCode() const
-{
-	if(failed) return;
-	printf("Compiled code -- '%s'\n", this->filename.c_str());
-	printf("=============================================\n");
-	printf("%s", code->ToString().c_str());
-	printf("\n");
-}
-
-Module* Module::GetSiblingContext(const string& name) const
-{
-	return parent->GetModule(name);
-}
-
-
-/*
- * Registers a label in this module
- */
-//void Module::RegisterLabel(Label* label)
-//{
-//	roottable->DefineLabel(label->GetName(), label);
-//}
-
-
-/*
- * Returns the compiled size of the module's code.
- * Only valid if the module has already been evaluated.
- */
-unsigned int Module::GetCodeSize() const
-{
-	return code->GetSize();
-}
-
-
-/*
- * Sets the base virtual address of the module's code.
- */
-void Module::SetBaseAddress(unsigned int addr)
-{
-	baseaddress = addr;
-	roottable->AddBaseAddress(addr);
-	// TODO: the jump table should probably be factored out of symboltable, I think.
-	// (Or maybe not? Labels are symbols, after all, so it makes sense on that level
-	//  to put them in a symbol table. The main concern is that currently, labels are
-	//  always global symbols, so we always register them in the root symbol table,
-	//  which exists at the module level.)
-
-	// Update all in-code anchors
-	code->SetBaseAddress(addr);
-}
-
-/*
- * Returns the base virtual address of the module's code.
- */
-unsigned int Module::GetBaseAddress() const
-{
-	return baseaddress;
-}
-
-/*
- * Resolves references by replacing label target placeholders with the final
- * location of the label. Only valid after evaluation.
- */
-void Module::ResolveReferences()
-{
-	code->ResolveReferences();
-}
-
-/*
- * Registers a delayed ROM write
- */
-void Module::RegisterRomWrite(RomAccess *w)
-{
-	parent->RegisterDelayedWrite(w);
-}
-
-/*
- * Writes the modules code to the specified buffer.
- */
-void Module::WriteCode(char* buffer, int location, int bufsize) const
-{
-	if(!code->WriteChunk(buffer, location, bufsize))
-		throw Exception("attempt to write past end of ROM");
-}
-
+/* definition for module class */
+
+#include "module.h"
+
+#include <algorithm>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <map>
+#include <cctype>
+
+#include "compiler.h"
+#include "ast.h"
+#include "anchor.h"
+#include "astcache.h"
+#include "lexer.h"
+#include "parser.h"
+#include "symboltable.h"
+#include "bytechunk.h"
+#include "exception.h"
+#include "checksum.h"
+
+using namespace std;
+
+void Module::Error(const string& msg, int line, int col)
+{
+	stringstream ss;
+	ss << filename << ", line " << line << ": " << msg;
+	parent->Error(ss.str());
+	failed = true;
+}
+
+void Module::Warning(const string& msg, int line, int col)
+{
+	warned = true;
+	stringstream ss;
+	ss << filename << ", line " << line << ": warning: " << msg;
+	parent->Warning(ss.str());
+}
+
+
+/*
+ * Constructs a code module from the given source file
+ */
+Module::Module(const string& filename, Compiler* parent)
+{
+	this->parent = parent;
+	this->failed = false;
+	this->roottable = new SymbolTable();
+	this->warned = false;
+	this->fragments.assign(1, 0);
+	Load(filename);
+}
+
+Module::Module(const string& filename, Compiler* parent, SymbolTable* root)
+{
+	this->parent = parent;
+	this->failed = false;
+	this->roottable = root;
+	this->warned = false;
+	this->fragments.assign(1, 0);
+	Load(filename);
+}
+
+/*
+ * Loads and parses a module from a given source filename.
+ * Once loaded, the module should be ready for evaluation if Failed() is false.
+ */
+void Module::Load(const string& filename)
+{
+	this->filename = filename;
+	this->modulename = NameFromFilename(filename);
+	// Check module name for validity
+	if(!CheckName(modulename)) {
+		parent->Error("module name '" + modulename + "' invalid. Module names can only contain alphanumeric characters and underscores.");
+		failed = true;
+		return;
+	}
+	// Reading and parsing the source, or loading it from a cache instead, is
+	// all timed as parsing
+	TimeReport::Timer parsetimer(parent->timing, "parse", modulename);
+
+	ifstream in(filename.c_str());
+
+	if(in.fail())
+	{
+		parent->Error("couldn't open " + filename);
+		failed = true;
+		return;
+	}
+
+	stringbuf sb;
+	in >> std::noskipws >> &sb;
+	program = NULL;
+
+	string source = sb.str();
+	sourcekey = ASTCache::Hash(source);
+
+	// Unchanged sources can be loaded straight from a precompiled image
+	// installed next to them, or from the AST cache. Images are only
+	// installed in the library directory, so only modules there are
+	// looked for.
+	if(parent->IsLibraryFile(filename))
+		this->program = ASTCache::LoadFile(ASTCache::ImagePath(filename), sourcekey, this);
+
+	if(!program && !parent->cachedir.empty())
+		this->program = ASTCache::Load(parent->cachedir, source, this);
+
+	if(!program) {
+		// Parse the module
+		Parser parser(source);
+		parser.SetErrorHandler(this);
+		this->program = parser.Parse();
+		if(failed) return;
+
+		// Only cache clean parses, so that warnings aren't lost on later builds
+		if(!parent->cachedir.empty() && !warned)
+			ASTCache::Store(parent->cachedir, source, program);
+	}
+
+	// After parsing, we know if the module includes any others
+
+
+	// Counters are assigned during typechecking, so the module's results
+	// depend on the counter state as well as its source
+	string counters = CountExpr::GetCounterState();
+	statekey = Fnv1a64(counters.data(), counters.size(), sourcekey);
+
+	parsetimer.Stop();
+
+	// Build root table
+	{
+		TimeReport::Timer timer(parent->timing, "pretypecheck", modulename);
+		program->PreTypecheck(roottable, true);
+	}
+	if(failed) return;
+
+	importtable = new SymbolTable();
+	roottable->SetParent(importtable);
+
+	code = new ByteChunk();
+
+	labelbase = 0;
+}
+
+/*
+ * Produces a name string from a filename
+ */
+string Module::NameFromFilename(const string& filename)
+{
+	// Get just the part of the filename between the last directory separator and the first period
+	size_t p1 = filename.find_last_of("/\\");
+	if(p1 == string::npos)
+		p1 = 0;
+	else
+		p1++;
+
+	size_t p2 = filename.find('.', p1);
+	if(p2 == string::npos)
+		p2 = filename.length();
+
+	return filename.substr(p1, p2-p1);
+}
+
+/*
+ * Verifies that a string is a valid module name
+ */
+bool Module::CheckName(const string& name)
+{
+	// String must contain only alphanumeric characters and _
+	// Also, cannot start with a number
+	if(isdigit(name[0])) return false;
+	for(unsigned int i = 0; i < name.length(); ++i) {
+		if(!isalnum(name[i]) && name[i] != '_')
+			return false;
+	}
+	return true;
+}
+
+
+/*
+ * Returns the module's name.
+ */
+string Module::GetName() const
+{
+	return modulename;
+}
+
+
+/*
+ * Returns the module's filename
+ */
+string Module::GetFileName() const
+{
+	return filename;
+}
+
+
+/*
+ * Evaluates the program
+ */
+void Module::Execute()
+{
+	if(failed) {
+		parent->Error("There were compilation errors. Cannot execute module.");
+		return;
+	}
+	EvalContext context;
+	context.module = this;
+	context.compiler = this->parent;
+	context.labels = this->GetRootTable();
+	context.output = this->GetCodeChunk();
+	context.stack = parent->profiler.GetStack();
+
+	ScriptCall call(context.stack, this, NULL, 0);
+	program->Run(roottable, context);
+}
+
+/*
+ * Returns true iff parsing or evaluation of the module failed.
+ */
+bool Module::Failed() const
+{
+	return failed;
+}
+
+bool Module::Warned() const
+{
+	return warned;
+}
+
+
+SymbolTable* Module::GetRootTable() const
+{
+	return roottable;
+}
+
+/*
+ * Assigns the "library" table, a "fallback" root scope
+ * intended to contain standard library identifiers
+ */
+void Module::SetLibTable(SymbolTable *lib)
+{
+	roottable->SetParent(lib);
+}
+
+void Module::AddImport(const string& name)
+{
+	vector<string>::const_iterator it =
+		find(program->imports.begin(), program->imports.end(), name);
+	if(it == program->imports.end())
+		program->imports.insert(program->imports.begin(), name);
+}
+
+bool Module::Include(Module* other)
+{
+	// Each module has an "inclusion" symbol table above its root table.
+	// Rather than copying every imported symbol into it, the imported
+	// modules' root tables are attached to it as read-only views, which
+	// are searched in import order. Root tables don't change after the
+	// initial typecheck, so they can safely be shared by every importer.
+
+	// Identifiers defined by more than one import are ambiguous, and are
+	// shadowed by markers defined in the inclusion table itself; these are
+	// found by the compiler once all imports are known (see DefineAmbiguous).
+
+	if(other == this || find(includes.begin(), includes.end(), other) != includes.end())
+		return false;
+
+	includes.push_back(other);
+	importtable->AddView( other->GetRootTable() );
+	return true;
+}
+
+/*
+ * Marks an identifier as ambiguous within this module's scope. Any
+ * unqualified use of it will produce an error naming the candidates.
+ */
+void Module::DefineAmbiguous(const string& id, const vector<Module*>& defining)
+{
+	AmbiguousID* ambig = new AmbiguousID(id, this);
+
+	for(vector<Module*>::const_iterator it = defining.begin();
+		it != defining.end(); ++it)
+	{
+		ambig->AddModule((*it)->GetName());
+	}
+
+	importtable->Define(id, Value(ambig));
+}
+
+/*
+ * Writes a precompiled image of the module's parse tree next to its
+ * source file. Returns false on failure.
+ */
+bool Module::WriteImage() const
+{
+	if(failed || !program)
+		return false;
+	return ASTCache::StoreFile(ASTCache::ImagePath(filename), sourcekey, program);
+}
+
+vector<string> Module::GetImports()
+{
+	return program->imports;
+}
+
+const vector<Module*>& Module::GetIncludes() const
+{
+	return includes;
+}
+
+/*
+ * Prints the parse tree of the program
+ */
+void Module::PrintAST() const
+{
+	if(!program) return;
+	printf("Parse tree of %s\n", this->filename.c_str());
+	printf("=============================================\n");
+	printf("%s\n", program->ToString().c_str());
+}
+
+/*
+ * Prints identifiers and commands defined at the global scope of the module
+ */
+void Module::PrintRootTable() const
+{
+	if(!roottable) return;
+	printf("Root table -- %s\n", this->filename.c_str());
+	printf("=============================================\n");
+	printf("%s\n", roottable->ToString().c_str());
+}
+
+/*
+ * Prints a table of defined labels, including addresses
+ */
+void Module::PrintJumps() const
+{
+	if(!roottable)	return;
+	printf("Jump table -- '%s'\n", this->filename.c_str());
+	printf("=============================================\n");
+	printf("%s\n", roottable->JumpsTable().c_str());
+
+	// TEMP: also print in-code anchors
+
+}
+
+/*
+ * Prints compiled binary code
+ */
+void Module::PrintCode() const
+{
+	if(failed) return;
+	printf("Compiled code -- '%s'\n", this->filename.c_str());
+	printf("=============================================\n");
+	printf("%s", code->ToString().c_str());
+	printf("\n");
+}
+
+Module* Module::GetSiblingContext(const string& name) const
+{
+	return parent->GetModule(name);
+}
+
+void Module::AddSiblingRef(const string& name)
+{
+	siblingrefs.insert(name);
+}
+
+const set<string>& Module::GetSiblingRefs() const
+{
+	return siblingrefs;
+}
+
+
+/*
+ * Registers a label in this module
+ */
+//void Module::RegisterLabel(Label* label)
+//{
+//	roottable->DefineLabel(label->GetName(), label);
+//}
+
+
+/*
+ * Returns the compiled size of the module's code.
+ * Only valid if the module has already been evaluated.
+ */
+unsigned int Module::GetCodeSize() const
+{
+	return code->GetSize();
+}
+
+
+/*
+ * Sets the base virtual address of the module's code.
+ */
+void Module::SetBaseAddress(unsigned int addr)
+{
+	baseaddress = addr;
+	roottable->AddBaseAddress(addr);
+	// TODO: the jump table should probably be factored out of symboltable, I think.
+	// (Or maybe not? Labels are symbols, after all, so it makes sense on that level
+	//  to put them in a symbol table. The main concern is that currently, labels are
+	//  always global symbols, so we always register them in the root symbol table,
+	//  which exists at the module level.)
+
+	// Update all in-code anchors
+	code->SetBaseAddress(addr);
+}
+
+/*
+ * Divides the module's code into fragments for placement. If 'atlabels'
+ * is set, the code is split at every top-level label; otherwise it is
+ * left in one piece. Returns false if any fragment, with its jump to the
+ * next, is too big to fit in a bank.
+ */
+bool Module::Split(bool atlabels)
+{
+	fragments.assign(1, 0);
+	fragmentaddresses.clear();
+
+	if(atlabels)
+	{
+		// Only named labels are split at; internal labels may point into
+		// the middle of a construct that has to stay in one piece
+		set<Anchor*> labels;
+		const map<string, Anchor*>& jumps = roottable->GetJumpTable();
+		for(map<string, Anchor*>::const_iterator it = jumps.begin(); it != jumps.end(); ++it) {
+			if(!it->first.empty() && isalpha(it->first.at(0)))
+				labels.insert(it->second);
+		}
+
+		set<unsigned int> cuts;
+		vector<Anchor*> anchors = code->GetAnchors();
+		for(vector<Anchor*>::const_iterator it = anchors.begin(); it != anchors.end(); ++it) {
+			int p = (*it)->GetPosition();
+			if(labels.count(*it) && p > 0 && p < (int)code->GetSize())
+				cuts.insert(p);
+		}
+		fragments.insert(fragments.end(), cuts.begin(), cuts.end());
+	}
+
+	for(unsigned int i = 0; i < fragments.size(); ++i) {
+		unsigned int size = GetFragmentSize(i);
+		if(i + 1 < fragments.size())
+			size += JumpSize;
+		if(size > 0x10000)
+			return false;
+	}
+	return true;
+}
+
+unsigned int Module::GetFragmentCount() const
+{
+	return fragments.size();
+}
+
+unsigned int Module::GetFragmentSize(unsigned int i) const
+{
+	unsigned int end = (i + 1 < fragments.size()) ? fragments[i + 1] : code->GetSize();
+	return end - fragments[i];
+}
+
+/*
+ * Places the module's fragments. Anchors are placed relative to the
+ * fragment they fall in; an anchor at the very end of the code belongs
+ * to the last fragment.
+ */
+void Module::SetFragmentAddresses(const vector<unsigned int>& addrs)
+{
+	SetBaseAddress(addrs[0]);
+	fragmentaddresses = addrs;
+
+	for(unsigned int i = 1; i < fragments.size(); ++i) {
+		unsigned int end = (i + 1 < fragments.size()) ? fragments[i + 1] : code->GetSize() + 1;
+		code->SetRangeAddress(fragments[i], end, addrs[i]);
+	}
+}
+
+unsigned int Module::GetFragmentAddress(unsigned int i) const
+{
+	if(fragmentaddresses.empty())
+		return baseaddress;
+	return fragmentaddresses[i];
+}
+
+unsigned int Module::GetFragmentExtent(unsigned int i) const
+{
+	unsigned int size = GetFragmentSize(i);
+	if(i + 1 < fragments.size() && GetFragmentAddress(i + 1) != GetFragmentAddress(i) + size)
+		size += JumpSize;
+	return size;
+}
+
+/*
+ * Writes a fragment of the module's code to the specified buffer, followed
+ * by a jump to the next fragment if it doesn't follow on directly.
+ */
+void Module::WriteFragments(char* buffer, int bufsize, const vector<int>& locations) const
+{
+	bool written;
+	try {
+		written = code->WriteResolved(buffer, bufsize, fragments, locations);
+	}
+	catch(Exception& e) {
+		throw Exception("module '" + GetName() + "': " + e.GetMessage());
+	}
+	if(!written)
+		throw Exception("attempt to write past end of ROM");
+
+	for(unsigned int i = 0; i + 1 < fragments.size(); ++i)
+	{
+		unsigned int size = GetFragmentSize(i);
+		if(GetFragmentExtent(i) == size)
+			continue;
+
+		ByteChunk jump;
+		jump.Byte(0x0A);
+		jump.Long(GetFragmentAddress(i + 1));
+		if(!jump.WriteChunk(buffer, locations[i] + size, bufsize))
+			throw Exception("attempt to write past end of ROM");
+	}
+}
+
+/*
+ * Returns the base virtual address of the module's code.
+ */
+unsigned int Module::GetBaseAddress() const
+{
+	return baseaddress;
+}
+
+/*
+ * Resolves references by replacing label target placeholders with the final
+ * location of the label. Only valid after evaluation.
+ */
+void Module::ResolveReferences()
+{
+	code->ResolveReferences();
+}
+
+/*
+ * Registers a delayed ROM write
+ */
+void Module::RegisterRomWrite(RomAccess *w)
+{
+	parent->RegisterDelayedWrite(w, this);
+}
+
+/*
+ * Copies a command's expansion with an external anchor at each end, so
+ * that where it ends up in the code can be found once evaluation is over.
+ */
+ByteChunk* Module::MarkExpansion(const string& command, const ByteChunk& code)
+{
+	if(parent->outline == 0 || code.GetSize() < parent->outline)
+		return NULL;
+	ByteChunk* marked = new ByteChunk(code);
+
+	Expansion e;
+	e.command = command;
+	e.start = new Anchor(command + ".start");
+	e.end = new Anchor(command + ".end");
+	e.start->SetExternal(true);
+	e.end->SetExternal(true);
+	marked->AddAnchor(0, e.start);
+	marked->AddAnchor(code.GetSize(), e.end);
+
+	expansions.push_back(e);
+	return marked;
+}
+
+const vector<Module::Expansion>& Module::GetExpansions() const
+{
+	return expansions;
+}
+
+/*
+ * Installs the output of a previous evaluation of the module, as saved
+ * in the build state, instead of evaluating it again.
+ */
+void Module::RestoreOutput(ByteChunk* code, const vector<RomAccess*>& writes, const set<string>& siblings)
+{
+	delete this->code;
+	this->code = code;
+
+	for(vector<RomAccess*>::const_iterator it = writes.begin(); it != writes.end(); ++it)
+		RegisterRomWrite(*it);
+
+	siblingrefs = siblings;
+}
+
+/*
+ * Writes the modules code to the specified buffer.
+ */
+void Module::WriteCode(char* buffer, int location, int bufsize) const
+{
+	if(!code->WriteChunk(buffer, location, bufsize))
+		throw Exception("attempt to write past end of ROM");
+}
+
@@ -1,101 +1,169 @@
-/* module class */
-#pragma once
-
-#include <string>
-#include <sstream>
-#include <vector>
-#include "err.h"
-
-class Compiler;
-class Program;
-class SymbolTable;
-class ReferenceTable;
-class ByteChunk;
-class Label;
-class RomAccess;
-
-class Module : public ErrorReceiver
-{
-private:
-	std::string filename;
-	std::string modulename;
-	Compiler* parent;
-	Program* program;
-	SymbolTable* roottable;
-	SymbolTable* importtable;
-	ByteChunk* code;
-
-	unsigned int baseaddress;
-
-	bool failed;
-
-	// Base number for unique internal labels
-	unsigned int labelbase;
-
-public:
-	Module(const std::string& filename, Compiler* owner);
-	Module(const std::string& filename, Compiler* owner, SymbolTable* root);
-
-	std::string GetName() const;			// Returns the name of the module
-	std::string GetFileName() const;		// Returns the filename of the module
-
-	bool Failed() const;					// Returns true if compilation or evaluation of the module failed
-
-	// DEPRECATED
-	void SetLibTable(SymbolTable* lib);		// Assigns a parent to the root table for standard library symbols.
-											// Yes, this makes the root table not really the "root" table -_-;
-	void AddImport(const std::string&);		// 
-	void Include(Module* other);			// Includes symbols from other module into this module's scope.
-	std::vector<std::string>
-		GetImports();						// Returns a vector of imports used by this module
-
-	void Execute();							// Evaluates the module, collecting output in module's bytechunk
-	void PrintAST() const;					// Prints the abstract syntax tree of the parsed code
-	void PrintJumps() const;				// Prints labels defined in this module, with their addresses
-	void PrintRootTable() const;			// Prints the root table of the module
-	void PrintCode() const;					// Prints the binary code of the module
-
-	SymbolTable* GetRootTable() const;		// Returns the root table of the module
-
-
-	Module* GetSiblingContext				// Returns a sibling module
-			(const std::string& name) const;
-
-
-	// Label resolution methods
-	//void RegisterLabel(Label* lbl);			// Registers a label in this module
-	void SetBaseAddress(unsigned int addr);	// Sets the base address of the module for reference resolution
-	unsigned int GetBaseAddress() const;	// Returns the base address of the module
-	void ResolveReferences();				// Resolves all registered references
-
-	// Returns a label name that is unique within this context, for use by internal lowering operations
-	std::string GetUniqueLabelName() {
-		std::stringstream ss;
-		ss << labelbase++;
-		return ss.str();
-	}
-
-
-	// Code manipulation stuff
-	ByteChunk* GetCodeChunk() const { return code; }
-	unsigned int GetCodeSize() const;
-	void WriteCode(char* buffer, int location, int bufsize) const;
-
-	// Registers a statement that will write some expression to an arbitrary
-	// location within the output file after everything has been linked
-	void RegisterRomWrite(RomAccess* w);
-
-	// Implementation of ErrorReceiver
-	void Error(const std::string&,int,int);
-	void Warning(const std::string&,int,int);
-
-
-	static bool CheckName(const std::string& name);
-	static std::string NameFromFilename(const std::string& filename);
-
-private:
-	void Load(const std::string& filename);
-
-	std::vector<std::string> GetImportsDefining(const std::string& id);
-};
-
+/* module class */
+#pragma once
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <set>
+#include "err.h"
+
+class Compiler;
+class Program;
+class SymbolTable;
+class ReferenceTable;
+class ByteChunk;
+class Label;
+class RomAccess;
+class Anchor;
+
+class Module : public ErrorReceiver
+{
+private:
+	std::string filename;
+	std::string modulename;
+	Compiler* parent;
+	Program* program;
+	SymbolTable* roottable;
+	SymbolTable* importtable;	// ambiguity markers, with views of the imported root tables
+	std::vector<Module*> includes;
+	ByteChunk* code;
+
+	unsigned int baseaddress;
+
+	std::vector<unsigned int> fragments;			// offsets at which the code is split for placement
+	std::vector<unsigned int> fragmentaddresses;	// virtual address of each fragment
+
+	bool failed;
+	bool warned;	// set when any warning is reported against the module
+
+	unsigned long long sourcekey;	// AST cache key of the module's source
+	unsigned long long statekey;	// identifies the source and the counter state it was typechecked in
+
+	std::set<std::string> siblingrefs;		// modules referred to by qualified names during evaluation
+
+public:
+	// A command expansion that may be outlined into a subroutine; it's
+	// delimited by two anchors in the code (see Outliner)
+	struct Expansion {
+		std::string command;
+		Anchor* start;
+		Anchor* end;
+	};
+
+private:
+	std::vector<Expansion> expansions;		// command expansions marked during evaluation
+
+	// Base number for unique internal labels
+	unsigned int labelbase;
+
+public:
+	Module(const std::string& filename, Compiler* owner);
+	Module(const std::string& filename, Compiler* owner, SymbolTable* root);
+
+	std::string GetName() const;			// Returns the name of the module
+	std::string GetFileName() const;		// Returns the filename of the module
+
+	bool Failed() const;					// Returns true if compilation or evaluation of the module failed
+	bool Warned() const;					// Returns true if any warnings were reported against the module
+
+	// DEPRECATED
+	void SetLibTable(SymbolTable* lib);		// Assigns a parent to the root table for standard library symbols.
+											// Yes, this makes the root table not really the "root" table -_-;
+	void AddImport(const std::string&);		// 
+	bool Include(Module* other);			// Includes symbols from other module into this module's scope.
+											// Returns false if the module was already included.
+	void DefineAmbiguous					// Marks an identifier defined by more than one
+			(const std::string& id,			// included module as ambiguous
+			 const std::vector<Module*>& defining);
+	std::vector<std::string>
+		GetImports();						// Returns a vector of imports used by this module
+	const std::vector<Module*>&
+		GetIncludes() const;				// Returns the modules included so far, in import order
+
+	void Execute();							// Evaluates the module, collecting output in module's bytechunk
+	void PrintAST() const;					// Prints the abstract syntax tree of the parsed code
+	void PrintJumps() const;				// Prints labels defined in this module, with their addresses
+	void PrintRootTable() const;			// Prints the root table of the module
+	void PrintCode() const;					// Prints the binary code of the module
+	bool WriteImage() const;				// Writes a precompiled AST image next to the source
+
+	SymbolTable* GetRootTable() const;		// Returns the root table of the module
+
+
+	Module* GetSiblingContext				// Returns a sibling module
+			(const std::string& name) const;
+	void AddSiblingRef						// Records that evaluation referred to a sibling module
+			(const std::string& name);
+	const std::set<std::string>&
+		GetSiblingRefs() const;				// Returns the sibling modules referred to during evaluation
+
+	// Incremental build support
+	unsigned long long GetStateKey() const { return statekey; }
+	void RestoreOutput						// Installs output saved by a previous build in place of
+			(ByteChunk* code,				// evaluating the module
+			 const std::vector<RomAccess*>& writes,
+			 const std::set<std::string>& siblings);
+
+
+	// Label resolution methods
+	//void RegisterLabel(Label* lbl);			// Registers a label in this module
+	void SetBaseAddress(unsigned int addr);	// Sets the base address of the module for reference resolution
+	unsigned int GetBaseAddress() const;	// Returns the base address of the module
+	void ResolveReferences();				// Resolves all registered references
+
+	// Returns a label name that is unique within this context, for use by internal lowering operations
+	std::string GetUniqueLabelName() {
+		std::stringstream ss;
+		ss << labelbase++;
+		return ss.str();
+	}
+
+
+	// Code manipulation stuff
+	ByteChunk* GetCodeChunk() const { return code; }
+	unsigned int GetCodeSize() const;
+	void WriteCode(char* buffer, int location, int bufsize) const;
+
+	// Fragment placement. A module's code is normally placed in one piece,
+	// but it may instead be split at its labels into fragments that are
+	// placed independently. A fragment that isn't placed right before the
+	// next one ends with a jump to it, which takes JumpSize bytes.
+	static const unsigned int JumpSize = 5;
+
+	bool Split(bool atlabels);				// Splits the code at top-level labels, or joins it back into one
+											// fragment. Returns false if a fragment won't fit in a bank.
+	unsigned int GetFragmentCount() const;
+	unsigned int GetFragmentSize				// Returns the size of a fragment's code, without any jump
+			(unsigned int i) const;
+	void SetFragmentAddresses				// Places each fragment at the given virtual address, and sets
+			(const std::vector<unsigned int>& addrs);	// the base address to that of the first
+	unsigned int GetFragmentAddress(unsigned int i) const;
+	unsigned int GetFragmentExtent			// Returns the size of a placed fragment, including any jump
+			(unsigned int i) const;
+	void WriteFragments						// Writes the placed fragments, at the given locations in
+			(char* buffer, int bufsize,			// the buffer, with their references resolved and the
+			const std::vector<int>& locations) const;	// jumps between them
+
+	// Registers a statement that will write some expression to an arbitrary
+	// location within the output file after everything has been linked
+	void RegisterRomWrite(RomAccess* w);
+
+	// Marks a command's expansion as a candidate for outlining, if it's at
+	// least as large as the compiler's outlining threshold. Returns a marked
+	// copy to output in its place, or NULL if the expansion isn't marked.
+	ByteChunk* MarkExpansion(const std::string& command, const ByteChunk& code);
+	const std::vector<Expansion>&
+		GetExpansions() const;				// Returns the expansions marked during evaluation
+
+	// Implementation of ErrorReceiver
+	void Error(const std::string&,int,int);
+	void Warning(const std::string&,int,int);
+
+
+	static bool CheckName(const std::string& name);
+	static std::string NameFromFilename(const std::string& filename);
+
+private:
+	void Load(const std::string& filename);
+};
+
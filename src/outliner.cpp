@@ -0,0 +1,411 @@
+/* outliner implementation */
+
+#include "outliner.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "anchor.h"
+#include "bytechunk.h"
+#include "checksum.h"
+#include "module.h"
+
+using namespace std;
+
+
+/*
+ * A marked expansion, as found in a module's code
+ */
+struct Outliner::Site {
+	unsigned int module;
+	unsigned int start;
+	unsigned int end;
+	std::string command;
+	vector<unsigned int> refs;		// references inside, by position
+};
+
+/*
+ * What's needed to tell if an expansion in a chunk is self-contained
+ */
+struct Outliner::Index {
+	set<Anchor*> local;							// anchors placed in the chunk
+	vector<unsigned int> reach;					// furthest end of the references starting at or before each position
+	vector<pair<int, int> > targets;			// (target position, first byte) of references to local anchors
+	vector<int> labels;							// positions of external anchors
+};
+
+/*
+ * Expansions that came out the same
+ */
+struct Outliner::Group {
+	vector<unsigned int> sites;
+};
+
+
+static bool SavesMore(const pair<unsigned int, unsigned int>& a, const pair<unsigned int, unsigned int>& b)
+{
+	return a.first > b.first;
+}
+
+vector<Outliner::Result> Outliner::Outline(const vector<Module*>& modules)
+{
+	vector<Site> sites;
+	for(unsigned int i = 0; i < modules.size(); ++i)
+		FindSites(i, modules[i], sites);
+
+	// Group the expansions that are the same
+	vector<Group> groups;
+	unordered_map<unsigned long long, vector<unsigned int> > byhash;
+	for(unsigned int i = 0; i < sites.size(); ++i)
+	{
+		const Site& site = sites[i];
+		const ByteChunk& chunk = *modules[site.module]->GetCodeChunk();
+
+		vector<unsigned int>& candidates = byhash[Hash(chunk, site)];
+		vector<unsigned int>::const_iterator g = candidates.begin();
+		for(; g != candidates.end(); ++g) {
+			const Site& first = sites[groups[*g].sites.front()];
+			if(Same(chunk, site, *modules[first.module]->GetCodeChunk(), first))
+				break;
+		}
+
+		if(g != candidates.end())
+			groups[*g].sites.push_back(i);
+		else {
+			candidates.push_back(groups.size());
+			groups.push_back(Group());
+			groups.back().sites.push_back(i);
+		}
+	}
+
+	// Take the groups that save the most first. An expansion that overlaps
+	// one already taken -- because one command expanded inside another --
+	// is left where it is.
+	vector<pair<unsigned int, unsigned int> > order;	// (bytes saved, group)
+	for(unsigned int i = 0; i < groups.size(); ++i) {
+		Result r;
+		r.size = sites[groups[i].sites.front()].end - sites[groups[i].sites.front()].start;
+		r.calls = groups[i].sites.size();
+		if(r.calls >= 2 && r.calls * r.size > r.calls * CallSize + r.size + 1)
+			order.push_back(make_pair(r.Saved(), i));
+	}
+	std::stable_sort(order.begin(), order.end(), SavesMore);
+
+	vector<map<unsigned int, unsigned int> > taken(modules.size());	// start -> end
+	vector<Result> results;
+	vector<vector<unsigned int> > outlined;		// sites taken for each result
+
+	for(unsigned int i = 0; i < order.size(); ++i)
+	{
+		const Group& group = groups[order[i].second];
+
+		vector<unsigned int> free;
+		for(unsigned int j = 0; j < group.sites.size(); ++j) {
+			const Site& site = sites[group.sites[j]];
+			const map<unsigned int, unsigned int>& t = taken[site.module];
+			map<unsigned int, unsigned int>::const_iterator it = t.lower_bound(site.end);
+			if(it == t.begin() || (--it)->second <= site.start)
+				free.push_back(group.sites[j]);
+		}
+
+		Result r;
+		r.command = sites[free.empty() ? group.sites.front() : free.front()].command;
+		r.size = sites[group.sites.front()].end - sites[group.sites.front()].start;
+		r.calls = free.size();
+		if(r.calls < 2 || r.calls * r.size <= r.calls * CallSize + r.size + 1)
+			continue;
+
+		for(unsigned int j = 0; j < free.size(); ++j) {
+			const Site& site = sites[free[j]];
+			taken[site.module][site.start] = site.end;
+		}
+		results.push_back(r);
+		outlined.push_back(free);
+	}
+
+	if(results.empty())
+		return results;
+
+	// Make the subroutines, before the code they're copied from is replaced
+	vector<ByteChunk> subroutines(results.size());
+	vector<Anchor*> entries(results.size());
+	for(unsigned int i = 0; i < results.size(); ++i)
+	{
+		const Site& site = sites[outlined[i].front()];
+		const ByteChunk& chunk = *modules[site.module]->GetCodeChunk();
+		ByteChunk& sub = subroutines[i];
+
+		for(unsigned int p = site.start; p < site.end; ++p)
+			sub.Byte(chunk.bytes[p], chunk.cinfo[p]);
+		sub.Byte(0x02);
+
+		// Everything inside refers to something inside, or to the end,
+		// which is now the [02] that returns
+		map<int, Anchor*> anchors;
+		for(unsigned int j = 0; j < site.refs.size(); ++j)
+		{
+			ByteChunk::Reference r = chunk.refs[site.refs[j]];
+			int target = r.target->GetPosition() - site.start;
+			Anchor*& a = anchors[target];
+			if(!a) {
+				a = new Anchor("<outlined>");
+				sub.AddAnchor(target, a);
+			}
+			r.location -= site.start;
+			r.target = a;
+			sub.refs.push_back(r);
+		}
+
+		entries[i] = new Anchor(site.command + ".outlined");
+	}
+
+	// Replace the expansions with calls
+	vector<vector<pair<ByteChunk::Range, Anchor*> > > calls(modules.size());
+	for(unsigned int i = 0; i < results.size(); ++i) {
+		for(unsigned int j = 0; j < outlined[i].size(); ++j) {
+			const Site& site = sites[outlined[i][j]];
+			calls[site.module].push_back(make_pair(ByteChunk::Range(site.start, site.end), entries[i]));
+		}
+	}
+
+	for(unsigned int m = 0; m < modules.size(); ++m)
+	{
+		if(calls[m].empty())
+			continue;
+		ByteChunk& chunk = *modules[m]->GetCodeChunk();
+		std::sort(calls[m].begin(), calls[m].end());
+
+		vector<ByteChunk::Range> ranges;
+		vector<Anchor*> targets;
+		for(unsigned int i = 0; i < calls[m].size(); ++i) {
+			ranges.push_back(calls[m][i].first);
+			targets.push_back(calls[m][i].second);
+		}
+
+		// Nothing outside an expansion refers to the anchors inside it
+		vector<Anchor*> kept;
+		for(vector<Anchor*>::const_iterator it = chunk.anchors.begin(); it != chunk.anchors.end(); ++it) {
+			unsigned int p = (*it)->GetPosition();
+			vector<ByteChunk::Range>::const_iterator r =
+				upper_bound(ranges.begin(), ranges.end(), ByteChunk::Range(p, 0));
+			if(r == ranges.begin() || (r - 1)->second <= p)
+				kept.push_back(*it);
+		}
+		chunk.anchors.swap(kept);
+
+		chunk.ReplaceWithJumps(ranges, ByteChunk::Call, targets);
+	}
+
+	// And add each subroutine to the module it was first found in
+	for(unsigned int i = 0; i < results.size(); ++i) {
+		ByteChunk& chunk = *modules[sites[outlined[i].front()].module]->GetCodeChunk();
+		chunk.AddAnchor(entries[i]);
+		chunk.Append(subroutines[i]);
+	}
+
+	return results;
+}
+
+/*
+ * Finds the marked expansions in a module's code, and removes the marks
+ */
+void Outliner::FindSites(unsigned int module, Module* m, vector<Site>& sites)
+{
+	ByteChunk& chunk = *m->GetCodeChunk();
+	const vector<Module::Expansion>& expansions = m->GetExpansions();
+	if(expansions.empty())
+		return;
+
+	// An expansion whose marks were copied more than once can't be told
+	// apart from its copies
+	map<Anchor*, unsigned int> marks;
+	for(vector<Module::Expansion>::const_iterator it = expansions.begin(); it != expansions.end(); ++it) {
+		marks[it->start] = 0;
+		marks[it->end] = 0;
+	}
+
+	vector<Anchor*> kept;
+	for(vector<Anchor*>::const_iterator it = chunk.anchors.begin(); it != chunk.anchors.end(); ++it) {
+		map<Anchor*, unsigned int>::iterator mark = marks.find(*it);
+		if(mark != marks.end())
+			mark->second++;
+		else
+			kept.push_back(*it);
+	}
+	chunk.anchors.swap(kept);
+
+	// References by the position of their first byte
+	Index index;
+	index.local.insert(chunk.anchors.begin(), chunk.anchors.end());
+	index.reach.assign(chunk.GetSize(), 0);
+
+	vector<pair<unsigned int, unsigned int> > refs;
+	for(unsigned int i = 0; i < chunk.refs.size(); ++i)
+	{
+		const ByteChunk::Reference& r = chunk.refs[i];
+		unsigned int first = r.location + r.offset;
+		refs.push_back(make_pair(first, i));
+		if(first < index.reach.size())
+			index.reach[first] = max(index.reach[first], first + r.length);
+		if(index.local.count(r.target))
+			index.targets.push_back(make_pair(r.target->GetPosition(), (int)first));
+	}
+	std::sort(refs.begin(), refs.end());
+	std::sort(index.targets.begin(), index.targets.end());
+	for(unsigned int p = 1; p < index.reach.size(); ++p)
+		index.reach[p] = max(index.reach[p], index.reach[p - 1]);
+
+	for(vector<Anchor*>::const_iterator it = chunk.anchors.begin(); it != chunk.anchors.end(); ++it) {
+		if((*it)->IsExternal())
+			index.labels.push_back((*it)->GetPosition());
+	}
+	std::sort(index.labels.begin(), index.labels.end());
+
+	for(vector<Module::Expansion>::const_iterator it = expansions.begin(); it != expansions.end(); ++it)
+	{
+		if(marks[it->start] != 1 || marks[it->end] != 1)
+			continue;
+
+		Site site;
+		site.module = module;
+		site.start = it->start->GetPosition();
+		site.end = it->end->GetPosition();
+		site.command = it->command;
+		if(site.start >= site.end || site.end > chunk.GetSize())
+			continue;
+
+		vector<pair<unsigned int, unsigned int> >::const_iterator r =
+			lower_bound(refs.begin(), refs.end(), make_pair(site.start, 0u));
+		for(; r != refs.end() && r->first < site.end; ++r)
+			site.refs.push_back(r->second);
+
+		if(SelfContained(chunk, site, index))
+			sites.push_back(site);
+	}
+}
+
+/*
+ * Returns true if an expansion can be moved into a subroutine
+ */
+bool Outliner::SelfContained(const ByteChunk& chunk, const Site& site, const Index& index)
+{
+	const vector<unsigned char>& bytes = chunk.bytes;
+
+	// The references inside must lie wholly inside, and refer to places
+	// inside; a jump to the end becomes a return
+	map<unsigned int, int> jumps;		// opcode position -> length of the jump
+	for(unsigned int i = 0; i < site.refs.size(); ++i)
+	{
+		const ByteChunk::Reference& r = chunk.refs[site.refs[i]];
+		if(r.location + r.offset + r.length > (int)site.end)
+			return false;
+		if(!index.local.count(r.target) || r.target->GetPosition() < (int)site.start
+			|| r.target->GetPosition() > (int)site.end)
+			return false;
+
+		unsigned int opsize = (r.jump == ByteChunk::Goto || r.jump == ByteChunk::Call) ? 1 : 2;
+		if(r.jump != ByteChunk::NoJump && r.location >= (int)(site.start + opsize))
+			jumps[r.location - opsize] = opsize + 4;
+	}
+
+	// No reference may reach into it from before
+	if(site.start > 0 && index.reach[site.start - 1] > site.start)
+		return false;
+
+	// or refer to a place strictly inside it from outside
+	vector<pair<int, int> >::const_iterator t = upper_bound(index.targets.begin(),
+		index.targets.end(), make_pair((int)site.start, INT_MAX));
+	for(; t != index.targets.end() && t->first < (int)site.end; ++t) {
+		if(t->second < (int)site.start || t->second >= (int)site.end)
+			return false;
+	}
+
+	// And no label inside can be reached by name
+	vector<int>::const_iterator label = upper_bound(index.labels.begin(), index.labels.end(), (int)site.start);
+	if(label != index.labels.end() && *label < (int)site.end)
+		return false;
+
+	// Look for anything that ends the text or jumps away, where a code is
+	// known to start
+	if(bytes[site.end - 1] == 0x02)
+		return false;
+
+	bool known = true;
+	for(unsigned int p = site.start; p < site.end; )
+	{
+		map<unsigned int, int>::const_iterator jump = jumps.find(p);
+		if(jump != jumps.end()) {
+			p += jump->second;
+			known = true;
+			continue;
+		}
+
+		if(chunk.cinfo[p]) {
+			++p;
+			known = true;
+			continue;
+		}
+
+		if(known) {
+			switch(bytes[p]) {
+				case 0x02: case 0x06: case 0x09: case 0x0A: case 0x1B:
+					return false;
+				case 0x1F:
+					if(p + 1 < site.end && bytes[p + 1] == 0xC0)
+						return false;
+					break;
+				case 0x00: case 0x01: case 0x03: case 0x12: case 0x13: case 0x14:
+					++p;
+					continue;
+			}
+		}
+		known = false;
+		++p;
+	}
+	return true;
+}
+
+/*
+ * Hashes an expansion's bytes and references, with references' locations
+ * and targets taken relative to its start
+ */
+unsigned long long Outliner::Hash(const ByteChunk& chunk, const Site& site)
+{
+	unsigned long long h = Fnv1a64(reinterpret_cast<const char*>(&chunk.bytes[site.start]),
+		site.end - site.start);
+	for(unsigned int i = 0; i < site.refs.size(); ++i) {
+		const ByteChunk::Reference& r = chunk.refs[site.refs[i]];
+		int fields[] = { r.location - (int)site.start, r.offset, r.length, r.jump,
+			r.target->GetPosition() - (int)site.start };
+		h = Fnv1a64(reinterpret_cast<const char*>(fields), sizeof(fields), h);
+	}
+	return h;
+}
+
+/*
+ * Returns true if two expansions are the same
+ */
+bool Outliner::Same(const ByteChunk& a, const Site& sa, const ByteChunk& b, const Site& sb)
+{
+	unsigned int len = sa.end - sa.start;
+	if(sb.end - sb.start != len || sa.refs.size() != sb.refs.size())
+		return false;
+	if(memcmp(&a.bytes[sa.start], &b.bytes[sb.start], len) != 0)
+		return false;
+
+	for(unsigned int i = 0; i < sa.refs.size(); ++i) {
+		const ByteChunk::Reference& x = a.refs[sa.refs[i]];
+		const ByteChunk::Reference& y = b.refs[sb.refs[i]];
+		if(x.location - (int)sa.start != y.location - (int)sb.start
+			|| x.offset != y.offset || x.length != y.length || x.jump != y.jump
+			|| x.target->GetPosition() - (int)sa.start != y.target->GetPosition() - (int)sb.start)
+			return false;
+	}
+	return true;
+}
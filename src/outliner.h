@@ -0,0 +1,53 @@
+/* outlining of repeated command expansions */
+#pragma once
+
+#include <string>
+#include <vector>
+
+class ByteChunk;
+class Module;
+
+// Every command call is expanded in place, so a large command that is
+// used many times is copied into the output many times. The outliner
+// finds expansions that came out the same -- byte for byte, with the same
+// references -- and, where it saves space, keeps one copy ending in [02]
+// as a subroutine and replaces every expansion with an [08] call to it.
+//
+// Expansions are marked during evaluation (see Module::MarkExpansion).
+// One is only outlined if it's self-contained: no label inside it can be
+// reached from outside, and it has no references to anything outside
+// itself, which rules out jumps out of it. It's also passed over if it
+// looks like it ends the text, since it would return from the call
+// instead: if it ends in [02], or has an [02] or a jump where a code is
+// known to start (after a text character, or at the start).
+//
+// Subroutines are added to the end of the code of the module where the
+// expansion was first found.
+class Outliner
+{
+public:
+	struct Result {
+		std::string command;	// command whose expansion was outlined
+		unsigned int size;		// size of the expansion
+		unsigned int calls;		// number of places it was replaced by a call
+
+		// Bytes saved: the expansions, less the calls and the subroutine
+		unsigned int Saved() const { return calls * size - calls * CallSize - size - 1; }
+	};
+
+	static const unsigned int CallSize = 5;		// [08 xx xx xx xx]
+
+	// Outlines the repeated expansions in the given modules' code, and
+	// removes the marks from every expansion
+	static std::vector<Result> Outline(const std::vector<Module*>& modules);
+
+private:
+	struct Site;
+	struct Index;
+	struct Group;
+
+	static void FindSites(unsigned int module, Module* m, std::vector<Site>& sites);
+	static bool SelfContained(const ByteChunk& chunk, const Site& site, const Index& index);
+	static unsigned long long Hash(const ByteChunk& chunk, const Site& site);
+	static bool Same(const ByteChunk& a, const Site& sa, const ByteChunk& b, const Site& sb);
+};
@@ -0,0 +1,342 @@
+/* bank packing implementation */
+
+#include "packer.h"
+
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <set>
+
+using namespace std;
+
+
+bool BankPacker::MethodFromName(const string& name, Method& method)
+{
+	if(name == "greedy")
+		method = Greedy;
+	else if(name == "bfd")
+		method = BestFit;
+	else if(name == "exact")
+		method = Exact;
+	else
+		return false;
+	return true;
+}
+
+const char* BankPacker::MethodName(Method method)
+{
+	switch(method) {
+		case BestFit:	return "bfd";
+		case Exact:		return "exact";
+		default:		return "greedy";
+	}
+}
+
+
+BankPacker::BankPacker(const vector<unsigned int>& capacities)
+	: capacities(capacities), timedout(false), used(0), best(0), total(0), nodes(0), stop(false)
+{
+	unsigned int sum = 0;
+	for(unsigned int i = 0; i < capacities.size(); ++i) {
+		before.push_back(sum);
+		sum += capacities[i];
+	}
+}
+
+unsigned int BankPacker::LowerBound(unsigned int total) const
+{
+	unsigned int n = 0;
+	for(unsigned int room = 0; room < total && n < capacities.size(); ++n)
+		room += capacities[n];
+	return n;
+}
+
+
+/*
+ * Predicate for ordering items largest first
+ */
+struct SizeOrder {
+	const vector<unsigned int>* sizes;
+	bool operator()(unsigned int a, unsigned int b) const { return (*sizes)[a] > (*sizes)[b]; }
+};
+
+bool BankPacker::Pack(const vector<unsigned int>& sizes, Method method, unsigned int timelimit,
+	vector<vector<unsigned int> >& bins, unsigned int& unplaced)
+{
+	this->sizes = sizes;
+	timedout = false;
+
+	order.clear();
+	for(unsigned int i = 0; i < sizes.size(); ++i)
+		order.push_back(i);
+	SizeOrder pred = { &this->sizes };
+	std::sort(order.begin(), order.end(), pred);
+
+	bins.assign(capacities.size(), vector<unsigned int>());
+
+	if(method == Greedy)
+		return PackGreedy(bins, unplaced);
+
+	bool ok = PackBestFit(bins, unplaced);
+
+	if(method == Exact) {
+		if(!ok)
+			bins.assign(capacities.size(), vector<unsigned int>());
+
+		// The search can find a packing where best-fit didn't, unless there
+		// is none at all or it runs out of time first
+		ok = PackExact(bins, timelimit) || ok;
+	}
+
+	if(ok)
+		PutSmallestLast(bins);
+	return ok;
+}
+
+
+/*
+ * Fills one bank at a time, repeatedly taking the largest item that fits in
+ * the room left. Items are indexed by size, so each choice is a lookup
+ * rather than a scan.
+ */
+bool BankPacker::PackGreedy(vector<vector<unsigned int> >& bins, unsigned int& unplaced)
+{
+	// Items of equal size are kept in 'order', so ties are broken the same
+	// way a scan of the sorted items would break them
+	multimap<unsigned int, unsigned int> remaining;
+	for(unsigned int i = 0; i < order.size(); ++i)
+		remaining.insert(make_pair(sizes[order[i]], order[i]));
+
+	for(unsigned int bin = 0; !remaining.empty(); ++bin)
+	{
+		if(bin == capacities.size()) {
+			unplaced = remaining.lower_bound(remaining.rbegin()->first)->second;
+			return false;
+		}
+
+		unsigned int room = capacities[bin];
+		while(!remaining.empty())
+		{
+			multimap<unsigned int, unsigned int>::iterator it = remaining.upper_bound(room);
+			if(it == remaining.begin())
+				break;
+			it = remaining.lower_bound((--it)->first);
+
+			bins[bin].push_back(it->second);
+			room -= it->first;
+			remaining.erase(it);
+		}
+	}
+	return true;
+}
+
+/*
+ * Places items largest first, each into the open bank with the least room
+ * that will hold it, opening the next bank only when none will
+ */
+bool BankPacker::PackBestFit(vector<vector<unsigned int> >& bins, unsigned int& unplaced)
+{
+	set<pair<unsigned int, unsigned int> > open;	// (room, bank)
+	unsigned int opened = 0;
+
+	for(unsigned int i = 0; i < order.size(); ++i)
+	{
+		unsigned int item = order[i];
+		unsigned int size = sizes[item];
+		unsigned int bin;
+
+		set<pair<unsigned int, unsigned int> >::iterator it = open.lower_bound(make_pair(size, 0u));
+		if(it != open.end()) {
+			// Erased first, as an empty item leaves the room the same
+			bin = it->second;
+			unsigned int room = it->first - size;
+			open.erase(it);
+			open.insert(make_pair(room, bin));
+		}
+		else {
+			// Banks too small for this item stay open for smaller ones
+			while(opened < capacities.size() && capacities[opened] < size) {
+				open.insert(make_pair(capacities[opened], opened));
+				opened++;
+			}
+			if(opened == capacities.size()) {
+				unplaced = item;
+				return false;
+			}
+			bin = opened++;
+			open.insert(make_pair(capacities[bin] - size, bin));
+		}
+		bins[bin].push_back(item);
+	}
+	return true;
+}
+
+
+/*
+ * Returns the bank whose contents should go last, given the loads of the
+ * first 'count' banks: the least loaded one that can swap places with the
+ * last bank, since the space after the last module isn't wasted
+ */
+unsigned int BankPacker::LastBank(const vector<unsigned int>& loads, unsigned int count) const
+{
+	unsigned int last = count - 1;
+	unsigned int best = last;
+	for(unsigned int i = 0; i < last; ++i) {
+		if(loads[i] > 0 && loads[i] < loads[best]
+			&& loads[i] <= capacities[last] && loads[last] <= capacities[i])
+			best = i;
+	}
+	return best;
+}
+
+/*
+ * Returns the number of bytes from the first bank to the end of the
+ * packing, once the least loaded bank has been moved to the end
+ */
+unsigned int BankPacker::Span(const vector<unsigned int>& loads) const
+{
+	unsigned int count = loads.size();
+	while(count > 0 && loads[count - 1] == 0)
+		count--;
+	if(count == 0)
+		return 0;
+	return before[count - 1] + loads[LastBank(loads, count)];
+}
+
+void BankPacker::PutSmallestLast(vector<vector<unsigned int> >& bins) const
+{
+	vector<unsigned int> loads(bins.size(), 0);
+	unsigned int count = 0;
+	for(unsigned int i = 0; i < bins.size(); ++i) {
+		for(unsigned int j = 0; j < bins[i].size(); ++j)
+			loads[i] += sizes[bins[i][j]];
+		if(!bins[i].empty())
+			count = i + 1;
+	}
+	if(count > 0)
+		bins[LastBank(loads, count)].swap(bins[count - 1]);
+}
+
+
+/*
+ * Searches for the packing with the smallest span by branch and bound,
+ * starting from the packing already in 'bins' (if any). Returns false if
+ * no packing was found.
+ */
+bool BankPacker::PackExact(vector<vector<unsigned int> >& bins, unsigned int timelimit)
+{
+	loads.assign(capacities.size(), 0);
+	assignment.assign(sizes.size(), 0);
+	bestassignment.clear();
+	used = 0;
+	total = 0;
+	nodes = 0;
+	stop = false;
+	deadline = chrono::steady_clock::now() + chrono::milliseconds(timelimit);
+
+	for(unsigned int i = 0; i < sizes.size(); ++i)
+		total += sizes[i];
+
+	// Start from the packing we were given, if it's complete
+	vector<unsigned int> initial(capacities.size(), 0);
+	unsigned int placed = 0;
+	for(unsigned int i = 0; i < bins.size(); ++i) {
+		for(unsigned int j = 0; j < bins[i].size(); ++j) {
+			initial[i] += sizes[bins[i][j]];
+			assignment[bins[i][j]] = i;
+		}
+		placed += bins[i].size();
+	}
+
+	best = UINT_MAX;
+	if(placed == sizes.size()) {
+		best = Span(initial);
+		bestassignment = assignment;
+	}
+
+	// Nothing can beat a packing with no waste
+	if(best > total)
+		Search(0);
+
+	if(bestassignment.empty())
+		return false;
+
+	bins.assign(capacities.size(), vector<unsigned int>());
+	for(unsigned int i = 0; i < order.size(); ++i)
+		bins[bestassignment[order[i]]].push_back(order[i]);
+	return true;
+}
+
+void BankPacker::Search(unsigned int next)
+{
+	if(stop)
+		return;
+
+	if((++nodes & 1023) == 0 && chrono::steady_clock::now() > deadline) {
+		stop = timedout = true;
+		return;
+	}
+
+	if(next == order.size()) {
+		unsigned int span = Span(loads);
+		if(span < best) {
+			best = span;
+			bestassignment = assignment;
+
+			// Can't do better than no waste at all
+			if(best == total)
+				stop = true;
+		}
+		return;
+	}
+
+	// Banks too full for even the smallest remaining item are finished, and
+	// the room left in all but one of them is wasted
+	unsigned int smallest = sizes[order.back()];
+	unsigned int waste = 0, maxwaste = 0;
+	for(unsigned int i = 0; i < used; ++i) {
+		unsigned int room = capacities[i] - loads[i];
+		if(room < smallest) {
+			waste += room;
+			maxwaste = max(maxwaste, room);
+		}
+	}
+	if(total + waste - maxwaste >= best)
+		return;
+
+	unsigned int item = order[next];
+	unsigned int size = sizes[item];
+
+	// Banks with the same capacity and load are interchangeable, so only
+	// one of them needs to be tried
+	set<pair<unsigned int, unsigned int> > tried;
+
+	for(unsigned int i = 0; i < used && !stop; ++i)
+	{
+		if(capacities[i] - loads[i] < size)
+			continue;
+		if(!tried.insert(make_pair(capacities[i], loads[i])).second)
+			continue;
+
+		loads[i] += size;
+		assignment[item] = i;
+		Search(next + 1);
+		loads[i] -= size;
+	}
+
+	// Open the next bank that will hold it, unless everything before it
+	// already adds up to more than the best span
+	unsigned int bank = used;
+	while(bank < capacities.size() && capacities[bank] < size)
+		bank++;
+	if(bank == capacities.size() || stop || before[bank] >= best)
+		return;
+
+	unsigned int saved = used;
+	used = bank + 1;
+	loads[bank] += size;
+	assignment[item] = bank;
+	Search(next + 1);
+	loads[bank] -= size;
+	used = saved;
+}
@@ -0,0 +1,76 @@
+/* bank packing */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+// Decides which bank each module goes in.
+//
+// Modules can't cross bank boundaries, so placing them is a bin packing
+// problem: the banks are the bins, filled in order from the start address,
+// and whatever is left at the end of every bank but the last is wasted.
+//
+// Three methods are available:
+//  - Greedy fills one bank at a time, each time taking the largest module
+//    that still fits. This is the original placement, and the default.
+//  - BestFit places modules largest first, each into the open bank with
+//    the least room that can hold it (best-fit decreasing).
+//  - Exact starts from the best-fit packing and searches for a better one
+//    by branch and bound, until it proves the packing optimal or runs out
+//    of time.
+class BankPacker
+{
+public:
+	enum Method { Greedy, BestFit, Exact };
+
+	// Looks up a method by its command-line name. Returns false if unknown.
+	static bool MethodFromName(const std::string& name, Method& method);
+	static const char* MethodName(Method method);
+
+	// 'capacities' are the sizes of the available banks, in the order
+	// they are filled
+	explicit BankPacker(const std::vector<unsigned int>& capacities);
+
+	// Packs items of the given sizes. On success, fills 'bins' with the
+	// indices of the items in each bank, in the order they should be laid
+	// out, and returns true. If some item can't be placed, sets 'unplaced'
+	// to it and returns false. The exact search gives up after 'timelimit'
+	// milliseconds.
+	bool Pack(const std::vector<unsigned int>& sizes, Method method, unsigned int timelimit,
+		std::vector<std::vector<unsigned int> >& bins, unsigned int& unplaced);
+
+	// Returns the smallest number of banks that could hold 'total' bytes
+	unsigned int LowerBound(unsigned int total) const;
+
+	// True if the last exact search was stopped by the time limit, rather
+	// than finishing with a packing known to be optimal
+	bool TimedOut() const { return timedout; }
+
+private:
+	bool PackGreedy(std::vector<std::vector<unsigned int> >& bins, unsigned int& unplaced);
+	bool PackBestFit(std::vector<std::vector<unsigned int> >& bins, unsigned int& unplaced);
+	bool PackExact(std::vector<std::vector<unsigned int> >& bins, unsigned int timelimit);
+
+	unsigned int LastBank(const std::vector<unsigned int>& loads, unsigned int count) const;
+	unsigned int Span(const std::vector<unsigned int>& loads) const;
+	void PutSmallestLast(std::vector<std::vector<unsigned int> >& bins) const;
+	void Search(unsigned int next);
+
+	std::vector<unsigned int> capacities;
+	std::vector<unsigned int> before;	// total capacity of the banks before each one
+	std::vector<unsigned int> sizes;
+	std::vector<unsigned int> order;	// item indices, largest first
+	bool timedout;
+
+	// Branch and bound state
+	std::vector<unsigned int> loads;
+	std::vector<unsigned int> assignment;
+	std::vector<unsigned int> bestassignment;
+	unsigned int used;			// number of banks opened so far
+	unsigned int best;			// span of the best packing found
+	unsigned int total;			// total size of all items
+	unsigned long nodes;
+	std::chrono::steady_clock::time_point deadline;
+	bool stop;
+};
@@ -0,0 +1,266 @@
+/* IPS and BPS patch output implementation */
+
+#include "patch.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem::v1;
+
+#include "romimage.h"
+#include "checksum.h"
+#include "exception.h"
+
+using namespace std;
+
+
+/*
+ * Finds the ranges of the image that actually differ from the original
+ * file, by comparing the dirty ranges against the file. Unchanged runs
+ * shorter than 'mingap' between changes are absorbed into the changes,
+ * since in both formats it's cheaper to repeat a few bytes than to start
+ * a new record.
+ *
+ * If 'sourcecrc' is given, also computes the CRC-32 of the original file.
+ */
+static void FindChanges(RomImage& rom, unsigned int mingap,
+	vector<RomImage::Range>& changes, unsigned int* sourcecrc = NULL)
+{
+	ifstream original(rom.GetPath().c_str(), ifstream::binary);
+	if(original.fail())
+		throw Exception("couldn't open " + rom.GetPath() + " for reading");
+
+	const char* data = rom.GetData();
+	const vector<RomImage::Range>& dirty = rom.GetDirtyRanges();
+
+	unsigned int crc = 0;
+	unsigned int pos = 0;
+	vector<char> old;
+
+	for(vector<RomImage::Range>::const_iterator it = dirty.begin(); it != dirty.end(); ++it)
+	{
+		unsigned int start = it->first, end = it->second;
+
+		// Bytes outside the dirty ranges are the same in both
+		if(sourcecrc)
+			crc = Crc32(data + pos, start - pos, crc);
+
+		old.resize(end - start);
+		original.seekg(start);
+		original.read(&old[0], old.size());
+		if(original.fail())
+			throw Exception("couldn't read " + rom.GetPath());
+
+		if(sourcecrc)
+			crc = Crc32(&old[0], old.size(), crc);
+
+		unsigned int i = start;
+		while(i < end) {
+			// Skip unchanged bytes
+			while(i < end && data[i] == old[i - start])
+				++i;
+			if(i == end)
+				break;
+
+			unsigned int first = i;
+			unsigned int last = i + 1;	// one past the last changed byte
+
+			// Extend the change until a long enough unchanged run is found
+			for(++i; i < end; ++i) {
+				if(data[i] != old[i - start])
+					last = i + 1;
+				else if(i - last + 1 >= mingap)
+					break;
+			}
+
+			if(!changes.empty() && first - changes.back().second < mingap)
+				changes.back().second = last;
+			else
+				changes.push_back(RomImage::Range(first, last));
+			i = last;
+		}
+		pos = end;
+	}
+
+	if(sourcecrc)
+		*sourcecrc = Crc32(data + pos, rom.GetSize() - pos, crc);
+}
+
+
+Patch::Format Patch::FormatFromFilename(const string& path)
+{
+	string ext = fs::path(path).extension().string();
+	transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+	if(ext == ".ips")
+		return IPS;
+	if(ext == ".bps")
+		return BPS;
+	return Unknown;
+}
+
+void Patch::Write(const string& path, Format format, RomImage& rom)
+{
+	ofstream out(path.c_str(), ofstream::binary | ofstream::trunc);
+	if(out.fail())
+		throw Exception("couldn't open " + path + " for writing");
+
+	if(format == IPS)
+		WriteIPS(out, rom);
+	else if(format == BPS)
+		WriteBPS(out, rom);
+	else
+		throw Exception("unknown patch format for " + path);
+
+	out.close();
+	if(out.fail())
+		throw Exception("couldn't write " + path);
+}
+
+
+/*
+ * IPS:
+ *  "PATCH"
+ *  records: u24 offset, u16 length, u8[length] data  (big-endian)
+ *  "EOF"
+ */
+void Patch::WriteIPS(ostream& out, RomImage& rom)
+{
+	// Offsets are only three bytes
+	if(rom.GetSize() > 0x1000000)
+		throw Exception("ROM is too large for an IPS patch; use BPS instead");
+
+	// A record header is five bytes
+	vector<RomImage::Range> changes;
+	FindChanges(rom, 6, changes);
+
+	const char* data = rom.GetData();
+	out.write("PATCH", 5);
+
+	for(vector<RomImage::Range>::const_iterator it = changes.begin(); it != changes.end(); ++it)
+	{
+		unsigned int start = it->first;
+
+		// An offset that reads as "EOF" would end the patch early;
+		// start such a record one byte sooner instead
+		if(start == 0x454F46)
+			start--;
+
+		while(start < it->second) {
+			unsigned int len = min(it->second - start, 0xFFFFu);
+
+			// Likewise, don't let the next record start there
+			if(start + len == 0x454F46 && start + len < (unsigned int)rom.GetSize()) {
+				if(len < 0xFFFF)
+					len++;
+				else
+					len--;
+			}
+
+			char header[5] = {
+				static_cast<char>(start >> 16), static_cast<char>(start >> 8), static_cast<char>(start),
+				static_cast<char>(len >> 8), static_cast<char>(len)
+			};
+			out.write(header, 5);
+			out.write(data + start, len);
+			start += len;
+		}
+	}
+
+	out.write("EOF", 3);
+}
+
+
+//
+// Writes to a stream, keeping a running CRC-32 of everything written
+//
+class ChecksumWriter
+{
+public:
+	explicit ChecksumWriter(ostream& out) : out(out), crc(0) { }
+
+	void Write(const char* data, size_t len) {
+		out.write(data, len);
+		crc = Crc32(data, len, crc);
+	}
+
+	void Byte(unsigned char n) {
+		char c = static_cast<char>(n);
+		Write(&c, 1);
+	}
+
+	void Int(unsigned int n) {
+		Byte(n & 255);
+		Byte((n >> 8) & 255);
+		Byte((n >> 16) & 255);
+		Byte((n >> 24) & 255);
+	}
+
+	// BPS variable-length number
+	void Number(unsigned long long n) {
+		while(true) {
+			unsigned char x = n & 0x7F;
+			n >>= 7;
+			if(n == 0) {
+				Byte(0x80 | x);
+				break;
+			}
+			Byte(x);
+			n--;
+		}
+	}
+
+	unsigned int GetCrc() const { return crc; }
+
+private:
+	ostream& out;
+	unsigned int crc;
+};
+
+/*
+ * BPS:
+ *  "BPS1"
+ *  number source size, number target size, number metadata size (0)
+ *  actions: number ((length - 1) << 2 | command), plus data for TargetRead
+ *  u32 source CRC, u32 target CRC, u32 patch CRC
+ *
+ * Unchanged areas are SourceRead actions and changes are TargetRead
+ * actions, so the patch is only as large as the changes.
+ */
+void Patch::WriteBPS(ostream& out, RomImage& rom)
+{
+	enum { SourceRead = 0, TargetRead = 1 };
+
+	// An action is usually one or two bytes
+	vector<RomImage::Range> changes;
+	unsigned int sourcecrc;
+	FindChanges(rom, 4, changes, &sourcecrc);
+
+	const char* data = rom.GetData();
+	unsigned int size = rom.GetSize();
+
+	ChecksumWriter w(out);
+	w.Write("BPS1", 4);
+	w.Number(size);
+	w.Number(size);
+	w.Number(0);
+
+	unsigned int pos = 0;
+	for(vector<RomImage::Range>::const_iterator it = changes.begin(); it != changes.end(); ++it)
+	{
+		if(it->first > pos)
+			w.Number((unsigned long long)(it->first - pos - 1) << 2 | SourceRead);
+
+		w.Number((unsigned long long)(it->second - it->first - 1) << 2 | TargetRead);
+		w.Write(data + it->first, it->second - it->first);
+		pos = it->second;
+	}
+	if(pos < size)
+		w.Number((unsigned long long)(size - pos - 1) << 2 | SourceRead);
+
+	w.Int(sourcecrc);
+	w.Int(Crc32(data, size));
+	w.Int(w.GetCrc());
+}
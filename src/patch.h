@@ -0,0 +1,31 @@
+/* IPS and BPS patch output */
+#pragma once
+
+#include <string>
+#include <ostream>
+
+class RomImage;
+
+
+// Writes patches that turn the ROM file on disk into the compiled image,
+// instead of writing the image back to the file.
+//
+// Patches are generated from the image's dirty ranges alone: only those
+// ranges are compared with the original file, and everything else is
+// known to be unchanged, so the cost depends on the size of the output
+// rather than the size of the ROM.
+class Patch
+{
+public:
+	enum Format { Unknown, IPS, BPS };
+
+	// Determines the patch format from a file extension
+	static Format FormatFromFilename(const std::string& path);
+
+	// Writes a patch in the given format. Throws an Exception on failure.
+	static void Write(const std::string& path, Format format, RomImage& rom);
+
+private:
+	static void WriteIPS(std::ostream& out, RomImage& rom);
+	static void WriteBPS(std::ostream& out, RomImage& rom);
+};
@@ -0,0 +1,167 @@
+/* peephole optimizer implementation */
+
+#include "peephole.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "anchor.h"
+#include "bytechunk.h"
+
+using namespace std;
+
+
+/*
+ * A jump found in a chunk
+ */
+struct JumpSite {
+	unsigned int ref;		// index of its reference
+	unsigned int start;		// position of its opcode
+	unsigned int end;		// position just after its operand
+};
+
+typedef ByteChunk::Range Cut;
+
+
+unsigned int Peephole::Optimize(ByteChunk& chunk)
+{
+	unsigned int size = chunk.GetSize();
+
+	// Each change can open the way for others, e.g. removing dead code can
+	// leave a jump to the next byte
+	while(Pass(chunk))
+		;
+
+	return size - chunk.GetSize();
+}
+
+/*
+ * Makes one round of changes. Returns true if anything changed.
+ */
+bool Peephole::Pass(ByteChunk& chunk)
+{
+	vector<unsigned char>& bytes = chunk.bytes;
+	vector<ByteChunk::Reference>& refs = chunk.refs;
+
+	// Anchors placed in this chunk; the ones that are labels or are referred
+	// to are the places code can be entered other than by falling through
+	set<Anchor*> local(chunk.anchors.begin(), chunk.anchors.end());
+	set<Anchor*> targets;
+	for(unsigned int i = 0; i < refs.size(); ++i)
+		targets.insert(refs[i].target);
+
+	vector<unsigned int> entries;
+	for(set<Anchor*>::const_iterator it = local.begin(); it != local.end(); ++it) {
+		if((*it)->IsExternal() || targets.count(*it))
+			entries.push_back((*it)->GetPosition());
+	}
+	std::sort(entries.begin(), entries.end());
+
+	// Find the jumps, checking that each is still intact
+	vector<JumpSite> jumps;
+	map<unsigned int, unsigned int> gotos;	// opcode position -> index in jumps
+	for(unsigned int i = 0; i < refs.size(); ++i)
+	{
+		const ByteChunk::Reference& r = refs[i];
+		// Calls come back, so they can't be treated like jumps
+		if(r.jump == ByteChunk::NoJump || r.jump == ByteChunk::Call
+			|| r.offset != 0 || r.length != 4)
+			continue;
+
+		unsigned int opsize = (r.jump == ByteChunk::Goto) ? 1 : 2;
+		if(r.location < (int)opsize || r.location + 4 > (int)bytes.size())
+			continue;
+
+		unsigned int start = r.location - opsize;
+		if(r.jump == ByteChunk::Goto && bytes[start] != 0x0A)
+			continue;
+		if(r.jump != ByteChunk::Goto && (bytes[start] != 0x1B
+			|| bytes[start + 1] != (r.jump == ByteChunk::IfFalse ? 0x02 : 0x03)))
+			continue;
+
+		JumpSite j = { i, start, (unsigned int)r.location + 4 };
+		jumps.push_back(j);
+		if(r.jump == ByteChunk::Goto)
+			gotos[start] = jumps.size() - 1;
+	}
+
+	bool changed = false;
+
+	// Send jumps that land on unconditional jumps straight to the end of
+	// the chain, stopping at anything that loops
+	for(vector<JumpSite>::const_iterator it = jumps.begin(); it != jumps.end(); ++it)
+	{
+		Anchor* target = refs[it->ref].target;
+		set<Anchor*> seen;
+		seen.insert(target);
+
+		while(local.count(target)) {
+			map<unsigned int, unsigned int>::const_iterator g = gotos.find(target->GetPosition());
+			if(g == gotos.end())
+				break;
+			target = refs[jumps[g->second].ref].target;
+			if(!seen.insert(target).second) {
+				target = refs[it->ref].target;
+				break;
+			}
+		}
+
+		if(target != refs[it->ref].target) {
+			refs[it->ref].target = target;
+			changed = true;
+		}
+	}
+
+	// Find what can be cut
+	vector<Cut> cuts;
+	for(vector<JumpSite>::const_iterator it = jumps.begin(); it != jumps.end(); ++it)
+	{
+		const ByteChunk::Reference& r = refs[it->ref];
+
+		// A jump to the next byte does nothing
+		if(local.count(r.target) && r.target->GetPosition() == (int)it->end) {
+			cuts.push_back(Cut(it->start, it->end));
+			continue;
+		}
+
+		// Nothing after an unconditional jump is reached before the next entry
+		if(r.jump == ByteChunk::Goto) {
+			vector<unsigned int>::const_iterator next = lower_bound(entries.begin(), entries.end(), it->end);
+			unsigned int stop = (next == entries.end()) ? bytes.size() : *next;
+			if(stop > it->end)
+				cuts.push_back(Cut(it->end, stop));
+		}
+	}
+
+	if(cuts.empty())
+		return changed;
+
+	// Merge overlapping cuts
+	std::sort(cuts.begin(), cuts.end());
+	vector<Cut> merged;
+	for(vector<Cut>::const_iterator it = cuts.begin(); it != cuts.end(); ++it) {
+		if(!merged.empty() && it->first <= merged.back().second)
+			merged.back().second = max(merged.back().second, it->second);
+		else
+			merged.push_back(*it);
+	}
+
+	chunk.Remove(merged);
+
+	// Forget internal anchors that nothing refers to any more
+	targets.clear();
+	for(unsigned int i = 0; i < refs.size(); ++i)
+		targets.insert(refs[i].target);
+
+	vector<Anchor*> anchors;
+	for(vector<Anchor*>::const_iterator it = chunk.anchors.begin(); it != chunk.anchors.end(); ++it) {
+		if((*it)->IsExternal() || targets.count(*it))
+			anchors.push_back(*it);
+	}
+	chunk.anchors.swap(anchors);
+
+	return true;
+}
@@ -0,0 +1,25 @@
+/* peephole optimizer for generated jumps */
+#pragma once
+
+class ByteChunk;
+
+// Tidies up the jumps generated by the lowering of if, menu, and, and or
+// expressions:
+//  - a jump to an unconditional jump goes straight to its final target
+//  - a jump to the very next byte is removed
+//  - code after an unconditional jump is removed, up to the next place
+//    anything can jump to
+//
+// Only jumps the compiler emitted itself (see ByteChunk::Jump) are looked
+// at. Control codes written out in the source are left alone, since their
+// opcodes can't reliably be told apart from the operands of other codes.
+class Peephole
+{
+public:
+	// Optimizes a chunk in place, keeping its anchors and references
+	// consistent. Returns the number of bytes removed.
+	static unsigned int Optimize(ByteChunk& chunk);
+
+private:
+	static bool Pass(ByteChunk& chunk);
+};
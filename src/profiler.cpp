@@ -0,0 +1,250 @@
+/* sampling profiler for script evaluation implementation */
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include "ast.h"
+#include "module.h"
+
+using namespace std;
+
+
+bool ScriptFrame::operator<(const ScriptFrame& rhs) const
+{
+	if(module != rhs.module)
+		return module < rhs.module;
+	if(command != rhs.command)
+		return command < rhs.command;
+	return line < rhs.line;
+}
+
+
+ScriptStack::ScriptStack()
+	: version(0), depth(0)
+{
+}
+
+void ScriptStack::Push(const Module* module, const CommandDef* command, int line)
+{
+	unsigned int v = version.load(memory_order_relaxed);
+	unsigned int d = depth.load(memory_order_relaxed);
+
+	version.store(v + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	if(d < MaxDepth) {
+		slots[d].module.store(module, memory_order_relaxed);
+		slots[d].command.store(command, memory_order_relaxed);
+		slots[d].line.store(line, memory_order_relaxed);
+	}
+	depth.store(d + 1, memory_order_relaxed);
+
+	version.store(v + 2, memory_order_release);
+}
+
+void ScriptStack::Pop()
+{
+	unsigned int v = version.load(memory_order_relaxed);
+
+	version.store(v + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	depth.store(depth.load(memory_order_relaxed) - 1, memory_order_relaxed);
+	version.store(v + 2, memory_order_release);
+}
+
+bool ScriptStack::Read(vector<ScriptFrame>& frames) const
+{
+	for(int attempt = 0; attempt < 8; ++attempt)
+	{
+		unsigned int before = version.load(memory_order_acquire);
+		if(before & 1)
+			continue;
+
+		unsigned int d = min(depth.load(memory_order_relaxed), MaxDepth);
+		frames.resize(d);
+		for(unsigned int i = 0; i < d; ++i) {
+			frames[i].module = slots[i].module.load(memory_order_relaxed);
+			frames[i].command = slots[i].command.load(memory_order_relaxed);
+			frames[i].line = slots[i].line.load(memory_order_relaxed);
+		}
+
+		atomic_thread_fence(memory_order_acquire);
+		if(version.load(memory_order_relaxed) == before)
+			return true;
+	}
+	return false;
+}
+
+
+Profiler::Profiler()
+{
+	interval = 0;
+	sampling = false;
+	stopping = false;
+	samplecount = 0;
+	missed = 0;
+}
+
+Profiler::~Profiler()
+{
+	Stop();
+}
+
+void Profiler::Start()
+{
+	if(!Enabled() || sampling)
+		return;
+
+	stopping = false;
+	sampling = true;
+	sampler = thread(&Profiler::Run, this);
+}
+
+void Profiler::Stop()
+{
+	if(!sampling)
+		return;
+
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	sampler.join();
+	sampling = false;
+}
+
+/*
+ * Takes samples until stopped. Runs on the sampling thread.
+ */
+void Profiler::Run()
+{
+	vector<ScriptFrame> frames;
+	Clock::time_point last = Clock::now();
+
+	unique_lock<mutex> guard(lock);
+	while(!stopping)
+	{
+		wake.wait_for(guard, chrono::microseconds(interval));
+		if(stopping)
+			break;
+
+		Clock::time_point now = Clock::now();
+		if(stack.Read(frames)) {
+			samples[frames] += chrono::duration<double, micro>(now - last).count();
+			samplecount++;
+		}
+		else
+			missed++;
+		last = now;
+	}
+}
+
+/*
+ * Returns the name of a frame in a folded stack
+ */
+static string FrameName(const ScriptFrame& frame)
+{
+	if(!frame.command)
+		return frame.module->GetName();
+
+	stringstream ss;
+	ss << frame.command->GetName() << " (" << frame.module->GetName() << ":" << frame.line << ")";
+	return ss.str();
+}
+
+void Profiler::WriteFolded(ostream& out) const
+{
+	for(map<vector<ScriptFrame>, double>::const_iterator it = samples.begin(); it != samples.end(); ++it)
+	{
+		const vector<ScriptFrame>& frames = it->first;
+
+		// Time outside of any module is the compiler's own
+		if(frames.empty())
+			out << "(compiler)";
+		for(unsigned int i = 0; i < frames.size(); ++i)
+			out << (i ? ";" : "") << FrameName(frames[i]);
+		out << " " << (unsigned long)(it->second + 0.5) << endl;
+	}
+}
+
+struct CommandTime {
+	string name;
+	double self;
+	double inclusive;
+};
+
+static bool MoreInclusive(const CommandTime& a, const CommandTime& b)
+{
+	if(a.inclusive != b.inclusive)
+		return a.inclusive > b.inclusive;
+	if(a.self != b.self)
+		return a.self > b.self;
+	return a.name < b.name;
+}
+
+void Profiler::WriteTable(ostream& out) const
+{
+	// Commands are counted by name; a command is only counted once in a
+	// stack for its inclusive time, however many times it appears
+	map<string, CommandTime> commands;
+	double total = 0, toplevel = 0, compiler = 0;
+
+	for(map<vector<ScriptFrame>, double>::const_iterator it = samples.begin(); it != samples.end(); ++it)
+	{
+		const vector<ScriptFrame>& frames = it->first;
+		double time = it->second;
+		total += time;
+
+		if(frames.empty()) {
+			compiler += time;
+			continue;
+		}
+		if(!frames.back().command)
+			toplevel += time;
+
+		set<string> seen;
+		for(unsigned int i = 0; i < frames.size(); ++i)
+		{
+			if(!frames[i].command)
+				continue;
+
+			const string& name = frames[i].command->GetName();
+			CommandTime& c = commands[name];
+			c.name = name;
+			if(seen.insert(name).second)
+				c.inclusive += time;
+			if(i + 1 == frames.size())
+				c.self += time;
+		}
+	}
+
+	vector<CommandTime> order;
+	for(map<string, CommandTime>::const_iterator it = commands.begin(); it != commands.end(); ++it)
+		order.push_back(it->second);
+	std::sort(order.begin(), order.end(), MoreInclusive);
+
+	out << std::dec << samplecount << " samples every " << interval << " us";
+	if(missed > 0)
+		out << " (" << missed << " missed)";
+	out << endl;
+
+	out << fixed << setprecision(2)
+		<< "Sampled: " << total / 1000 << " ms; in commands: " << (total - toplevel - compiler) / 1000
+		<< " ms; module top level: " << toplevel / 1000 << " ms; outside scripts: " << compiler / 1000
+		<< " ms" << endl << endl;
+
+	double percent = (total > 0) ? 100 / total : 0;
+	out << left << setw(32) << "Command" << right << setw(12) << "Self (ms)" << setw(8) << "%"
+		<< setw(12) << "Incl (ms)" << setw(8) << "%" << endl;
+	for(vector<CommandTime>::const_iterator it = order.begin(); it != order.end(); ++it) {
+		out << left << setw(32) << it->name << right
+			<< setw(12) << it->self / 1000 << setw(8) << it->self * percent
+			<< setw(12) << it->inclusive / 1000 << setw(8) << it->inclusive * percent << endl;
+	}
+}
@@ -0,0 +1,119 @@
+/* sampling profiler for script evaluation */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Module;
+class CommandDef;
+
+// A frame of the script-level call stack: a command being expanded, called
+// from a line of a module, or at the bottom of the stack, the module being
+// evaluated (with no command)
+struct ScriptFrame {
+	const Module* module;
+	const CommandDef* command;
+	int line;
+
+	bool operator<(const ScriptFrame& rhs) const;
+};
+
+// The script-level call stack of an evaluation, kept up to date by the
+// evaluating thread and read by the profiler's sampling thread. Changes are
+// versioned, so the reader can tell if it read the stack while it was
+// changing, and try again.
+class ScriptStack
+{
+public:
+	static const unsigned int MaxDepth = 256;	// frames past this are left out of samples
+
+	ScriptStack();
+
+	void Push(const Module* module, const CommandDef* command, int line);
+	void Pop();
+
+	// Copies the frames on the stack, bottom first; may be called from any
+	// thread. Returns false if the stack kept changing while it was read.
+	bool Read(std::vector<ScriptFrame>& frames) const;
+
+private:
+	struct Slot {
+		std::atomic<const Module*> module;
+		std::atomic<const CommandDef*> command;
+		std::atomic<int> line;
+	};
+
+	std::atomic<unsigned int> version;	// odd while the stack is being changed
+	std::atomic<unsigned int> depth;
+	Slot slots[MaxDepth];
+};
+
+// Keeps a frame on a script stack for the scope it's declared in, so the
+// frame comes off again even if evaluation throws. Does nothing if there's
+// no stack.
+class ScriptCall
+{
+public:
+	ScriptCall(ScriptStack* stack, const Module* module, const CommandDef* command, int line)
+		: stack(stack) { if(stack) stack->Push(module, command, line); }
+	~ScriptCall() { if(stack) stack->Pop(); }
+
+private:
+	ScriptCall(const ScriptCall&);
+	ScriptCall& operator=(const ScriptCall&);
+
+	ScriptStack* stack;
+};
+
+// Samples the script-level call stack at a fixed interval while modules are
+// evaluated, to find which commands the time goes to. Each sample is
+// weighted by the time since the one before it.
+//
+// The samples are written as folded stacks, one line per distinct stack
+// with its frames separated by semicolons, followed by the time in us, as
+// read by flamegraph.pl and speedscope. A command's frame is named with the
+// module and line it was called from. They can also be written as a table of
+// the time spent in each command, by itself and including what it calls.
+class Profiler
+{
+public:
+	Profiler();
+	~Profiler();
+
+	void Enable(unsigned int interval) { this->interval = interval; }
+	bool Enabled() const { return interval > 0; }
+
+	// Starts and stops sampling. The stack is only kept while sampling.
+	void Start();
+	void Stop();
+
+	// Returns the stack evaluation should keep, or NULL if not sampling
+	ScriptStack* GetStack() { return sampling ? &stack : NULL; }
+
+	void WriteFolded(std::ostream& out) const;
+	void WriteTable(std::ostream& out) const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	void Run();
+
+	unsigned int interval;		// between samples, in us; 0 if disabled
+	bool sampling;
+	ScriptStack stack;
+
+	std::thread sampler;
+	std::mutex lock;
+	std::condition_variable wake;
+	bool stopping;
+
+	std::map<std::vector<ScriptFrame>, double> samples;	// time in us, by stack
+	unsigned int samplecount;
+	unsigned int missed;		// samples dropped because the stack kept changing
+};
@@ -0,0 +1,228 @@
+/* ROM reset journal implementation */
+
+#include "resetjournal.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "checksum.h"
+#include "exception.h"
+
+using namespace std;
+
+
+//
+// Journal layout:
+//
+//  "CCSR"            magic
+//  u32               format version
+//  u32 u32           start and end of primary output
+//  u32               number of records
+//  records:
+//   u32 u32          address, length
+//   u8[length]       previous contents
+//  u32               number of placements (version 2 onwards)
+//  placements:
+//   u32 u8[n]        module name length and name
+//   u32 u32          address, size
+//  u32               CRC-32 of everything before it
+//
+// All integers are little-endian. The saved bytes of each record are
+// used in place, straight out of the mapped file.
+//
+
+static const char magic[4] = { 'C', 'C', 'S', 'R' };
+static const size_t headersize = 20;
+
+
+static void PutInt(string& out, unsigned int n)
+{
+	out += static_cast<char>(n & 255);
+	out += static_cast<char>((n >> 8) & 255);
+	out += static_cast<char>((n >> 16) & 255);
+	out += static_cast<char>((n >> 24) & 255);
+}
+
+static unsigned int GetInt(const char* p)
+{
+	const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+	return u[0] | (u[1] << 8) | (u[2] << 16) | ((unsigned int)u[3] << 24);
+}
+
+
+ResetJournal::ResetJournal()
+	: start(0), end(0)
+{
+}
+
+void ResetJournal::Clear()
+{
+	start = end = 0;
+	records.clear();
+	layout.clear();
+	saved.clear();
+	file.Close();
+}
+
+void ResetJournal::AddRecord(unsigned int address, const char* bytes, unsigned int length)
+{
+	Record r;
+	r.address = address;
+	r.length = length;
+	r.offset = saved.size();
+	saved.append(bytes, length);
+	records.push_back(r);
+}
+
+void ResetJournal::AddPlacement(const string& module, unsigned int address, unsigned int size)
+{
+	Placement p;
+	p.module = module;
+	p.address = address;
+	p.size = size;
+	layout.push_back(p);
+}
+
+const char* ResetJournal::GetBytes(const Record& r) const
+{
+	if(file.GetData())
+		return file.GetData() + r.offset;
+	return saved.data() + r.offset;
+}
+
+
+bool ResetJournal::Write(const string& path) const
+{
+	string out(magic, 4);
+	PutInt(out, FormatVersion);
+	PutInt(out, start);
+	PutInt(out, end);
+	PutInt(out, records.size());
+
+	for(vector<Record>::const_iterator it = records.begin(); it != records.end(); ++it) {
+		PutInt(out, it->address);
+		PutInt(out, it->length);
+		out.append(GetBytes(*it), it->length);
+	}
+
+	PutInt(out, layout.size());
+	for(vector<Placement>::const_iterator it = layout.begin(); it != layout.end(); ++it) {
+		PutInt(out, it->module.size());
+		out += it->module;
+		PutInt(out, it->address);
+		PutInt(out, it->size);
+	}
+
+	PutInt(out, Crc32(out.data(), out.size()));
+
+	ofstream f(path.c_str(), ofstream::binary | ofstream::trunc);
+	if(f.fail())
+		return false;
+	f.write(out.data(), out.size());
+	return !f.fail();
+}
+
+bool ResetJournal::Read(const string& path)
+{
+	Clear();
+
+	if(!file.Open(path))
+		return false;
+
+	const char* data = file.GetData();
+	size_t size = file.GetSize();
+
+	if(size < headersize + 4 || memcmp(data, magic, 4) != 0)
+		throw Exception("'" + path + "' is not a reset file");
+	// Version 1 journals are the same, less the layout
+	unsigned int version = GetInt(data + 4);
+	if(version != FormatVersion && version != 1)
+		throw Exception("'" + path + "' was written by an incompatible version of the compiler");
+	if(GetInt(data + size - 4) != Crc32(data, size - 4))
+		throw Exception("reset file '" + path + "' is damaged");
+
+	start = GetInt(data + 8);
+	end = GetInt(data + 12);
+
+	unsigned int count = GetInt(data + 16);
+	size_t pos = headersize;
+	size_t limit = size - 4;
+
+	records.reserve(count);
+	for(unsigned int i = 0; i < count; ++i) {
+		if(limit - pos < 8)
+			throw Exception("reset file '" + path + "' is damaged");
+		Record r;
+		r.address = GetInt(data + pos);
+		r.length = GetInt(data + pos + 4);
+		r.offset = pos + 8;
+		if(limit - r.offset < r.length)
+			throw Exception("reset file '" + path + "' is damaged");
+		pos = r.offset + r.length;
+		records.push_back(r);
+	}
+
+	if(version < 2)
+		return true;
+
+	if(limit - pos < 4)
+		throw Exception("reset file '" + path + "' is damaged");
+	count = GetInt(data + pos);
+	pos += 4;
+
+	for(unsigned int i = 0; i < count; ++i) {
+		if(limit - pos < 4)
+			throw Exception("reset file '" + path + "' is damaged");
+		size_t len = GetInt(data + pos);
+		pos += 4;
+		if(limit - pos < len || limit - pos - len < 8)
+			throw Exception("reset file '" + path + "' is damaged");
+		Placement p;
+		p.module.assign(data + pos, len);
+		p.address = GetInt(data + pos + len);
+		p.size = GetInt(data + pos + len + 4);
+		pos += len + 8;
+		layout.push_back(p);
+	}
+	return true;
+}
+
+/*
+ * Reads the old text format:
+ * [start address] [end address]
+ * {[hex address] [hex bytes] [newline]}
+ */
+bool ResetJournal::ReadText(const string& path)
+{
+	Clear();
+
+	ifstream f(path.c_str());
+	if(f.fail())
+		return false;
+
+	f >> hex >> start >> end;
+
+	while(!f.eof()) {
+		string line;
+		getline(f, line);
+
+		if(line.empty()) continue;
+
+		unsigned int vadr;
+		stringstream ss(line);
+		ss >> hex >> vadr;
+		if(ss.fail()) continue;
+
+		string bytes;
+		while(!ss.eof()) {
+			unsigned int byte;
+			ss >> byte;
+			if(ss.fail()) break;
+			bytes += static_cast<char>(byte);
+		}
+		AddRecord(vadr, bytes.data(), bytes.size());
+	}
+	return true;
+}
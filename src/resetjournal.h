@@ -0,0 +1,69 @@
+/* ROM reset journal */
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "mappedfile.h"
+
+// A record of what one compilation did to the ROM, so that the next
+// compilation can undo it first: the range of primary output (which is
+// simply cleared) and the previous contents of every area overwritten
+// by ROM[] statements (which are restored). It also records where each
+// module was placed, so that stable placement can keep modules where they
+// were.
+//
+// Journals are written in a compact binary format. The text format used
+// by older versions ('.reset.txt') can still be read.
+class ResetJournal
+{
+public:
+	static const unsigned int FormatVersion = 2;
+
+	struct Record {
+		unsigned int address;	// virtual address
+		unsigned int length;
+		size_t offset;			// offset of the saved bytes; see GetBytes()
+	};
+
+	struct Placement {
+		std::string module;
+		unsigned int address;	// virtual address
+		unsigned int size;
+	};
+
+	ResetJournal();
+
+	unsigned int start;			// virtual address range of primary output,
+	unsigned int end;			// or start == end if there was none, or it was
+								// placed in separate regions (see layout)
+
+	std::vector<Record> records;
+	std::vector<Placement> layout;	// empty for journals from older versions
+
+	// Adds a record, copying the given previous contents
+	void AddRecord(unsigned int address, const char* bytes, unsigned int length);
+
+	// Returns the saved bytes of a record
+	const char* GetBytes(const Record& r) const;
+
+	// Writes the journal in binary form. Returns false on failure.
+	bool Write(const std::string& path) const;
+
+	// Adds a module placement to the layout
+	void AddPlacement(const std::string& module, unsigned int address, unsigned int size);
+
+	// Reads a binary journal. Returns false if the file doesn't exist;
+	// throws an Exception if it exists but is damaged.
+	bool Read(const std::string& path);
+
+	// Reads a journal in the old text format. Returns false if the file
+	// doesn't exist.
+	bool ReadText(const std::string& path);
+
+private:
+	void Clear();
+
+	MappedFile file;	// backing store for records read from a binary journal
+	std::string saved;	// backing store for all other records
+};
@@ -0,0 +1,196 @@
+/* ROM image implementation */
+
+#include "romimage.h"
+
+#include <algorithm>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+
+RomImage::RomImage()
+	: data(NULL), size(0), mapped(false)
+{
+}
+
+RomImage::~RomImage()
+{
+	Close();
+}
+
+bool RomImage::Open(const string& path)
+{
+	Close();
+	this->path = path;
+
+#ifndef _WIN32
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+
+	struct stat st;
+	if(fstat(fd, &st) == 0 && st.st_size > 0) {
+		// A private writable mapping: pages are copied only when modified,
+		// and modifications never reach the file by themselves
+		void* p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if(p != MAP_FAILED) {
+			close(fd);
+			data = static_cast<char*>(p);
+			size = static_cast<int>(st.st_size);
+			mapped = true;
+			return true;
+		}
+	}
+	close(fd);
+#endif
+
+	// Fall back to reading the file into memory
+	ifstream file(path.c_str(), ifstream::binary);
+	if(file.fail())
+		return false;
+
+	file.seekg(0, ifstream::end);
+	buffer.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	if(!buffer.empty())
+		file.read(&buffer[0], buffer.size());
+	if(file.fail()) {
+		buffer.clear();
+		return false;
+	}
+
+	data = buffer.empty() ? NULL : &buffer[0];
+	size = static_cast<int>(buffer.size());
+	return true;
+}
+
+void RomImage::Prefetch()
+{
+	if(!mapped)
+		return;
+
+#ifndef _WIN32
+	madvise(data, size, MADV_WILLNEED);
+
+	// Touch every page; the advice alone doesn't wait for the reads
+	long pagesize = sysconf(_SC_PAGESIZE);
+	if(pagesize <= 0)
+		pagesize = 4096;
+
+	volatile char sink = 0;
+	for(int i = 0; i < size; i += pagesize)
+		sink += data[i];
+	(void)sink;
+#endif
+}
+
+void RomImage::Close()
+{
+#ifndef _WIN32
+	if(mapped)
+		munmap(data, size);
+#endif
+	mapped = false;
+	data = NULL;
+	size = 0;
+	buffer.clear();
+	dirty.Clear();
+}
+
+
+void RomImage::MarkDirty(unsigned int start, unsigned int end)
+{
+	dirty.Add(start, min(end, static_cast<unsigned int>(size)));
+}
+
+const vector<RomImage::Range>& RomImage::GetDirtyRanges()
+{
+	return dirty.GetUnion();
+}
+
+unsigned int RomImage::GetDirtySize()
+{
+	const vector<Range>& ranges = GetDirtyRanges();
+	unsigned int total = 0;
+	for(vector<Range>::const_iterator it = ranges.begin(); it != ranges.end(); ++it)
+		total += it->second - it->first;
+	return total;
+}
+
+
+int RomImage::CountChangedBytes()
+{
+	const vector<Range>& ranges = GetDirtyRanges();
+
+	ifstream file(path.c_str(), ifstream::binary);
+	if(file.fail())
+		return -1;
+
+	int changed = 0;
+	vector<char> old;
+	for(vector<Range>::const_iterator it = ranges.begin(); it != ranges.end(); ++it) {
+		old.resize(it->second - it->first);
+		file.seekg(it->first);
+		file.read(&old[0], old.size());
+		if(file.fail())
+			return -1;
+
+		for(unsigned int i = it->first; i < it->second; ++i)
+			if(data[i] != old[i - it->first])
+				changed++;
+	}
+	return changed;
+}
+
+
+bool RomImage::Flush()
+{
+	const vector<Range>& ranges = GetDirtyRanges();
+	if(ranges.empty())
+		return true;
+
+#ifndef _WIN32
+	int fd = open(path.c_str(), O_WRONLY);
+	if(fd < 0)
+		return false;
+
+	bool ok = true;
+	for(vector<Range>::const_iterator it = ranges.begin(); ok && it != ranges.end(); ++it) {
+		unsigned int pos = it->first;
+		while(pos < it->second) {
+			ssize_t n = pwrite(fd, data + pos, it->second - pos, pos);
+			if(n <= 0) {
+				ok = false;
+				break;
+			}
+			pos += n;
+		}
+	}
+	if(close(fd) != 0)
+		ok = false;
+	if(ok)
+		dirty.Clear();
+	return ok;
+#else
+	fstream file(path.c_str(), fstream::in | fstream::out | fstream::binary);
+	if(file.fail())
+		return false;
+
+	for(vector<Range>::const_iterator it = ranges.begin(); it != ranges.end(); ++it) {
+		file.seekp(it->first);
+		file.write(data + it->first, it->second - it->first);
+	}
+	file.close();
+	if(file.fail())
+		return false;
+	dirty.Clear();
+	return true;
+#endif
+}
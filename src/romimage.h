@@ -0,0 +1,64 @@
+/* ROM image with dirty range tracking */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "intervalset.h"
+
+// The in-memory image of the ROM file being compiled into.
+//
+// On POSIX systems the file is mapped copy-on-write, so it costs nothing
+// to "load" and changes stay private to the process; elsewhere it is read
+// into a buffer. Either way, nothing is written back to the file until
+// Flush() is called, and then only the byte ranges that were marked dirty.
+class RomImage
+{
+public:
+	typedef std::pair<unsigned int, unsigned int> Range;	// [first, second)
+
+	RomImage();
+	~RomImage();
+
+	bool Open(const std::string& path);		// Returns false if the file couldn't be read
+	void Close();
+
+	// Brings the whole image into memory ahead of use, so that later accesses
+	// don't stall on disk reads
+	void Prefetch();
+
+	const std::string& GetPath() const { return path; }
+	char* GetData() { return data; }
+	int GetSize() const { return size; }
+
+	// Records that bytes in [start, end) have been modified. The range is
+	// clipped to the size of the image.
+	void MarkDirty(unsigned int start, unsigned int end);
+
+	// Returns the modified ranges, sorted and with overlapping or adjacent
+	// ranges merged
+	const std::vector<Range>& GetDirtyRanges();
+
+	// Returns the total number of modified bytes
+	unsigned int GetDirtySize();
+
+	// Returns the number of bytes in the modified ranges that actually differ
+	// from the file, or -1 if the file couldn't be read
+	int CountChangedBytes();
+
+	// Writes the modified ranges back to the file. Returns false on failure.
+	bool Flush();
+
+private:
+	RomImage(const RomImage&);
+	RomImage& operator=(const RomImage&);
+
+	std::string path;
+	char* data;
+	int size;
+	bool mapped;				// true if data points into a mapping
+	std::vector<char> buffer;	// fallback storage when mapping isn't available
+
+	IntervalSet dirty;
+};
@@ -1,9 +1,9 @@
-/* CCScript strings */
-
-
-// Currently most of the functionality we need for strings is implemented
-// in the "ByteChunk" class, so mainly what we're doing is renaming
-// ByteChunk to String and adding any new functionality we find necessary.
-#include "bytechunk.h"
-#define String ByteChunk
-
+/* CCScript strings */
+
+
+// Currently most of the functionality we need for strings is implemented
+// in the "ByteChunk" class, so mainly what we're doing is renaming
+// ByteChunk to String and adding any new functionality we find necessary.
+#include "bytechunk.h"
+#define String ByteChunk
+
@@ -1,54 +1,62 @@
-/* symboltable class */
-#pragma once
-
-#include <vector>
-#include <string>
-#include <map>
-
-class Anchor;
-struct Value;
-
-class SymbolTable
-{
-private:
-	SymbolTable* parent;		// chaining scopes
-	std::map<std::string, Value> table;
-	std::map<std::string, Anchor*> jumps;
-
-public:
-	explicit SymbolTable(SymbolTable* parent = NULL) {
-		this->parent = parent;
-	}
-	SymbolTable(const SymbolTable&);
-	~SymbolTable();
-
-	void Merge(const SymbolTable& other, /*out*/ std::vector<std::string>& collisions);
-
-	void SetParent(SymbolTable* parent);
-
-	// Adds a base address to all registered label targets
-	// TODO: labels really should be factored out of this class and into Module
-	void AddBaseAddress(unsigned int base);
-
-	bool Define(const std::string& name, Value val);
-
-	bool DefineAnchor(Anchor* anchor);
-
-	bool DefineAnchor(const std::string& name, Anchor* anchor);
-
-	// Symbol lookup
-	Value Lookup(const std::string& name) const;
-	Anchor* LookupAnchor(const std::string& name) const;
-
-	// Lookup with no parent scope chaining
-	Value Get(const std::string& name) const;
-	Anchor* GetAnchor(const std::string& name) const;
-
-	std::string ToString() const;
-
-	std::string JumpsTable() const;
-
-	// TODO: this isn't really a sensible interface member
-	const std::map<std::string, Anchor*>& GetJumpTable() const;
-};
-
+/* symboltable class */
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+
+class Anchor;
+struct Value;
+
+class SymbolTable
+{
+private:
+	SymbolTable* parent;		// chaining scopes
+	std::map<std::string, Value> table;
+	std::map<std::string, Anchor*> jumps;
+	std::vector<const SymbolTable*> views;	// read-only tables consulted before the parent
+
+public:
+	explicit SymbolTable(SymbolTable* parent = NULL) {
+		this->parent = parent;
+	}
+	SymbolTable(const SymbolTable&);
+	~SymbolTable();
+
+	void SetParent(SymbolTable* parent);
+
+	// Adds another table to be searched, in order of addition, when a symbol
+	// isn't found in this one. Views are shared, not copied, so the viewed
+	// table must outlive this one and shouldn't change while it's in use.
+	// Only the viewed table's own symbols are visible; its parents aren't.
+	void AddView(const SymbolTable* view);
+
+	// Adds a base address to all registered label targets
+	// TODO: labels really should be factored out of this class and into Module
+	void AddBaseAddress(unsigned int base);
+
+	bool Define(const std::string& name, Value val);
+
+	bool DefineAnchor(Anchor* anchor);
+
+	bool DefineAnchor(const std::string& name, Anchor* anchor);
+
+	// Symbol lookup
+	Value Lookup(const std::string& name) const;
+	Anchor* LookupAnchor(const std::string& name) const;
+
+	// Lookup with no parent scope chaining
+	Value Get(const std::string& name) const;
+	Anchor* GetAnchor(const std::string& name) const;
+
+	// Appends the names of all symbols and labels defined in this table
+	void GetNames(std::vector<std::string>& names) const;
+
+	std::string ToString() const;
+
+	std::string JumpsTable() const;
+
+	// TODO: this isn't really a sensible interface member
+	const std::map<std::string, Anchor*>& GetJumpTable() const;
+};
+
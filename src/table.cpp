@@ -1,13 +1,13 @@
-/* CCScript table implementation */
-
-#include "table.h"
-#include <stdio.h>
-
-Table::Table()
-{
-}
-
-Table::~Table()
-{
-}
-
+/* CCScript table implementation */
+
+#include "table.h"
+#include <stdio.h>
+
+Table::Table()
+{
+}
+
+Table::~Table()
+{
+}
+
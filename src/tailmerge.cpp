@@ -0,0 +1,272 @@
+/* text merging implementation */
+
+#include "tailmerge.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "anchor.h"
+#include "bytechunk.h"
+#include "checksum.h"
+
+using namespace std;
+
+
+// A copy is replaced by [0A xx xx xx xx], so only longer ones are worth it
+static const unsigned int JumpSize = 5;
+
+/*
+ * A run of codes ending where control stops falling through
+ */
+struct TailMerger::Run {
+	unsigned int start;
+	unsigned int end;
+	unsigned int lastlabel;					// position of the last anchor inside, or 'start'
+	vector<unsigned int> steps;				// position of each code
+	vector<int> jumps;						// reference of each code that is a generated jump, or -1
+	vector<unsigned long long> hashes;		// hash of the run from each code to its end
+};
+
+/*
+ * Where a suffix of a run can be found
+ */
+struct Copy {
+	unsigned int chunk;
+	unsigned int run;
+	unsigned int step;
+};
+
+
+vector<unsigned int> TailMerger::Merge(const vector<ByteChunk*>& chunks)
+{
+	vector<vector<Run> > runs(chunks.size());
+	for(unsigned int i = 0; i < chunks.size(); ++i)
+		FindRuns(*chunks[i], runs[i]);
+
+	unordered_map<unsigned long long, Copy> copies;		// suffix hash -> first copy
+	map<pair<unsigned int, unsigned int>, Anchor*> shared;	// (chunk, position) -> anchor there
+	vector<vector<ByteChunk::Range> > replaced(chunks.size());
+	vector<vector<Anchor*> > targets(chunks.size());
+
+	for(unsigned int c = 0; c < chunks.size(); ++c)
+	{
+		for(unsigned int r = 0; r < runs[c].size(); ++r)
+		{
+			const Run& run = runs[c][r];
+			bool merged = false;
+
+			// Take the longest suffix that has been seen before
+			for(unsigned int i = 0; i < run.steps.size() && !merged; ++i)
+			{
+				unsigned int start = run.steps[i];
+				if(start < run.lastlabel)
+					continue;
+				if(run.end - start <= JumpSize)
+					break;
+
+				unordered_map<unsigned long long, Copy>::const_iterator found = copies.find(run.hashes[i]);
+				if(found == copies.end())
+					continue;
+				const Copy& copy = found->second;
+				const Run& other = runs[copy.chunk][copy.run];
+				if(!Same(*chunks[c], run, i, *chunks[copy.chunk], other, copy.step))
+					continue;
+
+				Anchor*& target = shared[make_pair(copy.chunk, other.steps[copy.step])];
+				if(!target) {
+					target = new Anchor("<merged>");
+					chunks[copy.chunk]->AddAnchor(other.steps[copy.step], target);
+				}
+
+				replaced[c].push_back(ByteChunk::Range(start, run.end));
+				targets[c].push_back(target);
+				merged = true;
+			}
+
+			// Runs that are kept in full become copies that later ones can
+			// jump to
+			if(!merged) {
+				for(unsigned int i = 0; i < run.steps.size(); ++i) {
+					Copy copy = { c, r, i };
+					copies.insert(make_pair(run.hashes[i], copy));
+				}
+			}
+		}
+	}
+
+	vector<unsigned int> removed(chunks.size(), 0);
+	for(unsigned int c = 0; c < chunks.size(); ++c) {
+		unsigned int size = chunks[c]->GetSize();
+		chunks[c]->ReplaceWithJumps(replaced[c], ByteChunk::Goto, targets[c]);
+		removed[c] = size - chunks[c]->GetSize();
+	}
+	return removed;
+}
+
+/*
+ * Finds the runs in a chunk, in order of position
+ */
+void TailMerger::FindRuns(const ByteChunk& chunk, vector<Run>& runs)
+{
+	const vector<unsigned char>& bytes = chunk.bytes;
+	const vector<ByteChunk::Reference>& refs = chunk.refs;
+	unsigned int size = bytes.size();
+
+	// Find the generated jumps that are still intact, by the position of
+	// their opcode, and the bytes that belong to any reference
+	vector<int> jumpat(size, -1);
+	vector<bool> covered(size, false);
+	for(unsigned int i = 0; i < refs.size(); ++i)
+	{
+		const ByteChunk::Reference& r = refs[i];
+		unsigned int first = r.location + r.offset;
+		unsigned int last = min(first + r.length, size);
+
+		unsigned int opsize = (r.jump == ByteChunk::Goto || r.jump == ByteChunk::Call) ? 1 : 2;
+		if(r.jump != ByteChunk::NoJump && r.offset == 0 && r.length == 4
+			&& r.location >= (int)opsize && r.location + 4 <= (int)size)
+		{
+			unsigned int start = r.location - opsize;
+			bool intact;
+			if(opsize == 1)
+				intact = bytes[start] == (r.jump == ByteChunk::Goto ? 0x0A : 0x08);
+			else
+				intact = bytes[start] == 0x1B && bytes[start + 1] == (r.jump == ByteChunk::IfFalse ? 0x02 : 0x03);
+			if(intact) {
+				jumpat[start] = i;
+				first = start + 1;
+			}
+		}
+
+		for(unsigned int p = first; p < last; ++p)
+			covered[p] = true;
+	}
+
+	// Where the code at each position ends, and where the run from there
+	// ends, if known; both are 0 otherwise
+	vector<unsigned int> next(size + 1, 0);
+	vector<unsigned int> end(size + 1, 0);
+	for(unsigned int p = size; p-- > 0; )
+	{
+		if(jumpat[p] >= 0) {
+			const ByteChunk::Reference& r = refs[jumpat[p]];
+			next[p] = r.location + 4;
+			end[p] = (r.jump == ByteChunk::Goto) ? next[p] : end[next[p]];
+			continue;
+		}
+		if(covered[p])
+			continue;
+
+		if(chunk.cinfo[p]) {
+			next[p] = p + 1;
+			end[p] = end[p + 1];
+			continue;
+		}
+
+		switch(bytes[p]) {
+			case 0x02:
+				next[p] = p + 1;
+				end[p] = p + 1;
+				break;
+			case 0x00: case 0x01: case 0x03: case 0x12: case 0x13: case 0x14:
+				next[p] = p + 1;
+				end[p] = end[p + 1];
+				break;
+		}
+	}
+
+	// Positions known to be the start of a code
+	vector<bool> start(size + 1, false);
+	vector<unsigned int> labels;
+	start[0] = true;
+	for(vector<Anchor*>::const_iterator it = chunk.anchors.begin(); it != chunk.anchors.end(); ++it) {
+		int p = (*it)->GetPosition();
+		if(p >= 0 && p <= (int)size) {
+			start[p] = true;
+			labels.push_back(p);
+		}
+	}
+	std::sort(labels.begin(), labels.end());
+
+	for(unsigned int p = 0; p < size; ++p) {
+		if(jumpat[p] >= 0)
+			start[p] = true;
+		if(chunk.cinfo[p] && !covered[p])
+			start[p + 1] = true;
+		if(start[p] && next[p])
+			start[next[p]] = true;
+	}
+
+	for(unsigned int p = 0; p < size; )
+	{
+		if(!start[p] || !end[p]) {
+			++p;
+			continue;
+		}
+
+		Run run;
+		run.start = p;
+		run.end = end[p];
+
+		vector<unsigned int>::const_iterator label = lower_bound(labels.begin(), labels.end(), run.end);
+		run.lastlabel = (label != labels.begin() && *(label - 1) > p) ? *(label - 1) : p;
+
+		for(unsigned int q = p; q < run.end; q = next[q]) {
+			run.steps.push_back(q);
+			run.jumps.push_back(jumpat[q]);
+		}
+
+		// Jumps are hashed by their kind and target, since their operands
+		// aren't filled in yet
+		run.hashes.resize(run.steps.size());
+		unsigned long long h = Fnv1a64(NULL, 0);
+		for(unsigned int i = run.steps.size(); i-- > 0; ) {
+			if(run.jumps[i] >= 0) {
+				const ByteChunk::Reference& r = refs[run.jumps[i]];
+				h = Fnv1a64(reinterpret_cast<const char*>(&r.jump), sizeof(r.jump), h);
+				h = Fnv1a64(reinterpret_cast<const char*>(&r.target), sizeof(r.target), h);
+			}
+			else
+				h = Fnv1a64(reinterpret_cast<const char*>(&bytes[run.steps[i]]), 1, h);
+			run.hashes[i] = h;
+		}
+
+		runs.push_back(run);
+		p = run.end;
+	}
+}
+
+/*
+ * Returns true if two runs are the same from the given codes to their ends
+ */
+bool TailMerger::Same(const ByteChunk& a, const Run& ra, unsigned int ia,
+	const ByteChunk& b, const Run& rb, unsigned int ib)
+{
+	unsigned int starta = ra.steps[ia];
+	unsigned int startb = rb.steps[ib];
+	unsigned int len = ra.end - starta;
+
+	if(rb.end - startb != len || ra.steps.size() - ia != rb.steps.size() - ib)
+		return false;
+	if(memcmp(&a.bytes[starta], &b.bytes[startb], len) != 0)
+		return false;
+
+	for(unsigned int i = ia, j = ib; i < ra.steps.size(); ++i, ++j)
+	{
+		if(ra.steps[i] - starta != rb.steps[j] - startb)
+			return false;
+		if((ra.jumps[i] < 0) != (rb.jumps[j] < 0))
+			return false;
+		if(ra.jumps[i] >= 0) {
+			const ByteChunk::Reference& x = a.refs[ra.jumps[i]];
+			const ByteChunk::Reference& y = b.refs[rb.jumps[j]];
+			if(x.jump != y.jump || x.target != y.target)
+				return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,38 @@
+/* merging of identical text across modules */
+#pragma once
+
+#include <vector>
+
+class ByteChunk;
+
+// Finds runs of text that are repeated in the generated code, within or
+// across modules, and replaces all but the first copy of each with a jump
+// to it. Runs are matched by their ends, so two blocks of text that only
+// end the same way share a single copy of their common tail.
+//
+// A run is a sequence of text characters, the simple text control codes
+// [00] [01] [03] [12] [13] and [14], and jumps and calls the compiler
+// generated itself, ending with an [02] or a goto -- anything after which
+// control doesn't fall through to the next byte. Runs are only followed from
+// places known to be the start of a code: labels, and the bytes after
+// text characters and generated jumps. Any other control code ends the
+// search, since its length isn't known. A copy is only replaced from a
+// point after the last label inside it, so every label stays in place.
+//
+// Copies are found by hashing each run's suffixes from its end backwards,
+// with generated jumps hashed by their kind and target instead of their
+// bytes, so that a match is found in time linear in the size of the code.
+class TailMerger
+{
+public:
+	// Merges the text in the given chunks, adding anchors and references
+	// between them as needed. Returns the number of bytes removed from each.
+	static std::vector<unsigned int> Merge(const std::vector<ByteChunk*>& chunks);
+
+private:
+	struct Run;
+
+	static void FindRuns(const ByteChunk& chunk, std::vector<Run>& runs);
+	static bool Same(const ByteChunk& a, const Run& ra, unsigned int ia,
+		const ByteChunk& b, const Run& rb, unsigned int ib);
+};
@@ -1,423 +1,1000 @@
-///////////////////////////////////////////////////////////////////////////////
-// test.cpp
-
-#include "test.h"
-#include <sstream>
-#include <stdexcept>
-#include <stdio.h>
-#include <stdlib.h>
-
-#ifdef WIN32
-#define popen _popen
-#define pclose _pclose
-#endif
-
-#include "consolecolor.h"
-
-using namespace std;
-
-// Test construction
-
-Test::Test(const string& filename, const string& compiler, const string& testpath, ostream& log)
-	: filename(filename), compiler(compiler), testpath(testpath), log(log)
-{
-	string filepath = testpath + filename;
-	ifstream file(filepath.c_str());
-
-	if(file.fail())
-		throw runtime_error("failed to open '" + filepath + "'");
-
-	// Get all the metadata lines from the file
-	vector<string> lines;
-	while(!file.eof()) {
-		string s;
-		getline(file, s);
-		if(s.substr(0, 3) == "///")
-			lines.push_back(s.substr(3));
-		else if(s.length() > 0)
-			break;
-	}
-	file.close();
-
-	// Parse out metadata
-	// NOTE: this is ugly but it works.
-	string expectline;
-	bool folding_expect = false;
-	for(vector<string>::iterator i = lines.begin(); i != lines.end(); ++i)
-	{
-		const string& line = *i;
-
-		// The "expect" data is allowed to bleed into multiple lines for convenience
-		if(folding_expect) {
-			if(!line.empty() && line.substr(0,1) == "@") {
-				folding_expect = false;
-			}
-			else {
-				expectline += line;
-				continue;
-			}
-		}
-
-		if(line.substr(0,6) == "@name:") {
-			name = line.substr(6);
-		}
-		else if(line.substr(0,6) == "@desc:") {
-			desc = line.substr(6);
-		}
-		else if(line.substr(0,6) == "@file:") {
-			compilation_file = line.substr(6);
-		}
-		else if(line.substr(0,6) == "@addr:") {
-			address = line.substr(6);
-		}
-		else if(line.substr(0,8) == "@expect:") {
-			expectline = line.substr(8);
-			folding_expect = true;
-		}
-	}
-
-	// Trim whitespace
-	name.erase(0, name.find_first_not_of(" \t\r\n"));
-	desc.erase(0, desc.find_first_not_of(" \t\r\n"));
-
-	address.erase(0, address.find_first_not_of(" \t\r\n"));
-
-	compilation_file.erase(0, compilation_file.find_first_not_of(" \t\r\n"));
-	compilation_file.erase(compilation_file.find_last_not_of(" \t\r\n") + 1);
-
-	expectline.erase(0, expectline.find_first_not_of(" \t\r\n"));
-	expectline.erase(expectline.find_last_not_of(" \t\r\n") + 1);
-
-	if(address.empty())
-		address = "C00000";
-
-	if(expectline.empty()) {
-		throw runtime_error("no expected output data provided");
-	}
-
-	// Finally, convert the expect line into binary data
-	// -- either directly or through a file
-
-	// Assume that if the first character is not a quote mark that we want
-	// to interpret expectline as the filename of the binary data to load
-	if(expectline.at(0) != '"') {
-		expect_file = expectline;
-	}
-	else {
-		// Otherwise, we'll parse the text as follows: all text within matched
-		// quotes will be interpreted as direct string data, with text in
-		// brackets further interpreted as direct hex data.
-		ParseCompData(expectline);
-	}
-}
-
-
-
-
-
-//
-// Runs the test, logging useful output. Returns true if the test succeeded,
-// false otherwise.
-//
-bool Test::Run()
-{
-	log << "------------------------------------" << endl;
-	log << "Test name:          " << name << endl;
-	log << "Description:        " << desc << endl;
-	log << "Expected output:    ";
-	if(expect_file.empty()) log << "[listed in " << filename << "]" << endl;
-	else log << expect_file << endl;
-
-	//
-	// First, generate the compilation file
-	//
-	string outfile = CreateCompilationFile("output.tmp");
-
-	//
-	// Invoke the compiler with the desired options
-	//
-	string options = " --printCode -o " + outfile + " -s " + address;
-	string compiler_output;
-	int retval = RunCompiler(filename, options, compiler_output);
-
-	//
-	// If the compiler fails to run or returns an error...
-	//
-	if(retval) {
-		log << "Compile failure:" << endl;
-		log << compiler_output << endl << endl;
-		log << "Result: OMG TEST FAILURED" << endl << endl << endl;
-		return false;
-	}
-
-
-	//
-	// Finally, compare the contents of the output file to the expected data
-	//
-	vector<diff> diffs;
-	bool ok = CompareResults("output.tmp", diffs, 11);
-
-	if(ok)
-		log << endl << "Result: TEST PASSED" << endl << endl;
-	else {
-		log << "Expected output: " << endl;
-		log << expect_string << endl;
-		log << "Actual output: " << endl;
-		log << compiler_output << endl;
-		log << "Differences:" << endl;
-		log << "Address     Expected     Result     " << endl;
-		log << "------------------------------------" << endl;
-		for(unsigned int i = 0; i < diffs.size() && i < 10; ++i) {
-			log << setw(6) << setfill(' ') << setbase(16) << diffs[i].address << "       ";
-			log << setw(2) << setfill('0') << (int)diffs[i].expected << "          ";
-			log << setw(2) << setfill('0') << (int)diffs[i].result << endl;
-		}
-		if(diffs.size() > 10)
-			log << "More than 10 differences omitted..." << endl;
-		log << endl << "Result: OMG TEST FAILURED" << endl << endl;
-	}
-
-	log << endl;
-
-	return ok;
-}
-
-
-
-
-//
-// Creates the file into which the test script will be compiled
-//
-string Test::CreateCompilationFile(const string& name)
-{
-	// All test files go in the test directory
-	string file = testpath + name;
-
-	ofstream out(file.c_str(), ios::binary | ios::trunc);
-	if(out.fail())
-		throw fatal_error(string("couldn't create temporary compilation file ") + file);
-
-	if(compilation_file.empty()) {
-		out.seekp(0x6001ff, ios::beg);
-		out.put(0);
-	}
-	else {
-		string compfile = testpath + compilation_file;
-		ifstream in(compfile.c_str(), ios::binary);
-		if(in.fail())
-			throw runtime_error("couldn't open compilation file '" + compfile + "'");
-		out << in.rdbuf();
-		in.close();
-	}
-	out.close();
-
-	return file;
-}
-
-int Test::RunCompiler(const string &file, const string &options, string& output)
-{
-	string command = compiler + " " + testpath + file + " " + options;
-	log << "Command:            " << command << endl;
-	command += " 2>&1";
-
-	FILE* pipe = popen(command.c_str(), "r");
-
-	string compiler_output;
-	while(!feof(pipe)) {
-		// For some reason I keep getting one garbage character
-		// at the end of the stream
-		char c = fgetc(pipe);
-		if(!feof(pipe))
-			output += c;
-	}
-	
-	int retval = pclose(pipe);
-
-	return retval;
-}
-
-//
-// Checks the contents of the given file against expected results, storing
-// any differences in the diffs vector, up to maxdiffs differences.
-//
-bool Test::CompareResults(const string& filename, vector<diff>& diffs, unsigned int maxdiffs)
-{
-	bool failed = false;
-
-	string filepath = testpath + filename;
-
-	ifstream result(filepath.c_str(), ios::binary);
-	if(result.fail())
-		throw fatal_error("couldn't open output file " + filepath);
-
-	if(expect_file.empty()) {
-		// If we're comparing against the inline data, begin the comparison at 0x200
-		// (skip the header)
-		result.seekg(0x200, ios::beg);
-
-		istreambuf_iterator<char> eos;
-		istreambuf_iterator<char> result_it(result.rdbuf());
-		vector<unsigned char>::iterator expected_it = expect_data.begin();
-
-		while(result_it != eos && expected_it != expect_data.end())
-		{
-			unsigned char r = *result_it;
-			unsigned char e = *expected_it;
-
-			if(r != e) {
-				failed = true;
-				if(diffs.size() < maxdiffs+1)
-					diffs.push_back( diff( result.tellg(), r, e ) );
-				else
-					break;
-			}
-			++result_it;
-			++expected_it;
-		}
-	}
-	else
-	{
-		// Otherwise compare the whole file, as far as it goes
-		string inpath = testpath + expect_file;
-		ifstream expected(inpath.c_str(), ios::binary);
-		if(expected.fail())
-			throw runtime_error("couldn't open expected results file " + inpath);
-
-		istreambuf_iterator<char> eos;
-		istreambuf_iterator<char> result_it( result.rdbuf() );
-		istreambuf_iterator<char> expect_it( expected.rdbuf() );
-
-		while(result_it != eos && expect_it != eos)
-		{
-			unsigned char r = *result_it;
-			unsigned char e = *expect_it;
-			if(r != e) {
-				failed = true;
-				if( diffs.size() < maxdiffs+1 )
-					diffs.push_back( diff( result.tellg(), r, e ) );
-				else 
-					break;
-			}
-			++result_it;
-			++expect_it;
-		}
-	}
-	return !failed;
-}
-
-
-
-//
-// Private methods for parsing the "expected output" from the metadata fields
-//
-void Test::ParseCompData(const string& str)
-{
-	State state = scanning;
-	string::const_iterator i = str.begin();
-	while(state != done) {
-		switch(state) {
-			case in_quote:
-				state = DoString(str, i);
-				break;
-			case in_code:
-				state = DoCode(str, i);
-				break;
-			case scanning:
-				state = DoScan(str, i);
-				break;
-			case done:
-				break;
-		}
-	}
-}
-
-
-Test::State Test::DoString(const string& str, string::const_iterator& i)
-{
-	// We should not find the end of the string before finding an endquote
-	if(i == str.end())
-		throw runtime_error("unexpected end of data before terminating '\"'");
-
-	char c = *i;
-	++i;
-
-	if(c == '"')
-		return scanning;
-	if(c == '[') {
-		if(!expect_string.empty() && *(expect_string.end()-1) == ']') {
-			expect_string.erase(expect_string.end()-1);
-			expect_string += ' ';
-		}
-		else
-			expect_string += '[';
-		return in_code;
-	}
-
-	// Emit character and continue
-	expect_data.push_back(c + 0x30);
-	expect_string += c;
-
-	return in_quote;
-}
-
-Test::State Test::DoCode(const string& str, string::const_iterator& i)
-{
-	// We shouldn't find the end of the string before a closing bracket is reached
-	if(i == str.end())
-		throw runtime_error("unexpected end of data before terminating ']'");
-	if(*i == '"')
-		throw runtime_error("unexpected '\"' in code segment");
-
-	char byte[3] = {0, 0, 0};
-
-	// consume leading whitespace
-	while(isspace(*i))
-		++i;
-
-	if(*i == ']') {
-		++i;
-		if(!expect_string.empty() && *(expect_string.end()-1) == ' ')
-			expect_string.erase(expect_string.end()-1);
-		expect_string += ']';
-		return in_quote;
-	}
-
-	char c = *i;
-
-	// The next two characters must be hex digits
-	for(int j = 0; j < 2; ++j) {
-		if(!isxdigit(c)) {
-			if(isspace(c) || c == ']')
-				throw runtime_error(string("invalid hex sequence '") + byte + "': must have two digits");
-			else
-				throw runtime_error(string("unexpected character '") + c + "' in code segment");
-		}
-
-		byte[j] = c;
-		++i; c = *i;
-	}
-
-	expect_data.push_back((unsigned char)strtoul(byte, NULL, 16));
-	expect_string += byte;
-	expect_string += " ";
-
-	return in_code;
-}
-
-Test::State Test::DoScan(const string& str, string::const_iterator& i)
-{
-	if(i == str.end())
-		return done;
-
-	char c = *i;
-
-	++i;
-
-	if(isspace(c))
-		return scanning;
-	if(c == '"')
-		return in_quote;
-
-	// Any other character when scanning is an error
-	throw runtime_error(string("unexpected character: '") + c + "'");
-}
+///////////////////////////////////////////////////////////////////////////////
+// test.cpp
+
+#include "test.h"
+#include <algorithm>
+#include <iterator>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+#include "consolecolor.h"
+
+using namespace std;
+
+// Test construction
+
+Test::Test(const string& filename, const string& compiler, const string& testpath, ostream& log)
+	: filename(filename), compiler(compiler), testpath(testpath), fresh(false), log(log)
+{
+	string filepath = testpath + filename;
+	ifstream file(filepath.c_str());
+
+	if(file.fail())
+		throw runtime_error("failed to open '" + filepath + "'");
+
+	// Get all the metadata lines from the file
+	vector<string> lines;
+	vector<string> rebuildlines;
+	vector<string> containslines;
+	vector<string> lineslines;
+	while(!file.eof()) {
+		string s;
+		getline(file, s);
+		if(s.substr(0, 3) == "///")
+			lines.push_back(s.substr(3));
+		else if(s.length() > 0)
+			break;
+	}
+	file.close();
+
+	// Parse out metadata
+	// NOTE: this is ugly but it works.
+	string expectline;
+	bool folding_expect = false;
+	for(vector<string>::iterator i = lines.begin(); i != lines.end(); ++i)
+	{
+		const string& line = *i;
+
+		// The "expect" data is allowed to bleed into multiple lines for convenience
+		if(folding_expect) {
+			if(!line.empty() && line.substr(0,1) == "@") {
+				folding_expect = false;
+			}
+			else {
+				expectline += line;
+				continue;
+			}
+		}
+
+		if(line.substr(0,6) == "@name:") {
+			name = line.substr(6);
+		}
+		else if(line.substr(0,6) == "@desc:") {
+			desc = line.substr(6);
+		}
+		else if(line.substr(0,6) == "@file:") {
+			compilation_file = line.substr(6);
+		}
+		else if(line.substr(0,7) == "@start:") {
+			address = line.substr(7);
+		}
+		else if(line.substr(0,9) == "@options:") {
+			flags = line.substr(9);
+		}
+		else if(line.substr(0,9) == "@rebuild:") {
+			rebuildlines.push_back(line.substr(9));
+		}
+		else if(line.substr(0,8) == "@damage:") {
+			damage = line.substr(8);
+		}
+		else if(line.substr(0,6) == "@fresh") {
+			fresh = true;
+		}
+		else if(line.substr(0,7) == "@error:") {
+			expect_error = line.substr(7);
+		}
+		else if(line.substr(0,9) == "@warning:") {
+			expect_warnings.push_back(line.substr(9));
+		}
+		else if(line.substr(0,8) == "@output:") {
+			expect_output.push_back(line.substr(8));
+		}
+		else if(line.substr(0,10) == "@contains:") {
+			containslines.push_back(line.substr(10));
+		}
+		else if(line.substr(0,7) == "@lines:") {
+			lineslines.push_back(line.substr(7));
+		}
+		else if(line.substr(0,7) == "@patch:") {
+			istringstream formats(line.substr(7));
+			string format;
+			while(formats >> format) {
+				if(format != "ips" && format != "bps")
+					throw runtime_error("unknown patch format '" + format + "'");
+				patch_formats.push_back(format);
+			}
+		}
+		else if(line.substr(0,8) == "@expect:") {
+			expectline = line.substr(8);
+			folding_expect = true;
+		}
+	}
+
+	// Trim whitespace
+	name.erase(0, name.find_first_not_of(" \t\r\n"));
+	desc.erase(0, desc.find_first_not_of(" \t\r\n"));
+
+	address.erase(0, address.find_first_not_of(" \t\r\n"));
+	address.erase(address.find_last_not_of(" \t\r\n") + 1);
+
+	flags.erase(0, flags.find_first_not_of(" \t\r\n"));
+	flags.erase(flags.find_last_not_of(" \t\r\n") + 1);
+
+	ExpandPaths(flags);
+
+	// A rebuild is a script, and options to use instead of the test's own
+	for(vector<string>::iterator i = rebuildlines.begin(); i != rebuildlines.end(); ++i) {
+		istringstream in(*i);
+		string script, options;
+		in >> script;
+		getline(in, options);
+		options.erase(0, options.find_first_not_of(" \t\r\n"));
+		options.erase(options.find_last_not_of(" \t\r\n") + 1);
+		if(options.empty())
+			options = flags;
+		else
+			ExpandPaths(options);
+		rebuilds.push_back(make_pair(script, options));
+	}
+
+	// A file check is the suffix of a file, and what to look for in it
+	for(vector<string>::iterator i = containslines.begin(); i != containslines.end(); ++i)
+		expect_contents.push_back(SplitFileCheck(*i));
+	for(vector<string>::iterator i = lineslines.begin(); i != lineslines.end(); ++i)
+		expect_lines.push_back(SplitFileCheck(*i));
+
+	damage.erase(0, damage.find_first_not_of(" \t\r\n"));
+	damage.erase(damage.find_last_not_of(" \t\r\n") + 1);
+
+	expect_error.erase(0, expect_error.find_first_not_of(" \t\r\n"));
+	expect_error.erase(expect_error.find_last_not_of(" \t\r\n") + 1);
+
+	for(vector<string>::iterator i = expect_warnings.begin(); i != expect_warnings.end(); ++i) {
+		i->erase(0, i->find_first_not_of(" \t\r\n"));
+		i->erase(i->find_last_not_of(" \t\r\n") + 1);
+	}
+	for(vector<string>::iterator i = expect_output.begin(); i != expect_output.end(); ++i) {
+		i->erase(0, i->find_first_not_of(" \t\r\n"));
+		i->erase(i->find_last_not_of(" \t\r\n") + 1);
+	}
+
+	compilation_file.erase(0, compilation_file.find_first_not_of(" \t\r\n"));
+	compilation_file.erase(compilation_file.find_last_not_of(" \t\r\n") + 1);
+
+	expectline.erase(0, expectline.find_first_not_of(" \t\r\n"));
+	expectline.erase(expectline.find_last_not_of(" \t\r\n") + 1);
+
+	if(address.empty())
+		address = "C00000";
+
+	if(expectline.empty()) {
+		throw runtime_error("no expected output data provided");
+	}
+
+	// Finally, convert the expect line into binary data
+	// -- either directly or through a file
+
+	// Assume that if the first character is not a quote mark that we want
+	// to interpret expectline as the filename of the binary data to load
+	if(expectline.at(0) != '"') {
+		expect_file = expectline;
+	}
+	else {
+		// Otherwise, we'll parse the text as follows: all text within matched
+		// quotes will be interpreted as direct string data, with text in
+		// brackets further interpreted as direct hex data.
+		ParseCompData(expectline);
+	}
+}
+
+
+
+
+
+//
+// Runs the test, logging useful output. Returns true if the test succeeded,
+// false otherwise.
+//
+bool Test::Run()
+{
+	log << "------------------------------------" << endl;
+	log << "Test name:          " << name << endl;
+	log << "Description:        " << desc << endl;
+	log << "Expected output:    ";
+	if(expect_file.empty()) log << "[listed in " << filename << "]" << endl;
+	else log << expect_file << endl;
+
+	//
+	// First, generate the compilation file
+	//
+	string outfile = CreateCompilationFile("output.tmp");
+
+	// Files left by an earlier test mustn't be taken for this one's
+	for(unsigned int i = 0; i < expect_contents.size(); ++i)
+		remove((outfile + expect_contents[i].first).c_str());
+	for(unsigned int i = 0; i < expect_lines.size(); ++i)
+		remove((outfile + expect_lines[i].first).c_str());
+
+	//
+	// Build the test with the desired options, and then each rebuild in
+	// turn onto the same file
+	//
+	vector<pair<string, string> > builds(1, make_pair(filename, flags));
+	builds.insert(builds.end(), rebuilds.begin(), rebuilds.end());
+
+	string compiler_output;
+	for(unsigned int i = 0; i < builds.size(); ++i)
+	{
+		if(i > 0 && !damage.empty() && !DamageFile("output.tmp" + damage)) {
+			log << "Result: OMG TEST FAILURED" << endl << endl << endl;
+			return false;
+		}
+
+		compiler_output.clear();
+		int retval = RunCompiler(builds[i].first, BuildOptions(outfile, builds[i].second), compiler_output);
+
+		//
+		// The last build may be expected to fail, leaving the file as it was
+		//
+		if(i + 1 == builds.size() && !expect_error.empty()) {
+			if(!retval || compiler_output.find(expect_error) == string::npos) {
+				log << "Expected an error containing \"" << expect_error << "\", but got:" << endl;
+				log << compiler_output << endl << endl;
+				log << "Result: OMG TEST FAILURED" << endl << endl << endl;
+				return false;
+			}
+			log << "Error reported as expected" << endl;
+			continue;
+		}
+
+		//
+		// If the compiler fails to run or returns an error...
+		//
+		if(retval) {
+			log << "Compile failure:" << endl;
+			log << compiler_output << endl << endl;
+			log << "Result: OMG TEST FAILURED" << endl << endl << endl;
+			return false;
+		}
+	}
+
+	//
+	// Then check that the last build printed what it should have
+	//
+	if(!CheckOutput(compiler_output)) {
+		log << compiler_output << endl << endl;
+		log << "Result: OMG TEST FAILURED" << endl << endl << endl;
+		return false;
+	}
+
+	//
+	// And the files it wrote next to the output
+	//
+	if(!CheckFiles()) {
+		log << "Result: OMG TEST FAILURED" << endl << endl << endl;
+		return false;
+	}
+
+
+	//
+	// Finally, compare the contents of the output file to the expected data
+	//
+	vector<diff> diffs;
+	bool ok = CompareResults("output.tmp", diffs, 11);
+
+	if(ok) {
+		//
+		// Check that each patch asked for does the same as the direct build
+		//
+		for(unsigned int i = 0; i < patch_formats.size(); ++i) {
+			if(!CheckPatch(patch_formats[i]))
+				ok = false;
+		}
+
+		if(fresh && !CheckFresh(builds.back().first, builds.back().second))
+			ok = false;
+
+		if(ok)
+			log << endl << "Result: TEST PASSED" << endl << endl;
+		else
+			log << endl << "Result: OMG TEST FAILURED" << endl << endl;
+	}
+	else {
+		log << "Expected output: " << endl;
+		log << expect_string << endl;
+		log << "Actual output: " << endl;
+		log << compiler_output << endl;
+		log << "Differences:" << endl;
+		log << "Address     Expected     Result     " << endl;
+		log << "------------------------------------" << endl;
+		for(unsigned int i = 0; i < diffs.size() && i < 10; ++i) {
+			log << setw(6) << setfill(' ') << setbase(16) << diffs[i].address << "       ";
+			log << setw(2) << setfill('0') << (int)diffs[i].expected << "          ";
+			log << setw(2) << setfill('0') << (int)diffs[i].result << endl;
+		}
+		if(diffs.size() > 10)
+			log << "More than 10 differences omitted..." << endl;
+		log << endl << "Result: OMG TEST FAILURED" << endl << endl;
+	}
+
+	log << endl;
+
+	return ok;
+}
+
+
+
+
+//
+// Checks that the compiler printed each expected text, and gave a warning
+// containing each expected warning, or no warnings at all if "none" is
+// expected. Logs any that are missing.
+//
+bool Test::CheckOutput(const string& output)
+{
+	vector<string> warnings;
+	istringstream in(output);
+	string line;
+	while(getline(in, line)) {
+		if(line.find("warning:") != string::npos)
+			warnings.push_back(line);
+	}
+
+	bool ok = true;
+	for(vector<string>::const_iterator i = expect_output.begin(); i != expect_output.end(); ++i)
+	{
+		if(output.find(*i) == string::npos) {
+			log << "Expected output containing \"" << *i << "\", but got:" << endl;
+			ok = false;
+		}
+	}
+
+	for(vector<string>::const_iterator i = expect_warnings.begin(); i != expect_warnings.end(); ++i)
+	{
+		if(*i == "none") {
+			if(!warnings.empty()) {
+				log << "Expected no warnings, but got:" << endl;
+				ok = false;
+			}
+			continue;
+		}
+
+		vector<string>::const_iterator w = warnings.begin();
+		while(w != warnings.end() && w->find(*i) == string::npos)
+			++w;
+		if(w == warnings.end()) {
+			log << "Expected a warning containing \"" << *i << "\", but got:" << endl;
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+//
+// Splits a file check into the suffix of the file and the rest of the line
+//
+pair<string, string> Test::SplitFileCheck(const string& line)
+{
+	istringstream in(line);
+	string suffix, rest;
+	in >> suffix;
+	getline(in, rest);
+	rest.erase(0, rest.find_first_not_of(" \t\r\n"));
+	rest.erase(rest.find_last_not_of(" \t\r\n") + 1);
+	if(suffix.empty() || rest.empty())
+		throw runtime_error("bad file check '" + line + "'");
+	return make_pair(suffix, rest);
+}
+
+//
+// Checks the files the compiler wrote next to the output: that each
+// contains the text expected in it, and that every line of each matches
+// the pattern expected for its lines. Logs any that don't.
+//
+bool Test::CheckFiles()
+{
+	bool ok = true;
+	for(unsigned int i = 0; i < expect_contents.size(); ++i)
+	{
+		string name = "output.tmp" + expect_contents[i].first;
+		vector<unsigned char> data = ReadFile(name);
+		if(string(data.begin(), data.end()).find(expect_contents[i].second) == string::npos) {
+			log << "Expected " << name << " to contain \"" << expect_contents[i].second << "\"" << endl;
+			ok = false;
+		}
+	}
+
+	for(unsigned int i = 0; i < expect_lines.size(); ++i)
+	{
+		string name = "output.tmp" + expect_lines[i].first;
+		vector<unsigned char> data = ReadFile(name);
+		istringstream in(string(data.begin(), data.end()));
+		regex pattern(expect_lines[i].second);
+
+		string line;
+		for(int n = 1; getline(in, line); ++n) {
+			if(!line.empty() && line[line.size() - 1] == '\r')
+				line.erase(line.size() - 1);
+			if(!regex_match(line, pattern)) {
+				log << "Line " << n << " of " << name << " doesn't match \"" << expect_lines[i].second << "\":" << endl;
+				log << line << endl;
+				ok = false;
+				break;
+			}
+		}
+	}
+	return ok;
+}
+
+//
+// Creates the file into which the test script will be compiled
+//
+string Test::CreateCompilationFile(const string& name)
+{
+	// All test files go in the test directory
+	string file = testpath + name;
+
+	ofstream out(file.c_str(), ios::binary | ios::trunc);
+	if(out.fail())
+		throw fatal_error(string("couldn't create temporary compilation file ") + file);
+
+	// A fresh file has no previous build for the compiler to undo or reuse
+	remove((file + ".reset").c_str());
+	remove((file + ".build").c_str());
+
+	if(compilation_file.empty()) {
+		out.seekp(0x6001ff, ios::beg);
+		out.put(0);
+	}
+	else {
+		string compfile = testpath + compilation_file;
+		ifstream in(compfile.c_str(), ios::binary);
+		if(in.fail())
+			throw runtime_error("couldn't open compilation file '" + compfile + "'");
+		out << in.rdbuf();
+		in.close();
+	}
+	out.close();
+
+	return file;
+}
+
+//
+// Replaces "{testpath}" in options with the path of the test directory, so
+// that files next to the test case can be named
+//
+void Test::ExpandPaths(string& options) const
+{
+	for(string::size_type p = options.find("{testpath}"); p != string::npos; p = options.find("{testpath}", p))
+	{
+		options.replace(p, 10, testpath);
+		p += testpath.size();
+	}
+}
+
+//
+// Returns the command-line options for a build into the given file
+//
+string Test::BuildOptions(const string& outfile, const string& buildflags) const
+{
+	string options = " --printCode -o " + outfile + " -s " + address;
+	if(!buildflags.empty())
+		options += " " + buildflags;
+	return options;
+}
+
+//
+// Damages a file in the test directory by flipping a byte in the middle of
+// it. Returns false if there's no such file.
+//
+bool Test::DamageFile(const string& name)
+{
+	string file = testpath + name;
+	fstream f(file.c_str(), ios::binary | ios::in | ios::out);
+	if(f.fail()) {
+		log << "Couldn't damage " << file << ": it wasn't written" << endl;
+		return false;
+	}
+
+	f.seekg(0, ios::end);
+	streamoff middle = f.tellg() / 2;
+
+	char c;
+	f.seekg(middle);
+	f.get(c);
+	f.seekp(middle);
+	f.put(~c);
+
+	log << "Damaged:            " << file << endl;
+	return true;
+}
+
+int Test::RunCompiler(const string &file, const string &options, string& output)
+{
+	string command = compiler + " " + testpath + file + " " + options;
+	log << "Command:            " << command << endl;
+	command += " 2>&1";
+
+	FILE* pipe = popen(command.c_str(), "r");
+
+	string compiler_output;
+	while(!feof(pipe)) {
+		// For some reason I keep getting one garbage character
+		// at the end of the stream
+		char c = fgetc(pipe);
+		if(!feof(pipe))
+			output += c;
+	}
+	
+	int retval = pclose(pipe);
+
+	return retval;
+}
+
+//
+// Checks the contents of the given file against expected results, storing
+// any differences in the diffs vector, up to maxdiffs differences.
+//
+bool Test::CompareResults(const string& filename, vector<diff>& diffs, unsigned int maxdiffs)
+{
+	bool failed = false;
+
+	string filepath = testpath + filename;
+
+	ifstream result(filepath.c_str(), ios::binary);
+	if(result.fail())
+		throw fatal_error("couldn't open output file " + filepath);
+
+	if(expect_file.empty()) {
+		// If we're comparing against the inline data, begin the comparison at
+		// the start address, which for the default of $C00000 is 0x200 (just
+		// past the header)
+		unsigned long offset = strtoul(address.c_str(), NULL, 16) - 0xC00000 + 0x200;
+		result.seekg(offset, ios::beg);
+
+		istreambuf_iterator<char> eos;
+		istreambuf_iterator<char> result_it(result.rdbuf());
+		vector<unsigned char>::iterator expected_it = expect_data.begin();
+
+		while(result_it != eos && expected_it != expect_data.end())
+		{
+			unsigned char r = *result_it;
+			unsigned char e = *expected_it;
+
+			if(r != e) {
+				failed = true;
+				if(diffs.size() < maxdiffs+1)
+					diffs.push_back( diff( result.tellg(), r, e ) );
+				else
+					break;
+			}
+			++result_it;
+			++expected_it;
+		}
+	}
+	else
+	{
+		// Otherwise compare the whole file, as far as it goes
+		string inpath = testpath + expect_file;
+		ifstream expected(inpath.c_str(), ios::binary);
+		if(expected.fail())
+			throw runtime_error("couldn't open expected results file " + inpath);
+
+		istreambuf_iterator<char> eos;
+		istreambuf_iterator<char> result_it( result.rdbuf() );
+		istreambuf_iterator<char> expect_it( expected.rdbuf() );
+
+		while(result_it != eos && expect_it != eos)
+		{
+			unsigned char r = *result_it;
+			unsigned char e = *expect_it;
+			if(r != e) {
+				failed = true;
+				if( diffs.size() < maxdiffs+1 )
+					diffs.push_back( diff( result.tellg(), r, e ) );
+				else 
+					break;
+			}
+			++result_it;
+			++expect_it;
+		}
+	}
+	return !failed;
+}
+
+
+
+//
+// Builds the test again, having the compiler write a patch of the given
+// format instead of changing the ROM, and checks that the patch applied to
+// the original compilation file gives the same file as the direct build.
+//
+bool Test::CheckPatch(const string& format)
+{
+	string patchname = "output.tmp." + format;
+	string outfile = CreateCompilationFile("output.patch.tmp");
+
+	string options = BuildOptions(outfile, flags) + " --patch " + testpath + patchname;
+	string compiler_output;
+	int retval = RunCompiler(filename, options, compiler_output);
+	if(retval) {
+		log << "Compile failure writing " << format << " patch:" << endl;
+		log << compiler_output << endl << endl;
+		return false;
+	}
+
+	vector<unsigned char> patched, direct;
+	try {
+		patched = ReadFile("output.patch.tmp");
+		direct = ReadFile("output.tmp");
+
+		vector<unsigned char> patch = ReadFile(patchname);
+		if(format == "ips")
+			ApplyIPS(patch, patched);
+		else
+			ApplyBPS(patch, patched);
+	}
+	catch(runtime_error& e) {
+		log << "Couldn't apply " << format << " patch: " << e.what() << endl;
+		return false;
+	}
+
+	if(patched == direct) {
+		log << "Patch (" << format << ") gives the same file as the direct build" << endl;
+		return true;
+	}
+
+	log << "Patch (" << format << ") gives a different file from the direct build:" << endl;
+	return CompareFiles(direct, patched);
+}
+
+//
+// Builds the last build's script again with its options, onto a new
+// compilation file with no previous build to undo or reuse, and checks
+// that the result is the same file as the one the test's builds left.
+//
+bool Test::CheckFresh(const string& script, const string& buildflags)
+{
+	string outfile = CreateCompilationFile("output.fresh.tmp");
+
+	string compiler_output;
+	int retval = RunCompiler(script, BuildOptions(outfile, buildflags), compiler_output);
+	if(retval) {
+		log << "Compile failure in the fresh build:" << endl;
+		log << compiler_output << endl << endl;
+		return false;
+	}
+
+	vector<unsigned char> built, rebuilt;
+	try {
+		built = ReadFile("output.fresh.tmp");
+		rebuilt = ReadFile("output.tmp");
+	}
+	catch(runtime_error& e) {
+		log << "Couldn't compare with the fresh build: " << e.what() << endl;
+		return false;
+	}
+
+	if(built == rebuilt) {
+		log << "Rebuilt file is the same as a fresh build" << endl;
+		return true;
+	}
+
+	log << "Rebuilt file differs from a fresh build:" << endl;
+	return CompareFiles(built, rebuilt);
+}
+
+//
+// Logs the differences between two whole files. Returns true if there are
+// none.
+//
+bool Test::CompareFiles(const vector<unsigned char>& expected, const vector<unsigned char>& result)
+{
+	if(expected == result)
+		return true;
+
+	if(result.size() != expected.size())
+		log << "Size is " << result.size() << " instead of " << expected.size() << endl;
+	log << "Offset      Expected     Result     " << endl;
+	log << "------------------------------------" << endl;
+	unsigned int count = 0;
+	for(unsigned int i = 0; i < result.size() && i < expected.size(); ++i) {
+		if(result[i] == expected[i])
+			continue;
+		if(++count > 10) {
+			log << "More than 10 differences omitted..." << endl;
+			break;
+		}
+		log << setw(6) << setfill(' ') << setbase(16) << i << "       ";
+		log << setw(2) << setfill('0') << (int)expected[i] << "           ";
+		log << setw(2) << setfill('0') << (int)result[i] << endl;
+	}
+	log << setbase(10) << setfill(' ');
+	return false;
+}
+
+//
+// Reads a whole file from the test directory
+//
+vector<unsigned char> Test::ReadFile(const string& name)
+{
+	string filepath = testpath + name;
+	ifstream in(filepath.c_str(), ios::binary);
+	if(in.fail())
+		throw runtime_error("couldn't open " + filepath);
+
+	return vector<unsigned char>(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+//
+// Applies an IPS patch. Records are a three-byte offset, a two-byte length
+// and the data, or for a length of zero, a two-byte count and a byte to
+// repeat; an offset of "EOF" ends the patch.
+//
+void Test::ApplyIPS(const vector<unsigned char>& patch, vector<unsigned char>& rom)
+{
+	if(patch.size() < 5 || string(patch.begin(), patch.begin() + 5) != "PATCH")
+		throw runtime_error("not an IPS patch");
+
+	unsigned int p = 5;
+	while(true) {
+		if(p + 3 > patch.size())
+			throw runtime_error("IPS patch ends without \"EOF\"");
+		unsigned int offset = patch[p] << 16 | patch[p + 1] << 8 | patch[p + 2];
+		p += 3;
+		if(offset == 0x454F46)
+			break;
+
+		if(p + 2 > patch.size())
+			throw runtime_error("IPS record is cut short");
+		unsigned int len = patch[p] << 8 | patch[p + 1];
+		p += 2;
+
+		if(len == 0) {
+			if(p + 3 > patch.size())
+				throw runtime_error("IPS record is cut short");
+			len = patch[p] << 8 | patch[p + 1];
+			if(offset + len > rom.size())
+				rom.resize(offset + len);
+			fill(rom.begin() + offset, rom.begin() + offset + len, patch[p + 2]);
+			p += 3;
+		}
+		else {
+			if(p + len > patch.size())
+				throw runtime_error("IPS record is cut short");
+			if(offset + len > rom.size())
+				rom.resize(offset + len);
+			copy(patch.begin() + p, patch.begin() + p + len, rom.begin() + offset);
+			p += len;
+		}
+	}
+
+	// Anything after "EOF" means a record was mistaken for the end
+	if(p != patch.size())
+		throw runtime_error("IPS patch has data after \"EOF\"");
+}
+
+static unsigned int Crc32(const unsigned char* data, size_t len)
+{
+	unsigned int crc = 0xFFFFFFFF;
+	for(size_t i = 0; i < len; ++i) {
+		crc ^= data[i];
+		for(int j = 0; j < 8; ++j)
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+	}
+	return ~crc;
+}
+
+static unsigned long long ReadBPSNumber(const vector<unsigned char>& patch, unsigned int& p, unsigned int end)
+{
+	unsigned long long n = 0, shift = 1;
+	while(true) {
+		if(p >= end)
+			throw runtime_error("BPS patch is cut short");
+		unsigned char x = patch[p++];
+		n += (x & 0x7F) * shift;
+		if(x & 0x80)
+			return n;
+		shift <<= 7;
+		n += shift;
+	}
+}
+
+static unsigned int ReadBPSInt(const vector<unsigned char>& patch, unsigned int p)
+{
+	return patch[p] | patch[p + 1] << 8 | patch[p + 2] << 16 | (unsigned int)patch[p + 3] << 24;
+}
+
+//
+// Applies a BPS patch, checking its source, target and patch checksums
+//
+void Test::ApplyBPS(const vector<unsigned char>& patch, vector<unsigned char>& rom)
+{
+	enum { SourceRead, TargetRead, SourceCopy, TargetCopy };
+
+	if(patch.size() < 16 || string(patch.begin(), patch.begin() + 4) != "BPS1")
+		throw runtime_error("not a BPS patch");
+
+	unsigned int end = patch.size() - 12;
+	if(Crc32(&patch[0], patch.size() - 4) != ReadBPSInt(patch, end + 8))
+		throw runtime_error("BPS patch checksum doesn't match");
+
+	unsigned int p = 4;
+	unsigned long long sourcesize = ReadBPSNumber(patch, p, end);
+	unsigned long long targetsize = ReadBPSNumber(patch, p, end);
+	p += ReadBPSNumber(patch, p, end);	// metadata
+
+	if(sourcesize != rom.size())
+		throw runtime_error("BPS source size doesn't match the ROM");
+	if(Crc32(&rom[0], rom.size()) != ReadBPSInt(patch, end))
+		throw runtime_error("BPS source checksum doesn't match the ROM");
+
+	vector<unsigned char> target(targetsize);
+	unsigned long long out = 0, sourcepos = 0, targetpos = 0;
+	while(p < end) {
+		unsigned long long action = ReadBPSNumber(patch, p, end);
+		unsigned long long len = (action >> 2) + 1;
+		if(out + len > targetsize)
+			throw runtime_error("BPS action writes past the end of the target");
+
+		switch(action & 3) {
+			case SourceRead:
+				if(out + len > rom.size())
+					throw runtime_error("BPS action reads past the end of the source");
+				copy(rom.begin() + out, rom.begin() + out + len, target.begin() + out);
+				break;
+			case TargetRead:
+				if(p + len > end)
+					throw runtime_error("BPS action is cut short");
+				copy(patch.begin() + p, patch.begin() + p + len, target.begin() + out);
+				p += len;
+				break;
+			case SourceCopy:
+			case TargetCopy: {
+				unsigned long long n = ReadBPSNumber(patch, p, end);
+				unsigned long long& pos = (action & 3) == SourceCopy ? sourcepos : targetpos;
+				pos = (n & 1) ? pos - (n >> 1) : pos + (n >> 1);
+				const vector<unsigned char>& from = (action & 3) == SourceCopy ? rom : target;
+				for(unsigned long long i = 0; i < len; ++i) {
+					if(pos >= from.size())
+						throw runtime_error("BPS action copies from past the end");
+					target[out + i] = from[pos++];
+				}
+				break;
+			}
+		}
+		out += len;
+	}
+
+	if(out != targetsize)
+		throw runtime_error("BPS patch doesn't fill the target");
+	if(Crc32(&target[0], target.size()) != ReadBPSInt(patch, end + 4))
+		throw runtime_error("BPS target checksum doesn't match");
+
+	rom.swap(target);
+}
+
+
+
+//
+// Private methods for parsing the "expected output" from the metadata fields
+//
+void Test::ParseCompData(const string& str)
+{
+	State state = scanning;
+	string::const_iterator i = str.begin();
+	while(state != done) {
+		switch(state) {
+			case in_quote:
+				state = DoString(str, i);
+				break;
+			case in_code:
+				state = DoCode(str, i);
+				break;
+			case scanning:
+				state = DoScan(str, i);
+				break;
+			case done:
+				break;
+		}
+	}
+}
+
+
+Test::State Test::DoString(const string& str, string::const_iterator& i)
+{
+	// We should not find the end of the string before finding an endquote
+	if(i == str.end())
+		throw runtime_error("unexpected end of data before terminating '\"'");
+
+	char c = *i;
+	++i;
+
+	if(c == '"')
+		return scanning;
+	if(c == '[') {
+		if(!expect_string.empty() && *(expect_string.end()-1) == ']') {
+			expect_string.erase(expect_string.end()-1);
+			expect_string += ' ';
+		}
+		else
+			expect_string += '[';
+		return in_code;
+	}
+
+	// Emit character and continue
+	expect_data.push_back(c + 0x30);
+	expect_string += c;
+
+	return in_quote;
+}
+
+Test::State Test::DoCode(const string& str, string::const_iterator& i)
+{
+	// We shouldn't find the end of the string before a closing bracket is reached
+	if(i == str.end())
+		throw runtime_error("unexpected end of data before terminating ']'");
+	if(*i == '"')
+		throw runtime_error("unexpected '\"' in code segment");
+
+	char byte[3] = {0, 0, 0};
+
+	// consume leading whitespace
+	while(isspace(*i))
+		++i;
+
+	if(*i == ']') {
+		++i;
+		if(!expect_string.empty() && *(expect_string.end()-1) == ' ')
+			expect_string.erase(expect_string.end()-1);
+		expect_string += ']';
+		return in_quote;
+	}
+
+	char c = *i;
+
+	// The next two characters must be hex digits
+	for(int j = 0; j < 2; ++j) {
+		if(!isxdigit(c)) {
+			if(isspace(c) || c == ']')
+				throw runtime_error(string("invalid hex sequence '") + byte + "': must have two digits");
+			else
+				throw runtime_error(string("unexpected character '") + c + "' in code segment");
+		}
+
+		byte[j] = c;
+		++i; c = *i;
+	}
+
+	expect_data.push_back((unsigned char)strtoul(byte, NULL, 16));
+	expect_string += byte;
+	expect_string += " ";
+
+	return in_code;
+}
+
+Test::State Test::DoScan(const string& str, string::const_iterator& i)
+{
+	if(i == str.end())
+		return done;
+
+	char c = *i;
+
+	++i;
+
+	if(isspace(c))
+		return scanning;
+	if(c == '"')
+		return in_quote;
+
+	// Any other character when scanning is an error
+	throw runtime_error(string("unexpected character: '") + c + "'");
+}
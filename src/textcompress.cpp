@@ -0,0 +1,354 @@
+/* dictionary compression of text implementation */
+
+#include "textcompress.h"
+
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+#include "anchor.h"
+#include "bytechunk.h"
+
+using namespace std;
+
+
+// An entry is printed by a two-byte code, so shorter substrings save nothing
+static const unsigned int CodeSize = 2;
+static const unsigned int MinLength = CodeSize + 1;
+
+/*
+ * Substrings that occur more than once in the same places: those with the
+ * lengths in [shortest, longest], whose occurrences are given by a range
+ * of the suffix array
+ */
+struct TextCompressor::Candidate {
+	int saving;			// bytes saved by the best length, as of when last counted
+	unsigned int length;	// the best length
+	unsigned int shortest;
+	unsigned int longest;
+	unsigned int first;
+	unsigned int last;
+
+	bool operator<(const Candidate& rhs) const { return saving < rhs.saving; }
+};
+
+/*
+ * Bytes saved by an entry of the given length that replaces text in the
+ * given number of places, including the cost of the entry and its [00]
+ */
+static int Saving(unsigned int length, unsigned int uses)
+{
+	return (int)(uses * (length - CodeSize)) - (int)(length + 1);
+}
+
+
+vector<TextCompressor::Entry> TextCompressor::Compress(const vector<ByteChunk*>& chunks,
+	unsigned int first, unsigned int entries)
+{
+	if(first >= MaxEntries)
+		return vector<Entry>();
+	entries = min(entries, MaxEntries - first);
+
+	// Gather every stretch of text into one string, keeping track of where
+	// each character came from. Each stretch ends with a separator that
+	// occurs nowhere else, so no repeated substring can span two of them.
+	vector<int> s;
+	vector<unsigned int> chunkof;
+	vector<unsigned int> posof;
+
+	for(unsigned int c = 0; c < chunks.size(); ++c)
+	{
+		const ByteChunk& chunk = *chunks[c];
+		vector<bool> text;
+		FindText(chunk, text);
+
+		vector<bool> label(chunk.GetSize() + 1, false);
+		for(vector<Anchor*>::const_iterator it = chunk.anchors.begin(); it != chunk.anchors.end(); ++it) {
+			int p = (*it)->GetPosition();
+			if(p >= 0 && p <= (int)chunk.GetSize())
+				label[p] = true;
+		}
+
+		bool open = false;
+		for(unsigned int p = 0; p < chunk.GetSize(); ++p)
+		{
+			if(open && (!text[p] || label[p])) {
+				s.push_back(-1);
+				open = false;
+			}
+			if(!text[p])
+				continue;
+
+			s.push_back(chunk.bytes[p]);
+			chunkof.push_back(c);
+			posof.push_back(p);
+			open = true;
+		}
+		if(open)
+			s.push_back(-1);
+	}
+
+	// Characters come after the separators, which are numbered in order
+	int separators = std::count(s.begin(), s.end(), -1);
+	for(unsigned int i = 0, next = 0; i < s.size(); ++i)
+		s[i] = (s[i] < 0) ? next++ : s[i] + separators;
+
+	// Which character each position in 's' is, for mapping back
+	vector<unsigned int> where(s.size(), 0);
+	for(unsigned int i = 0, j = 0; i < s.size(); ++i) {
+		if(s[i] >= separators)
+			where[i] = j++;
+	}
+
+	vector<int> sa, lcp;
+	SuffixArray(s, separators + 256, sa);
+	LongestCommonPrefixes(s, sa, lcp);
+
+	// Each LCP interval holds the occurrences of the substrings of lengths
+	// between its parent's LCP and its own
+	priority_queue<Candidate> candidates;
+	{
+		vector<pair<int, unsigned int> > stack;		// (lcp, first suffix)
+		stack.push_back(make_pair(0, 0));
+
+		for(unsigned int i = 1; i <= sa.size(); ++i)
+		{
+			int cur = (i < sa.size()) ? lcp[i] : 0;
+			unsigned int first = i - 1;
+
+			while(cur < stack.back().first) {
+				int depth = stack.back().first;
+				first = stack.back().second;
+				stack.pop_back();
+				int parent = max(cur, stack.back().first);
+
+				// Longer is better for the same occurrences, so the longest
+				// is counted first
+				unsigned int longest = min((unsigned int)depth, MaxLength);
+				unsigned int shortest = max((unsigned int)parent + 1, MinLength);
+				if(shortest <= longest) {
+					Candidate cand = { Saving(longest, i - first), longest, shortest, longest, first, i - 1 };
+					if(cand.saving > 0)
+						candidates.push(cand);
+				}
+			}
+			if(cur > stack.back().first)
+				stack.push_back(make_pair(cur, first));
+		}
+	}
+
+	// Take the best candidate each time. Its saving can only have gone down
+	// since it was counted, so it's recounted, at whichever of its lengths
+	// now saves the most; if it's still the best it's taken, otherwise it
+	// goes back for later.
+	vector<bool> replaced(s.size(), false);
+	vector<unsigned int> entrystart;			// where in 's' each entry was taken from
+	vector<unsigned int> entrylength;
+	vector<vector<unsigned int> > uses;			// where in 's' each entry replaces text
+	vector<unsigned int> places, free, found;
+
+	while(!candidates.empty() && entrystart.size() < entries)
+	{
+		Candidate cand = candidates.top();
+		candidates.pop();
+
+		places.assign(sa.begin() + cand.first, sa.begin() + cand.last + 1);
+		std::sort(places.begin(), places.end());
+
+		// How much of each occurrence is still there to be replaced
+		free.resize(places.size());
+		for(unsigned int i = 0; i < places.size(); ++i) {
+			unsigned int p = places[i];
+			while(p < places[i] + cand.longest && !replaced[p])
+				++p;
+			free[i] = p - places[i];
+		}
+
+		cand.saving = 0;
+		for(unsigned int length = cand.shortest; length <= cand.longest; ++length) {
+			unsigned int count = 0, next = 0;
+			for(unsigned int i = 0; i < places.size(); ++i) {
+				if(places[i] >= next && free[i] >= length) {
+					count++;
+					next = places[i] + length;
+				}
+			}
+			if(Saving(length, count) >= cand.saving) {
+				cand.saving = Saving(length, count);
+				cand.length = length;
+			}
+		}
+		if(cand.saving <= 0)
+			continue;
+		if(!candidates.empty() && cand.saving < candidates.top().saving) {
+			candidates.push(cand);
+			continue;
+		}
+
+		found.clear();
+		unsigned int next = 0;
+		for(unsigned int i = 0; i < places.size(); ++i) {
+			if(places[i] >= next && free[i] >= cand.length) {
+				found.push_back(places[i]);
+				next = places[i] + cand.length;
+			}
+		}
+
+		for(vector<unsigned int>::const_iterator it = found.begin(); it != found.end(); ++it)
+			std::fill(replaced.begin() + *it, replaced.begin() + *it + cand.length, true);
+		entrystart.push_back(found.front());
+		entrylength.push_back(cand.length);
+		uses.push_back(found);
+	}
+
+	vector<Entry> dictionary(entrystart.size());
+	vector<vector<pair<unsigned int, unsigned int> > > sites(chunks.size());	// (position, entry)
+	for(unsigned int e = 0; e < entrystart.size(); ++e)
+	{
+		for(unsigned int i = entrystart[e]; i < entrystart[e] + entrylength[e]; ++i)
+			dictionary[e].text.push_back(s[i] - separators);
+		dictionary[e].uses = uses[e].size();
+
+		for(vector<unsigned int>::const_iterator it = uses[e].begin(); it != uses[e].end(); ++it)
+			sites[chunkof[where[*it]]].push_back(make_pair(posof[where[*it]], e));
+	}
+
+	// Replace the text, which is always in consecutive bytes of one chunk
+	for(unsigned int c = 0; c < chunks.size(); ++c)
+	{
+		ByteChunk& chunk = *chunks[c];
+		std::sort(sites[c].begin(), sites[c].end());
+
+		vector<ByteChunk::Range> ranges;
+		for(vector<pair<unsigned int, unsigned int> >::const_iterator it = sites[c].begin();
+			it != sites[c].end(); ++it)
+		{
+			unsigned int p = it->first;
+			unsigned int code = first + it->second;
+			chunk.bytes[p] = 0x15 + code / 256;
+			chunk.bytes[p + 1] = code % 256;
+			chunk.cinfo[p] = false;
+			chunk.cinfo[p + 1] = false;
+			ranges.push_back(ByteChunk::Range(p + CodeSize, p + entrylength[it->second]));
+		}
+		chunk.Remove(ranges);
+	}
+
+	return dictionary;
+}
+
+/*
+ * Marks the bytes of a chunk that are text that can be compressed
+ */
+void TextCompressor::FindText(const ByteChunk& chunk, vector<bool>& text)
+{
+	const vector<unsigned char>& bytes = chunk.bytes;
+	unsigned int size = bytes.size();
+
+	text.assign(size, false);
+	for(unsigned int p = 0; p < size; ++p)
+		text[p] = chunk.cinfo[p];
+
+	// Bytes that belong to references are never text
+	for(vector<ByteChunk::Reference>::const_iterator it = chunk.refs.begin(); it != chunk.refs.end(); ++it) {
+		int first = max(it->location + it->offset, 0);
+		int last = min(it->location + it->offset + it->length, (int)size);
+		for(int p = first; p < last; ++p)
+			text[p] = false;
+	}
+
+	// Nor is a string being loaded into memory by [19 02]
+	for(unsigned int p = 0; p + 1 < size; ++p) {
+		if(bytes[p] != 0x19 || bytes[p + 1] != 0x02 || chunk.cinfo[p] || chunk.cinfo[p + 1])
+			continue;
+		for(p += 2; p < size && !(bytes[p] == 0x02 && !chunk.cinfo[p]); ++p)
+			text[p] = false;
+	}
+}
+
+/*
+ * Builds the suffix array of a string of symbols in [0, alphabet), by
+ * sorting the suffixes on their first 1, 2, 4, ... symbols in turn, each
+ * time with a counting sort on the ranks from the last round
+ */
+void TextCompressor::SuffixArray(const vector<int>& s, unsigned int alphabet, vector<int>& sa)
+{
+	int n = s.size();
+	sa.resize(n);
+	if(n == 0)
+		return;
+
+	vector<int> rank(n), order(n);
+	vector<int> count(max((int)alphabet, n) + 1, 0);
+
+	for(int i = 0; i < n; ++i)
+		count[s[i]]++;
+	for(unsigned int c = 1; c < count.size(); ++c)
+		count[c] += count[c - 1];
+	for(int i = n; i-- > 0; )
+		sa[--count[s[i]]] = i;
+
+	rank[sa[0]] = 0;
+	for(int i = 1; i < n; ++i)
+		rank[sa[i]] = rank[sa[i - 1]] + (s[sa[i]] != s[sa[i - 1]]);
+
+	for(int k = 1; rank[sa[n - 1]] < n - 1; k <<= 1)
+	{
+		// Order by the second half; suffixes without one come first
+		int j = 0;
+		for(int i = n - k; i < n; ++i)
+			order[j++] = i;
+		for(int i = 0; i < n; ++i) {
+			if(sa[i] >= k)
+				order[j++] = sa[i] - k;
+		}
+
+		// Then, keeping that order, by the first half
+		int classes = rank[sa[n - 1]] + 1;
+		std::fill(count.begin(), count.begin() + classes, 0);
+		for(int i = 0; i < n; ++i)
+			count[rank[i]]++;
+		for(int c = 1; c < classes; ++c)
+			count[c] += count[c - 1];
+		for(int i = n; i-- > 0; )
+			sa[--count[rank[order[i]]]] = order[i];
+
+		// Suffixes get the same rank if both halves match
+		order[sa[0]] = 0;
+		for(int i = 1; i < n; ++i) {
+			int a = sa[i - 1], b = sa[i];
+			int seconda = (a + k < n) ? rank[a + k] : -1;
+			int secondb = (b + k < n) ? rank[b + k] : -1;
+			order[b] = order[a] + (rank[a] != rank[b] || seconda != secondb);
+		}
+		rank.swap(order);
+	}
+}
+
+/*
+ * Finds the length of the common prefix of each suffix in the suffix array
+ * and the one before it, in linear time (Kasai et al.)
+ */
+void TextCompressor::LongestCommonPrefixes(const vector<int>& s, const vector<int>& sa, vector<int>& lcp)
+{
+	int n = s.size();
+	vector<int> inverse(n);
+	for(int i = 0; i < n; ++i)
+		inverse[sa[i]] = i;
+
+	lcp.assign(n, 0);
+	int h = 0;
+	for(int i = 0; i < n; ++i)
+	{
+		if(inverse[i] == 0) {
+			h = 0;
+			continue;
+		}
+		int j = sa[inverse[i] - 1];
+		while(i + h < n && j + h < n && s[i + h] == s[j + h])
+			++h;
+		lcp[inverse[i]] = h;
+		if(h > 0)
+			--h;
+	}
+}
@@ -0,0 +1,53 @@
+/* dictionary compression of text */
+#pragma once
+
+#include <vector>
+
+class ByteChunk;
+
+// The game can print a string from a dictionary of up to 768 entries in
+// place of the text itself, with the codes [15 xx], [16 xx] and [17 xx]
+// for entries 0-255, 256-511 and 512-767. The compressor picks the
+// substrings of the text that save the most space as entries, and replaces
+// the text with these two-byte codes.
+//
+// The game's own text uses its dictionary, so only entries the project has
+// freed up can be replaced; the compressor is given the range to use.
+//
+// Only bytes that were output as text characters (see ByteChunk::IsChar)
+// are compressed, and never across a label, so that a label can't end up
+// in the middle of a code. Characters between [19 02] and the [02] that
+// ends it are left alone, since they're copied into memory as they are
+// instead of being printed.
+//
+// Repeated substrings are found with a suffix array of all the text, with
+// the LCP intervals of the array giving each substring that occurs more
+// than once, along with its occurrences. Entries are then chosen greedily
+// by how much they save, counting only occurrences that don't overlap text
+// already replaced by an earlier entry.
+class TextCompressor
+{
+public:
+	static const unsigned int MaxEntries = 768;
+	static const unsigned int MaxLength = 32;			// longest substring made an entry
+	static const unsigned int TableAddress = 0xC8CDED;	// the game's table of pointers to entries
+
+	struct Entry {
+		std::vector<unsigned char> text;	// characters, without the [00] that ends the entry
+		unsigned int uses;					// number of places it replaced
+	};
+
+	// Compresses the text in the given chunks with a dictionary of at most
+	// the given number of entries, numbered from 'first', and returns the
+	// dictionary. Entry i is printed by the code [15+i/256 i%256].
+	static std::vector<Entry> Compress(const std::vector<ByteChunk*>& chunks,
+		unsigned int first, unsigned int entries);
+
+private:
+	struct Candidate;
+
+	static void FindText(const ByteChunk& chunk, std::vector<bool>& text);
+	static void SuffixArray(const std::vector<int>& s, unsigned int alphabet, std::vector<int>& sa);
+	static void LongestCommonPrefixes(const std::vector<int>& s, const std::vector<int>& sa,
+		std::vector<int>& lcp);
+};
@@ -0,0 +1,275 @@
+/* per-phase and per-module build timing implementation */
+
+#include "timereport.h"
+
+#include "trace.h"
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+using namespace std;
+
+
+TimeReport::TimeReport()
+{
+	enabled = false;
+	current = NULL;
+}
+
+void TimeReport::Add(const string& phase, const string& module, double wall, double cpu)
+{
+	pair<map<pair<string, string>, unsigned int>::iterator, bool> found =
+		entryindex.insert(make_pair(make_pair(phase, module), (unsigned int)entries.size()));
+
+	if(found.second) {
+		Entry e = { phase, module, 0, 0, 0 };
+		entries.push_back(e);
+	}
+
+	Entry& e = entries[found.first->second];
+	e.wall += wall;
+	e.cpu += cpu;
+	e.count++;
+}
+
+void TimeReport::AddBackground(const string& name, double wall)
+{
+	background.push_back(make_pair(name, wall));
+}
+
+/*
+ * Returns the CPU time used so far, in ms
+ */
+double TimeReport::CpuTime()
+{
+#ifndef _WIN32
+	timespec ts;
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+		return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+#endif
+	return std::clock() * 1000.0 / CLOCKS_PER_SEC;
+}
+
+/*
+ * Sums the entries by phase, and by module, in the order each was first seen
+ */
+void TimeReport::Totals(vector<Entry>& phases, vector<Entry>& modules) const
+{
+	map<string, unsigned int> phaseindex, moduleindex;
+
+	for(vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		pair<map<string, unsigned int>::iterator, bool> p =
+			phaseindex.insert(make_pair(it->phase, (unsigned int)phases.size()));
+		if(p.second) {
+			Entry e = { it->phase, "", 0, 0, 0 };
+			phases.push_back(e);
+		}
+		phases[p.first->second].wall += it->wall;
+		phases[p.first->second].cpu += it->cpu;
+		phases[p.first->second].count += it->count;
+
+		if(it->module.empty())
+			continue;
+
+		pair<map<string, unsigned int>::iterator, bool> m =
+			moduleindex.insert(make_pair(it->module, (unsigned int)modules.size()));
+		if(m.second) {
+			Entry e = { "", it->module, 0, 0, 0 };
+			modules.push_back(e);
+		}
+		modules[m.first->second].wall += it->wall;
+		modules[m.first->second].cpu += it->cpu;
+		modules[m.first->second].count += it->count;
+	}
+}
+
+static bool SlowerThan(const pair<double, string>& a, const pair<double, string>& b)
+{
+	return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+static void WriteRow(ostream& out, const string& name, double wall, double cpu)
+{
+	out << left << setw(32) << name << right
+		<< setw(12) << wall << setw(12) << cpu << endl;
+}
+
+void TimeReport::WriteTable(ostream& out) const
+{
+	vector<Entry> phases, modules;
+	Totals(phases, modules);
+
+	double totalwall = 0, totalcpu = 0;
+	for(vector<Entry>::const_iterator it = phases.begin(); it != phases.end(); ++it) {
+		totalwall += it->wall;
+		totalcpu += it->cpu;
+	}
+
+	out << fixed << setprecision(2);
+	out << left << setw(32) << "Phase" << right
+		<< setw(12) << "Wall (ms)" << setw(12) << "CPU (ms)" << endl;
+	for(vector<Entry>::const_iterator it = phases.begin(); it != phases.end(); ++it)
+		WriteRow(out, it->phase, it->wall, it->cpu);
+	WriteRow(out, "Total", totalwall, totalcpu);
+
+	if(!background.empty()) {
+		out << endl << left << setw(32) << "Background" << right << setw(12) << "Wall (ms)" << endl;
+		for(unsigned int i = 0; i < background.size(); ++i)
+			out << left << setw(32) << background[i].first << right << setw(12) << background[i].second << endl;
+	}
+
+	if(modules.empty())
+		return;
+
+	// Modules go slowest first, each followed by its phases
+	vector<pair<double, string> > order;
+	for(vector<Entry>::const_iterator it = modules.begin(); it != modules.end(); ++it)
+		order.push_back(make_pair(it->wall, it->module));
+	std::sort(order.begin(), order.end(), SlowerThan);
+
+	map<string, const Entry*> bymodule;
+	for(vector<Entry>::const_iterator it = modules.begin(); it != modules.end(); ++it)
+		bymodule[it->module] = &*it;
+
+	out << endl << left << setw(32) << "Module" << right
+		<< setw(12) << "Wall (ms)" << setw(12) << "CPU (ms)" << endl;
+	for(unsigned int i = 0; i < order.size(); ++i)
+	{
+		const Entry* m = bymodule[order[i].second];
+		WriteRow(out, m->module, m->wall, m->cpu);
+
+		for(vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+			if(it->module == m->module)
+				WriteRow(out, "  " + it->phase, it->wall, it->cpu);
+		}
+	}
+}
+
+static void WriteTimes(ostream& out, double wall, double cpu)
+{
+	out << "\"wall_ms\": " << wall << ", \"cpu_ms\": " << cpu;
+}
+
+void TimeReport::WriteJson(ostream& out) const
+{
+	vector<Entry> phases, modules;
+	Totals(phases, modules);
+
+	double totalwall = 0, totalcpu = 0;
+	for(vector<Entry>::const_iterator it = phases.begin(); it != phases.end(); ++it) {
+		totalwall += it->wall;
+		totalcpu += it->cpu;
+	}
+
+	out << fixed << setprecision(3);
+	out << "{" << endl << "  \"total\": { ";
+	WriteTimes(out, totalwall, totalcpu);
+	out << " }," << endl;
+
+	out << "  \"phases\": [";
+	for(unsigned int i = 0; i < phases.size(); ++i) {
+		out << (i ? "," : "") << endl << "    { \"phase\": " << Trace::Quote(phases[i].phase) << ", ";
+		WriteTimes(out, phases[i].wall, phases[i].cpu);
+		out << ", \"count\": " << phases[i].count << " }";
+	}
+	out << endl << "  ]," << endl;
+
+	out << "  \"background\": [";
+	for(unsigned int i = 0; i < background.size(); ++i) {
+		out << (i ? "," : "") << endl << "    { \"name\": " << Trace::Quote(background[i].first)
+			<< ", \"wall_ms\": " << background[i].second << " }";
+	}
+	out << endl << "  ]," << endl;
+
+	out << "  \"modules\": [";
+	for(unsigned int i = 0; i < modules.size(); ++i)
+	{
+		out << (i ? "," : "") << endl << "    { \"module\": " << Trace::Quote(modules[i].module) << ", ";
+		WriteTimes(out, modules[i].wall, modules[i].cpu);
+		out << ", \"phases\": [";
+
+		bool first = true;
+		for(vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+			if(it->module != modules[i].module)
+				continue;
+			out << (first ? "" : ",") << endl << "      { \"phase\": " << Trace::Quote(it->phase) << ", ";
+			WriteTimes(out, it->wall, it->cpu);
+			out << " }";
+			first = false;
+		}
+		out << endl << "    ] }";
+	}
+	out << endl << "  ]" << endl << "}" << endl;
+}
+
+bool TimeReport::Write(const string& filename) const
+{
+	bool json = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0;
+
+	if(filename == "-") {
+		WriteTable(std::cout);
+		return true;
+	}
+
+	ofstream out(filename.c_str(), ofstream::trunc);
+	if(out.fail())
+		return false;
+
+	if(json)
+		WriteJson(out);
+	else
+		WriteTable(out);
+	return !out.fail();
+}
+
+
+void TimeReport::Timer::Start(const string& module)
+{
+	this->module = module;
+	running = true;
+	timed = report.enabled;
+	if(timed) {
+		outer = report.current;
+		report.current = this;
+		innerwall = 0;
+		innercpu = 0;
+		cpustart = CpuTime();
+	}
+	wallstart = chrono::steady_clock::now();
+}
+
+/*
+ * Counts the timer's time for its phase, less the time of the timers nested
+ * in it, and for the timer it's nested in. If tracing, it's also recorded
+ * as a span.
+ */
+void TimeReport::Timer::Finish()
+{
+	chrono::steady_clock::time_point wallend = chrono::steady_clock::now();
+	running = false;
+
+	if(Trace::Enabled())
+		Trace::Complete("phase", phase, module.empty() ? "" : "\"module\": " + Trace::Quote(module),
+			wallstart, wallend);
+
+	if(!timed)
+		return;
+
+	double wall = chrono::duration<double, milli>(wallend - wallstart).count();
+	double cpu = CpuTime() - cpustart;
+
+	report.Add(phase, module, wall - innerwall, cpu - innercpu);
+
+	report.current = outer;
+	if(outer) {
+		outer->innerwall += wall;
+		outer->innercpu += cpu;
+	}
+}
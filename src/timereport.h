@@ -0,0 +1,101 @@
+/* per-phase and per-module build timing */
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "trace.h"
+
+// Collects the wall and CPU time spent in each phase of a build, both in
+// total and for each module, and writes it out as a table or as JSON.
+//
+// Time is measured by Timer objects, which time the scope they live in.
+// Timers can nest, and the time spent in an inner timer is only counted
+// for the inner phase, so that every phase is its own time alone and the
+// phases add up to the whole build. Unless timing or tracing, a timer
+// does nothing but check two flags.
+//
+// Phases are also recorded as spans when tracing (see Trace).
+//
+// Wall time comes from a steady clock. CPU time is that of the thread the
+// timer runs on where the platform can tell, and otherwise of the whole
+// process, which includes the background ROM load.
+class TimeReport
+{
+public:
+	TimeReport();
+
+	void Enable() { enabled = true; }
+	bool Enabled() const { return enabled; }
+
+	// Adds time to a phase, for a module or, if the name is empty, for the
+	// build as a whole
+	void Add(const std::string& phase, const std::string& module, double wall, double cpu);
+
+	// Adds time that was spent outside of any phase, such as on another
+	// thread, to be reported separately
+	void AddBackground(const std::string& name, double wall);
+
+	void WriteTable(std::ostream& out) const;
+	void WriteJson(std::ostream& out) const;
+
+	// Writes the report as JSON if the filename ends in .json, and as a table
+	// otherwise; "-" writes a table to stdout. Returns false on failure.
+	bool Write(const std::string& filename) const;
+
+	// Times the scope it's declared in as a phase, for a module if one is
+	// given
+	class Timer
+	{
+	public:
+		Timer(TimeReport& report, const char* phase)
+			: report(report), running(false), phase(phase) { if(report.enabled || Trace::Enabled()) Start(); }
+		Timer(TimeReport& report, const char* phase, const std::string& module)
+			: report(report), running(false), phase(phase) { if(report.enabled || Trace::Enabled()) Start(module); }
+		~Timer() { Stop(); }
+
+		// Stops the timer before the end of its scope
+		void Stop() { if(running) Finish(); }
+
+	private:
+		Timer(const Timer&);
+		Timer& operator=(const Timer&);
+
+		void Start(const std::string& module = std::string());
+		void Finish();
+
+		TimeReport& report;
+		bool running;
+		bool timed;			// counted in the report, rather than only traced
+		const char* phase;
+		std::string module;
+		Timer* outer;
+		std::chrono::steady_clock::time_point wallstart;
+		double cpustart;
+		double innerwall;	// time taken by timers nested in this one
+		double innercpu;
+	};
+
+private:
+	struct Entry {
+		std::string phase;
+		std::string module;
+		double wall;	// ms
+		double cpu;		// ms
+		unsigned int count;
+	};
+
+	static double CpuTime();
+
+	void Totals(std::vector<Entry>& phases, std::vector<Entry>& modules) const;
+
+	bool enabled;
+	Timer* current;		// innermost running timer
+	std::vector<Entry> entries;		// in the order first seen
+	std::map<std::pair<std::string, std::string>, unsigned int> entryindex;	// by (phase, module)
+	std::vector<std::pair<std::string, double> > background;
+};
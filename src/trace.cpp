@@ -0,0 +1,147 @@
+/* trace event recording implementation */
+
+#include "trace.h"
+
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+
+struct TraceEvent {
+	const char* category;
+	string name;
+	string args;
+	double start;		// us since the origin
+	double duration;	// us
+};
+
+struct TraceBuffer {
+	unsigned int thread;
+	vector<TraceEvent> events;
+};
+
+bool Trace::enabled = false;
+Trace::Clock::time_point Trace::origin;
+
+// Every thread's buffer, in the order they were made. Only the list is
+// guarded by the lock; each buffer is only touched by its own thread until
+// the trace is written.
+static mutex bufferlock;
+static vector<unique_ptr<TraceBuffer> > buffers;
+static thread_local TraceBuffer* threadbuffer = NULL;
+
+
+void Trace::Enable()
+{
+	origin = Clock::now();
+	enabled = true;
+}
+
+/*
+ * Returns the buffer of the calling thread, making it if it doesn't exist
+ */
+static TraceBuffer& ThreadBuffer()
+{
+	if(!threadbuffer) {
+		lock_guard<mutex> lock(bufferlock);
+		buffers.push_back(unique_ptr<TraceBuffer>(new TraceBuffer()));
+		threadbuffer = buffers.back().get();
+		threadbuffer->thread = buffers.size();
+	}
+	return *threadbuffer;
+}
+
+void Trace::Complete(const char* category, const string& name, const string& args,
+	Clock::time_point start, Clock::time_point end)
+{
+	TraceEvent e;
+	e.category = category;
+	e.name = name;
+	e.args = args;
+	e.start = chrono::duration<double, micro>(start - origin).count();
+	e.duration = chrono::duration<double, micro>(end - start).count();
+	ThreadBuffer().events.push_back(e);
+}
+
+bool Trace::Write(const string& filename)
+{
+	ofstream out(filename.c_str(), ofstream::trunc);
+	if(out.fail())
+		return false;
+
+	lock_guard<mutex> lock(bufferlock);
+
+	out << fixed << setprecision(3);
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+	bool first = true;
+	for(unsigned int b = 0; b < buffers.size(); ++b)
+	{
+		const vector<TraceEvent>& events = buffers[b]->events;
+		for(vector<TraceEvent>::const_iterator it = events.begin(); it != events.end(); ++it) {
+			out << (first ? "" : ",") << endl
+				<< "{\"name\": " << Quote(it->name) << ", \"cat\": \"" << it->category
+				<< "\", \"ph\": \"X\", \"ts\": " << it->start << ", \"dur\": " << it->duration
+				<< ", \"pid\": 1, \"tid\": " << buffers[b]->thread;
+			if(!it->args.empty())
+				out << ", \"args\": {" << it->args << "}";
+			out << "}";
+			first = false;
+		}
+	}
+	out << endl << "]}" << endl;
+
+	return !out.fail();
+}
+
+string Trace::Quote(const string& s)
+{
+	ostringstream out;
+	out << '"';
+	for(string::const_iterator it = s.begin(); it != s.end(); ++it) {
+		unsigned char c = *it;
+		if(c == '"' || c == '\\')
+			out << '\\' << c;
+		else if(c < 0x20)
+			out << "\\u" << hex << setw(4) << setfill('0') << (int)c << dec << setfill(' ');
+		else
+			out << c;
+	}
+	out << '"';
+	return out.str();
+}
+
+
+void Trace::Span::Begin(const char* category, const string& name)
+{
+	this->category = category;
+	this->name = name;
+	start = Clock::now();
+}
+
+void Trace::Span::End()
+{
+	Complete(category, name, args, start, Clock::now());
+}
+
+void Trace::Span::AddArg(const char* key, const string& json)
+{
+	if(!args.empty())
+		args += ", ";
+	args += "\"";
+	args += key;
+	args += "\": ";
+	args += json;
+}
+
+void Trace::Span::AddArg(const char* key, long value)
+{
+	ostringstream ss;
+	ss << value;
+	AddArg(key, ss.str());
+}
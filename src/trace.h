@@ -0,0 +1,71 @@
+/* trace event recording */
+#pragma once
+
+#include <chrono>
+#include <string>
+
+// Records spans of time, such as the evaluation of a command, as Chrome
+// trace events that can be loaded into chrome://tracing or Perfetto.
+//
+// A span is recorded by a Span object, for the scope it lives in. Spans
+// are written as complete ("X") events with the thread they ran on, so the
+// viewer nests them by time: a span that starts inside another, on the same
+// thread, is shown inside it.
+//
+// Each thread records into a buffer of its own, so recording doesn't need
+// a lock; the buffers are only gathered when the trace is written, which
+// must not happen while other threads are still recording. Tracing is
+// always compiled in, and while it's off a span does nothing but check a
+// flag.
+class Trace
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	static void Enable();
+	static bool Enabled() { return enabled; }
+
+	// Records a span that has already ended. 'args' is the inside of a JSON
+	// object, or empty.
+	static void Complete(const char* category, const std::string& name, const std::string& args,
+		Clock::time_point start, Clock::time_point end);
+
+	// Writes every event recorded so far to a file. Returns false on failure.
+	static bool Write(const std::string& filename);
+
+	// Returns a string quoted and escaped for JSON
+	static std::string Quote(const std::string& s);
+
+	class Span
+	{
+	public:
+		Span(const char* category, const char* name)
+			: active(enabled) { if(active) Begin(category, name); }
+		Span(const char* category, const std::string& name)
+			: active(enabled) { if(active) Begin(category, name); }
+		~Span() { if(active) End(); }
+
+		// Adds an argument, shown with the span in the viewer
+		void Arg(const char* key, const std::string& value) { if(active) AddArg(key, Quote(value)); }
+		void Arg(const char* key, long value) { if(active) AddArg(key, value); }
+
+	private:
+		Span(const Span&);
+		Span& operator=(const Span&);
+
+		void Begin(const char* category, const std::string& name);
+		void End();
+		void AddArg(const char* key, const std::string& json);
+		void AddArg(const char* key, long value);
+
+		bool active;
+		const char* category;
+		std::string name;
+		std::string args;
+		Clock::time_point start;
+	};
+
+private:
+	static bool enabled;
+	static Clock::time_point origin;	// time 0 in the trace
+};